@@ -158,6 +158,9 @@ void checkAlerts() {
 }
 
 void sendSensorData() {
+  // Pack all readings into one MQTT message instead of one per pin
+  Vwire.beginBatch();
+  
   // Send current values
   Vwire.virtualSend(V0, temperature);
   Vwire.virtualSend(V1, humidity);
@@ -167,6 +170,8 @@ void sendSensorData() {
   Vwire.virtualSend(V3, temperature);
   Vwire.virtualSend(V4, humidity);
   
+  Vwire.flushBatch();
+  
   Serial.printf("Sent: T=%.1fC, H=%.1f%%, HI=%.1fC\n",
                 temperature, humidity, heatIndex);
 }
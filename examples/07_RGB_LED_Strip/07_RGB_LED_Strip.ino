@@ -277,11 +277,12 @@ VWIRE_RECEIVE(V0) {
 }
 
 VWIRE_RECEIVE(V1) {
-  // zeRGBa sends comma-separated RGB values
-  if (param.getArraySize() >= 3) {
-    red = param.getArrayItemInt(0);
-    green = param.getArrayItemInt(1);
-    blue = param.getArrayItemInt(2);
+  // zeRGBa sends comma-separated RGB values - parse them in one pass
+  int rgb[3];
+  if (param.parseArray(rgb, 3) == 3) {
+    red = rgb[0];
+    green = rgb[1];
+    blue = rgb[2];
   }
   
   Serial.printf("Color: R=%d G=%d B=%d\n", red, green, blue);
@@ -260,10 +260,11 @@ VWIRE_RECEIVE(V1) {
 }
 
 VWIRE_RECEIVE(V2) {
-  // Joystick sends X,Y as comma-separated values
-  if (param.getArraySize() >= 2) {
-    int x = param.getArrayItemInt(0);  // Left/Right
-    int y = param.getArrayItemInt(1);  // Forward/Backward
+  // Joystick sends X,Y as comma-separated values - parse them in one pass
+  int xy[2];
+  if (param.parseArray(xy, 2) == 2) {
+    int x = xy[0];  // Left/Right
+    int y = xy[1];  // Forward/Backward
     
     Serial.printf("Joystick: X=%d, Y=%d\n", x, y);
     joystickToDifferential(x, y);
@@ -0,0 +1,56 @@
+/*
+ * Vwire IOT - Deep Sleep Sensor Example
+ * 
+ * Battery node that wakes up, sends one reading and goes back to sleep.
+ * sleepFor() keeps the WiFi channel/BSSID, broker address and TLS session
+ * (ESP8266) in RTC memory, so every wake after the first skips the WiFi
+ * scan and the DNS lookup.
+ * 
+ * Board: ESP32 or ESP8266 (ESP8266: connect GPIO16 to RST for wake-up)
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * MIT License
+ * 
+ * =============================================================================
+ * DASHBOARD SETUP
+ * =============================================================================
+ * 
+ * V0: Value Display - Battery voltage
+ * V1: Value Display - Awake time of the previous cycle (ms)
+ * 
+ * =============================================================================
+ */
+
+#include <Vwire.h>
+
+// Configuration - UPDATE THESE!
+#define WIFI_SSID     "YOUR_WIFI"
+#define WIFI_PASS     "YOUR_PASSWORD"
+#define AUTH_TOKEN    "YOUR_AUTH_TOKEN"
+
+#define SLEEP_MS      60000   // One reading per minute
+
+float readBattery() {
+  return analogRead(A0) * (4.2 / 1023.0);
+}
+
+void setup() {
+  Serial.begin(115200);
+  
+  Vwire.config(AUTH_TOKEN);
+  if (Vwire.begin(WIFI_SSID, WIFI_PASS)) {
+    Vwire.virtualSend(V0, readBattery());
+    
+    // Radio-on time of the last cycle, measured by the library
+    if (Vwire.wokeFromSleep()) {
+      Vwire.virtualSend(V1, Vwire.getLastAwakeTime());
+    }
+  }
+  
+  // Flushes pending data, disconnects cleanly and sleeps - does not return
+  Vwire.sleepFor(SLEEP_MS);
+}
+
+void loop() {
+  // Not reached
+}
@@ -0,0 +1,362 @@
+/*
+ * Vwire IOT Arduino Library - Host Benchmark
+ *
+ * Runs the library against the shims in shim/ (loopback PubSubClient,
+ * always-connected WiFi, virtual time) and measures:
+ * - inbound messages through the MQTT callback at several handler counts
+ * - virtualSend() per value type, text and binary encoding
+ * - VwireTimer::run() against the number of timers
+ * - reliable delivery with a share of the ACKs lost
+ *
+ * Iteration counts and random seeds are fixed and every case reports the
+ * median of BENCH_REPEATS runs, so results of two releases built with the
+ * same compiler and flags can be compared line by line.
+ *
+ * Usage: vwire_bench [--csv] [--quick]
+ *
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#include <Vwire.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define BENCH_REPEATS 5
+#define BENCH_TOKEN   "bench0123456789abcdef0123456789ab"   // 32 characters, like a real token
+
+static bool _csv = false;
+static unsigned long _scale = 1;          // --quick divides iteration counts by 10
+static volatile long _sink = 0;           // Keeps handler work from being optimised out
+
+// =============================================================================
+// REPORTING
+// =============================================================================
+typedef std::chrono::steady_clock BenchClock;
+
+static double _elapsedNs(BenchClock::time_point started) {
+  return std::chrono::duration<double, std::nano>(BenchClock::now() - started).count();
+}
+
+static double _median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+static void _header() {
+  if (_csv) {
+    printf("benchmark,case,ns_per_op,ops_per_sec,extra\n");
+    return;
+  }
+  printf("# vwire-bench %s, %s, median of %d runs%s\n", VWIRE_VERSION, __VERSION__,
+         BENCH_REPEATS, _scale > 1 ? ", quick" : "");
+  printf("%-18s %-24s %12s %14s  %s\n", "benchmark", "case", "ns/op", "ops/s", "extra");
+}
+
+static void _report(const char* benchmark, const char* name, double nsPerOp, const char* extra = "") {
+  double opsPerSec = nsPerOp > 0 ? 1e9 / nsPerOp : 0;
+  if (_csv) {
+    printf("%s,%s,%.1f,%.0f,%s\n", benchmark, name, nsPerOp, opsPerSec, extra);
+  } else {
+    printf("%-18s %-24s %12.1f %14.0f  %s\n", benchmark, name, nsPerOp, opsPerSec, extra);
+  }
+  fflush(stdout);
+}
+
+/** @brief Median ns per operation of body(iterations) */
+template<typename Body>
+static double _measure(unsigned long iterations, Body body) {
+  std::vector<double> samples;
+  body(iterations / 10 + 1);  // Warm up caches and lazy setup
+  for (int i = 0; i < BENCH_REPEATS; i++) {
+    BenchClock::time_point started = BenchClock::now();
+    body(iterations);
+    samples.push_back(_elapsedNs(started) / iterations);
+  }
+  return _median(samples);
+}
+
+static PubSubClient& _broker() {
+  return *PubSubClient::instance;
+}
+
+static void _connect() {
+  Vwire.config(BENCH_TOKEN, "bench.local", 1883);
+  if (!Vwire.begin() || !PubSubClient::instance) {
+    fprintf(stderr, "vwire-bench: connect failed\n");
+    exit(1);
+  }
+}
+
+// =============================================================================
+// INBOUND MESSAGES
+// =============================================================================
+static void _pinHandler(VirtualPin& pin) {
+  _sink += pin.asInt();
+}
+
+static void _benchHandleMessage() {
+  static const int counts[] = {1, 8, 16, VWIRE_MAX_HANDLERS};
+  const unsigned long iterations = 200000 / _scale;
+  int registered = 0;
+
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+    while (registered < counts[c]) {
+      Vwire.onVirtualReceive(registered++, _pinHandler);
+    }
+
+    // Commands spread over every registered pin
+    std::vector<std::string> topics;
+    for (int pin = 0; pin < registered; pin++) {
+      topics.push_back(std::string("vwire/" BENCH_TOKEN "/cmd/V") + std::to_string(pin));
+    }
+    double ns = _measure(iterations, [&](unsigned long n) {
+      for (unsigned long i = 0; i < n; i++) {
+        _broker().deliver(topics[i % topics.size()].c_str(), (const uint8_t*)"1234", 4);
+      }
+    });
+    char name[32];
+    snprintf(name, sizeof(name), "handlers=%d", registered);
+    _report("handleMessage", name, ns);
+  }
+
+  // A topic for another device on the connection (prefix mismatch)
+  double ns = _measure(iterations, [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) {
+      _broker().deliver("vwire/someone-else/cmd/V1", (const uint8_t*)"1", 1);
+    }
+  });
+  _report("handleMessage", "foreign-topic", ns);
+
+  // Eight commands in one batch frame, reported per command
+  std::string batch = "{";
+  for (int pin = 0; pin < 8; pin++) {
+    batch += std::string(pin ? "," : "") + "\"V" + std::to_string(pin) + "\":\"1234\"";
+  }
+  batch += "}";
+  ns = _measure(iterations / 8, [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) {
+      _broker().deliver("vwire/" BENCH_TOKEN "/cmd", (const uint8_t*)batch.data(), batch.size());
+    }
+  }) / 8;
+  _report("handleMessage", "batch=8 (per cmd)", ns);
+  
+  // Long value (view into the receive buffer, no copy)
+  std::string payload(200, '7');
+  ns = _measure(iterations, [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) {
+      _broker().deliver("vwire/" BENCH_TOKEN "/cmd/V0", (const uint8_t*)payload.data(), payload.size());
+    }
+  });
+  _report("handleMessage", "payload=200B", ns);
+}
+
+// =============================================================================
+// VIRTUAL SEND
+// =============================================================================
+static void _benchVirtualSendCases(const char* benchmark) {
+  const unsigned long iterations = 200000 / _scale;
+  const String text("hello world");
+
+  _report(benchmark, "int", _measure(iterations, [](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) Vwire.virtualSend(1, (int)i);
+  }));
+  _report(benchmark, "bool", _measure(iterations, [](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) Vwire.virtualSend(1, (bool)(i & 1));
+  }));
+  _report(benchmark, "float", _measure(iterations, [](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) Vwire.virtualSend(1, (float)i * 0.25f);
+  }));
+  _report(benchmark, "double", _measure(iterations, [](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) Vwire.virtualSend(1, (double)i * 0.125);
+  }));
+  _report(benchmark, "const char*", _measure(iterations, [](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) Vwire.virtualSend(1, "hello world");
+  }));
+  _report(benchmark, "String", _measure(iterations, [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) Vwire.virtualSend(1, text);
+  }));
+  _report(benchmark, "virtualSendf", _measure(iterations, [](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) Vwire.virtualSendf(1, "%lu,%d", i, 42);
+  }));
+  float values[8] = {1.5f, 2.25f, 3, 4, 5, 6, 7, 8};
+  _report(benchmark, "array float[8]", _measure(iterations / 4, [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) Vwire.virtualSendArray(1, values, 8);
+  }));
+}
+
+static void _benchVirtualSend() {
+  _benchVirtualSendCases("virtualSend");
+
+  // Same calls once the server accepted the binary encoding
+  Vwire.disconnect();
+  Vwire.setEncoding(VWIRE_ENCODING_BINARY);
+  _connect();
+  _broker().deliver("vwire/" BENCH_TOKEN "/enc", (const uint8_t*)VWIRE_BINARY_PROTOCOL,
+                    strlen(VWIRE_BINARY_PROTOCOL));
+  if (!Vwire.isBinaryActive()) {
+    fprintf(stderr, "vwire-bench: binary encoding not negotiated\n");
+    exit(1);
+  }
+  _benchVirtualSendCases("virtualSend.bin");
+
+  Vwire.disconnect();
+  Vwire.setEncoding(VWIRE_ENCODING_TEXT);
+  _connect();
+}
+
+// =============================================================================
+// TIMERS
+// =============================================================================
+static void _timerTick() {
+  _sink++;
+}
+
+static void _benchTimers() {
+  static const int counts[] = {0, 1, 4, 8, 16, VWIRE_MAX_TIMERS};
+  const unsigned long iterations = 1000000 / _scale;
+
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+    char name[32];
+
+    // Nothing due - the cost every loop() pays
+    {
+      VwireTimer timer;
+      for (int i = 0; i < counts[c]; i++) timer.setInterval(3600000UL + i, _timerTick);
+      double ns = _measure(iterations, [&](unsigned long n) {
+        for (unsigned long i = 0; i < n; i++) timer.run();
+      });
+      snprintf(name, sizeof(name), "idle timers=%d", counts[c]);
+      _report("timer.run", name, ns);
+    }
+
+    // One timer due per call (1 ms intervals, time advances 1 ms per call)
+    if (counts[c] > 0) {
+      VwireTimer timer;
+      for (int i = 0; i < counts[c]; i++) timer.setInterval(counts[c], _timerTick);
+      double ns = _measure(iterations / 10, [&](unsigned long n) {
+        for (unsigned long i = 0; i < n; i++) {
+          shimAdvance(1);
+          timer.run();
+        }
+      });
+      snprintf(name, sizeof(name), "firing timers=%d", counts[c]);
+      _report("timer.run", name, ns);
+    }
+  }
+}
+
+// =============================================================================
+// RELIABLE DELIVERY
+// =============================================================================
+struct LossyServer {
+  uint32_t seed;
+  unsigned lossPercent;
+  unsigned long dataPublishes;
+
+  bool lose() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed % 100 < lossPercent;
+  }
+};
+
+static void _serverObserver(void* context, const char* topic, const uint8_t* payload, size_t length) {
+  // ACK every {"msgId":"N",...} on the data topic unless this one is lost
+  static const char dataTopic[] = "vwire/" BENCH_TOKEN "/data";
+  LossyServer* server = (LossyServer*)context;
+  if (strcmp(topic, dataTopic) != 0) return;
+  server->dataPublishes++;
+  if (server->lose()) return;
+
+  std::string text((const char*)payload, length);
+  size_t start = text.find("\"msgId\":\"");
+  if (start == std::string::npos) return;
+  start += 9;
+  size_t end = text.find('"', start);
+  std::string ack = "{\"msgId\":\"" + text.substr(start, end - start) + "\",\"ok\":true}";
+  PubSubClient::instance->queue("vwire/" BENCH_TOKEN "/ack", ack.c_str());
+}
+
+static unsigned long _delivered = 0;
+static unsigned long _failed = 0;
+static bool _refused = false;
+
+static void _onDelivery(const char* msgId, bool success) {
+  if (success) _delivered++;
+  else if (strcmp(msgId, "queue_full") == 0) _refused = true;  // Ring slot busy - send again later
+  else _failed++;
+}
+
+static void _benchReliable() {
+  static const unsigned losses[] = {0, 1, 5, 10, 25};
+  const unsigned long messages = 20000 / _scale;
+
+  Vwire.setAckTimeout(200);
+  Vwire.setMaxRetries(3);
+  Vwire.onDeliveryStatus(_onDelivery);
+
+  for (size_t c = 0; c < sizeof(losses) / sizeof(losses[0]); c++) {
+    LossyServer server = {2463534242UL, losses[c], 0};
+    _broker().setObserver(_serverObserver, &server);
+    Vwire.setReliableDelivery(true);
+    _delivered = _failed = 0;
+
+    // One send per simulated millisecond, repeated while the pending ring
+    // refuses it; ACKs arrive on the next run() (1 ms round trip)
+    unsigned long sent = 0, refused = 0, simulatedMs = 0;
+    BenchClock::time_point started = BenchClock::now();
+    while (sent < messages || Vwire.isDeliveryPending()) {
+      if (sent < messages) {
+        _refused = false;
+        Vwire.virtualSend(2, (int)sent);
+        if (_refused) refused++;
+        else sent++;
+      }
+      Vwire.run();
+      shimAdvance(1);
+      simulatedMs++;
+    }
+    double ns = _elapsedNs(started) / messages;
+
+    char name[32], extra[128];
+    snprintf(name, sizeof(name), "ack-loss=%u%%", losses[c]);
+    snprintf(extra, sizeof(extra), "delivered=%lu failed=%lu refused=%lu publishes/msg=%.3f sim-msgs/s=%.0f",
+             _delivered, _failed, refused, (double)server.dataPublishes / messages,
+             simulatedMs ? messages * 1000.0 / simulatedMs : 0.0);
+    _report("reliable", name, ns, extra);
+
+    Vwire.setReliableDelivery(false);
+    _broker().setObserver(nullptr, nullptr);
+  }
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--csv") == 0) {
+      _csv = true;
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      _scale = 10;
+    } else {
+      fprintf(stderr, "usage: %s [--csv] [--quick]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  randomSeed(1);
+  _connect();
+  _header();
+  _benchHandleMessage();
+  _benchVirtualSend();
+  _benchTimers();
+  _benchReliable();
+  Vwire.disconnect();
+  return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Vwire IOT Arduino Library - Host Shim: Arduino core
+ * 
+ * Just enough of the Arduino API to build the library on a PC for
+ * benchmarking. Time is virtual: millis()/micros() only move when the
+ * benchmark calls shimAdvance(), so runs are repeatable.
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_SHIM_ARDUINO_H
+#define VWIRE_SHIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <strings.h>
+#include <algorithm>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+/** @brief Move virtual time forward */
+void shimAdvance(unsigned long ms);
+
+using std::min;
+using std::max;
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+// =============================================================================
+// STRING
+// =============================================================================
+class String {
+public:
+  String(const char* s = "") : _s(s ? s : "") {}
+  String(const std::string& s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  String(int v) : _s(std::to_string(v)) {}
+  String(long v) : _s(std::to_string(v)) {}
+  String(unsigned int v) : _s(std::to_string(v)) {}
+  String(unsigned long v) : _s(std::to_string(v)) {}
+  String(float v, unsigned char decimals = 2) : _s(_format(v, decimals)) {}
+  String(double v, unsigned char decimals = 2) : _s(_format(v, decimals)) {}
+  
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.size(); }
+  char charAt(unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+  String substring(unsigned int from, unsigned int to) const { return String(_s.substr(from, to - from)); }
+  String substring(unsigned int from) const { return String(_s.substr(from)); }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return atof(_s.c_str()); }
+  double toDouble() const { return atof(_s.c_str()); }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(c_str(), o.c_str()) == 0; }
+  bool reserve(unsigned int n) { _s.reserve(n); return true; }
+  
+  bool operator==(const String& o) const { return _s == o._s; }
+  bool operator==(const char* o) const { return _s == o; }
+  String& operator+=(const String& o) { _s += o._s; return *this; }
+  String& operator+=(const char* o) { _s += o; return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+  friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+  friend String operator+(const String& a, const char* b) { return String(a._s + b); }
+  friend String operator+(const char* a, const String& b) { return String(std::string(a) + b._s); }
+
+private:
+  static std::string _format(double v, unsigned char decimals) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    return buf;
+  }
+  std::string _s;
+};
+
+// =============================================================================
+// PRINT / STREAM
+// =============================================================================
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write(s.c_str()); }
+  size_t print(const __FlashStringHelper* s) { return write((const char*)s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned int v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+  size_t println() { return write("\r\n"); }
+  template<typename T> size_t println(T v) { return print(v) + println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+};
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+};
+extern HardwareSerial Serial;
+
+// =============================================================================
+// NETWORK
+// =============================================================================
+class IPAddress {
+public:
+  IPAddress() : _address(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : _address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+  IPAddress(uint32_t address) : _address(address) {}
+  operator uint32_t() const { return _address; }
+  uint8_t operator[](int i) const { return (_address >> (8 * i)) & 0xFF; }
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buf);
+  }
+
+private:
+  uint32_t _address;
+};
+
+class Client : public Stream {
+public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char* host, uint16_t port) = 0;
+  virtual size_t write(uint8_t b) override = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) override = 0;
+  virtual int available() override = 0;
+  virtual int read() override = 0;
+  virtual int read(uint8_t* buffer, size_t size) = 0;
+  virtual int peek() override = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+};
+
+#endif // VWIRE_SHIM_ARDUINO_H
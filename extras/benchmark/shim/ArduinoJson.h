@@ -0,0 +1,2 @@
+// Host shim: the library includes ArduinoJson but parses its own messages
+#include <Arduino.h>
@@ -0,0 +1,2 @@
+// Host shim: Client lives in Arduino.h
+#include <Arduino.h>
@@ -0,0 +1,95 @@
+/*
+ * Vwire IOT Arduino Library - Host Shim: PubSubClient
+ * 
+ * Loopback broker for benchmarks:
+ * - Publishes are counted and, if an observer is set, handed to it
+ * - deliver() puts a message in the receive buffer with PubSubClient's
+ *   layout ([header][length][topic\0][payload]) and runs the callback
+ *   right away; queue() holds it until the next loop()
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_SHIM_PUBSUBCLIENT_H
+#define VWIRE_SHIM_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <deque>
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+#define MQTT_CONNECT_BAD_PROTOCOL    1
+#define MQTT_CONNECT_UNAUTHORIZED    5
+
+class PubSubClient : public Print {
+public:
+  typedef void (*Callback)(char* topic, uint8_t* payload, unsigned int length);
+  typedef void (*Observer)(void* context, const char* topic, const uint8_t* payload, size_t length);
+  
+  explicit PubSubClient(Client& client);
+  ~PubSubClient();
+  
+  // Setup
+  PubSubClient& setClient(Client& client) { _client = &client; return *this; }
+  PubSubClient& setServer(const char*, uint16_t) { return *this; }
+  PubSubClient& setServer(IPAddress, uint16_t) { return *this; }
+  PubSubClient& setCallback(Callback callback);
+  PubSubClient& setKeepAlive(uint16_t) { return *this; }
+  PubSubClient& setSocketTimeout(uint16_t) { return *this; }
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() { return _bufferSize; }
+  
+  // Session
+  bool connect(const char*, const char*, const char*, const char*, uint8_t, bool, const char*);
+  void disconnect() { _connected = false; }
+  bool connected() { return _connected; }
+  int state() { return _connected ? MQTT_CONNECTED : MQTT_DISCONNECTED; }
+  bool loop();
+  
+  // Publishing
+  bool publish(const char* topic, const char* payload);
+  bool beginPublish(const char* topic, unsigned int length, bool retained);
+  int endPublish();
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  
+  bool subscribe(const char*, uint8_t = 0) { return _connected; }
+  bool unsubscribe(const char*) { return _connected; }
+  
+  // Benchmark side
+  /** @brief The most recently configured client (the one VwireClass uses) */
+  static PubSubClient* instance;
+  
+  /** @brief See every publish (payload truncated to 512 bytes) */
+  void setObserver(Observer observer, void* context) { _observer = observer; _observerContext = context; }
+  
+  /** @brief Receive a message now */
+  bool deliver(const char* topic, const uint8_t* payload, size_t length);
+  
+  /** @brief Receive a message on the next loop() */
+  void queue(const char* topic, const char* payload);
+  
+  unsigned long publishes;      ///< Messages published
+  unsigned long bytesOut;       ///< Topic, payload and raw packet bytes written
+
+private:
+  Client* _client;
+  Callback _callback;
+  uint8_t* _buffer;
+  uint16_t _bufferSize;
+  bool _connected;
+  Observer _observer;
+  void* _observerContext;
+  bool _publishing;
+  char _topic[128];
+  uint8_t _payload[512];
+  size_t _payloadLength;
+  std::deque<std::pair<std::string, std::string> > _inbox;
+};
+
+#endif // VWIRE_SHIM_PUBSUBCLIENT_H
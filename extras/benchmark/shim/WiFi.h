@@ -0,0 +1,36 @@
+/*
+ * Vwire IOT Arduino Library - Host Shim: WiFi
+ * 
+ * Always associated; lookups resolve to 10.0.0.1.
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_SHIM_WIFI_H
+#define VWIRE_SHIM_WIFI_H
+
+#include <Arduino.h>
+#include "WiFiClient.h"
+
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+#define WIFI_STA 1
+
+class WiFiClass {
+public:
+  void mode(int) {}
+  void begin(const char*, const char*) {}
+  void begin(const char*, const char*, int32_t, const uint8_t*, bool = true) {}
+  bool disconnect(bool = false) { return true; }
+  int status() { return WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(192, 168, 1, 2); }
+  int RSSI() { return -60; }
+  int32_t channel() { return 6; }
+  uint8_t* BSSID() { static uint8_t bssid[6] = {0}; return bssid; }
+  int hostByName(const char*, IPAddress& ip) { ip = IPAddress(10, 0, 0, 1); return 1; }
+};
+extern WiFiClass WiFi;
+
+#endif // VWIRE_SHIM_WIFI_H
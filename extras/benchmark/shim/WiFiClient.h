@@ -0,0 +1,38 @@
+/*
+ * Vwire IOT Arduino Library - Host Shim: WiFiClient
+ * 
+ * A socket that always connects and swallows writes; the MQTT traffic is
+ * handled by the PubSubClient fake.
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_SHIM_WIFICLIENT_H
+#define VWIRE_SHIM_WIFICLIENT_H
+
+#include <Arduino.h>
+
+class WiFiClient : public Client {
+public:
+  int connect(IPAddress, uint16_t) override { _connected = true; return 1; }
+  int connect(const char*, uint16_t) override { _connected = true; return 1; }
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t size) override { return size; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int read(uint8_t*, size_t) override { return -1; }
+  int peek() override { return -1; }
+  void flush() override {}
+  void stop() override { _connected = false; }
+  uint8_t connected() override { return _connected; }
+  operator bool() override { return _connected; }
+  void setTimeout(unsigned long) {}
+  void setNoDelay(bool) {}
+
+private:
+  bool _connected = false;
+};
+
+#endif // VWIRE_SHIM_WIFICLIENT_H
@@ -0,0 +1,154 @@
+/*
+ * Vwire IOT Arduino Library - Host Shim Implementation
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+
+// =============================================================================
+// TIME
+// =============================================================================
+static unsigned long _shimMillis = 0;
+
+unsigned long millis() { return _shimMillis; }
+unsigned long micros() { return _shimMillis * 1000UL; }
+void delay(unsigned long ms) { _shimMillis += ms; }
+void yield() {}
+void shimAdvance(unsigned long ms) { _shimMillis += ms; }
+
+static uint32_t _shimSeed = 1;
+
+long random(long max) {
+  // xorshift32 - the same sequence on every host
+  _shimSeed ^= _shimSeed << 13;
+  _shimSeed ^= _shimSeed >> 17;
+  _shimSeed ^= _shimSeed << 5;
+  return max > 0 ? (long)(_shimSeed % (uint32_t)max) : 0;
+}
+
+long random(long min, long max) { return max > min ? min + random(max - min) : min; }
+void randomSeed(unsigned long seed) { _shimSeed = seed ? seed : 1; }
+
+// =============================================================================
+// PUBSUBCLIENT
+// =============================================================================
+PubSubClient* PubSubClient::instance = nullptr;
+
+PubSubClient::PubSubClient(Client& client)
+  : publishes(0)
+  , bytesOut(0)
+  , _client(&client)
+  , _callback(nullptr)
+  , _buffer(nullptr)
+  , _bufferSize(0)
+  , _connected(false)
+  , _observer(nullptr)
+  , _observerContext(nullptr)
+  , _publishing(false)
+  , _payloadLength(0)
+{
+  _topic[0] = '\0';
+  setBufferSize(256);
+}
+
+PubSubClient::~PubSubClient() {
+  if (instance == this) instance = nullptr;
+  free(_buffer);
+}
+
+PubSubClient& PubSubClient::setCallback(Callback callback) {
+  _callback = callback;
+  instance = this;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  uint8_t* buffer = (uint8_t*)realloc(_buffer, size);
+  if (!buffer) return false;
+  _buffer = buffer;
+  _bufferSize = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char*, const char*, const char*, const char*, uint8_t, bool, const char*) {
+  _connected = _client && _client->connected();
+  return _connected;
+}
+
+bool PubSubClient::loop() {
+  // Deliver what was queued before this call; replies queue for the next one
+  size_t count = _inbox.size();
+  while (count-- && _connected) {
+    std::pair<std::string, std::string> message = _inbox.front();
+    _inbox.pop_front();
+    deliver(message.first.c_str(), (const uint8_t*)message.second.data(), message.second.size());
+  }
+  return _connected;
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+  size_t length = strlen(payload);
+  if (!beginPublish(topic, length, false)) return false;
+  write((const uint8_t*)payload, length);
+  return endPublish();
+}
+
+bool PubSubClient::beginPublish(const char* topic, unsigned int, bool) {
+  if (!_connected) return false;
+  _publishing = true;
+  _payloadLength = 0;
+  bytesOut += strlen(topic);
+  if (_observer) {
+    strncpy(_topic, topic, sizeof(_topic) - 1);
+    _topic[sizeof(_topic) - 1] = '\0';
+  }
+  return true;
+}
+
+int PubSubClient::endPublish() {
+  if (!_publishing) return 0;
+  _publishing = false;
+  publishes++;
+  if (_observer) _observer(_observerContext, _topic, _payload, _payloadLength);
+  return 1;
+}
+
+size_t PubSubClient::write(const uint8_t* buffer, size_t size) {
+  // Outside a publish this is a raw packet write (session setup)
+  bytesOut += size;
+  if (_publishing && _observer) {
+    size_t room = sizeof(_payload) - _payloadLength;
+    size_t n = size < room ? size : room;
+    memcpy(_payload + _payloadLength, buffer, n);
+    _payloadLength += n;
+  }
+  return size;
+}
+
+bool PubSubClient::deliver(const char* topic, const uint8_t* payload, size_t length) {
+  size_t topicLength = strlen(topic);
+  size_t remaining = 2 + topicLength + length;
+  size_t lengthBytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+  if (1 + lengthBytes + remaining > _bufferSize || !_callback) return false;
+  
+  // The topic length field is overwritten by the topic's NUL, as PubSubClient does
+  uint8_t* topicStart = _buffer + 1 + lengthBytes + 1;
+  memcpy(topicStart, topic, topicLength);
+  topicStart[topicLength] = '\0';
+  uint8_t* payloadStart = topicStart + topicLength + 1;
+  memcpy(payloadStart, payload, length);
+  _callback((char*)topicStart, payloadStart, length);
+  return true;
+}
+
+void PubSubClient::queue(const char* topic, const char* payload) {
+  _inbox.push_back(std::make_pair(std::string(topic), std::string(payload)));
+}
@@ -11,17 +11,98 @@
 #include "Vwire.h"
 #include <stdarg.h>
 
+#if defined(VWIRE_BOARD_ESP32)
+#include <esp_sleep.h>
+#endif
+
 // =============================================================================
 // GLOBAL INSTANCE
 // =============================================================================
 VwireClass Vwire;
-static VwireClass* _vwireInstance = nullptr;
+
+// Every instance, so MQTT callbacks can be routed by device ID
+// (zero-initialised before any constructor runs)
+static VwireClass* _vwireRegistry[VWIRE_MAX_DEVICES];
+
+// =============================================================================
+// VIRTUAL PIN FORMATTING
+// =============================================================================
+size_t VirtualPin::formatFloat(char* out, size_t size, double value, uint8_t decimals) {
+  if (!out || size == 0) return 0;
+  
+  char tmp[40];
+  size_t n = 0;
+  
+  if (isnan(value)) {
+    n = snprintf(tmp, sizeof(tmp), "nan");
+  } else if (isinf(value)) {
+    n = snprintf(tmp, sizeof(tmp), value > 0 ? "inf" : "-inf");
+  } else {
+    if (value < 0.0) {
+      tmp[n++] = '-';
+      value = -value;
+    }
+    if (decimals > 8) decimals = 8;
+    
+    // Values beyond unsigned long range use scientific notation
+    int exponent = 0;
+    if (value >= 4294967295.0) {
+      while (value >= 10.0) {
+        value /= 10.0;
+        exponent++;
+      }
+    }
+    
+    // Round to the requested precision
+    double rounding = 0.5;
+    for (uint8_t i = 0; i < decimals; i++) rounding /= 10.0;
+    value += rounding;
+    if (exponent && value >= 10.0) {
+      value /= 10.0;
+      exponent++;
+    }
+    
+    // Integer part
+    unsigned long whole = (unsigned long)value;
+    double remainder = value - (double)whole;
+    char digits[12];
+    int count = 0;
+    do {
+      digits[count++] = '0' + (whole % 10);
+      whole /= 10;
+    } while (whole);
+    while (count) tmp[n++] = digits[--count];
+    
+    // Fractional part
+    if (decimals) {
+      tmp[n++] = '.';
+      while (decimals--) {
+        remainder *= 10.0;
+        int digit = (int)remainder;
+        if (digit > 9) digit = 9;
+        tmp[n++] = '0' + digit;
+        remainder -= digit;
+      }
+    }
+    
+    if (exponent) {
+      n += snprintf(tmp + n, sizeof(tmp) - n, "e%d", exponent);
+    }
+  }
+  
+  if (n >= size) n = size - 1;
+  memcpy(out, tmp, n);
+  out[n] = '\0';
+  return n;
+}
 
 // =============================================================================
 // AUTO-REGISTRATION SYSTEM
 // =============================================================================
 VwireAutoHandler _vwireAutoReceiveHandlers[VWIRE_MAX_AUTO_HANDLERS];
 uint8_t _vwireAutoReceiveCount = 0;
+VwireAutoReadHandler _vwireAutoReadHandlers[VWIRE_MAX_AUTO_HANDLERS];
+uint8_t _vwireAutoReadCount = 0;
 ConnectionHandler _vwireAutoConnectHandler = nullptr;
 ConnectionHandler _vwireAutoDisconnectHandler = nullptr;
 
@@ -33,6 +114,14 @@ void _vwireRegisterReceiveHandler(uint8_t pin, PinHandler handler) {
   }
 }
 
+void _vwireRegisterReadHandler(uint8_t pin, ReadHandler handler) {
+  if (_vwireAutoReadCount < VWIRE_MAX_AUTO_HANDLERS) {
+    _vwireAutoReadHandlers[_vwireAutoReadCount].pin = pin;
+    _vwireAutoReadHandlers[_vwireAutoReadCount].handler = handler;
+    _vwireAutoReadCount++;
+  }
+}
+
 void _vwireRegisterConnectHandler(ConnectionHandler handler) {
   _vwireAutoConnectHandler = handler;
 }
@@ -47,30 +136,130 @@ void _vwireRegisterDisconnectHandler(ConnectionHandler handler) {
 VwireClass::VwireClass() 
   : _state(VWIRE_STATE_IDLE)
   , _lastError(VWIRE_ERR_NONE)
+  , _heartbeatStats(false)
+  #if VWIRE_ENABLE_STATS
+  , _publishStartedAt(0)
+  #endif
   , _debug(false)
   , _debugStream(&Serial)
   , _startTime(0)
   , _lastHeartbeat(0)
   , _lastReconnectAttempt(0)
+  , _connectStage(STAGE_IDLE)
+  , _stageStartedAt(0)
+  , _dnsCached(false)
+  , _dnsCachedAt(0)
+  , _dnsValidFor(0)
+  , _dnsServerHash(0)
+  , _reconnectDelay(VWIRE_DEFAULT_RECONNECT_INTERVAL)
+  , _reconnectAttempts(0)
+  , _jitterState(0)
   , _mqttClient(_wifiClient)  // Initialize with WiFiClient - CRITICAL!
+  , _transport(&_mqttClient)
+  , _mqtt(&_mqttClient)
+  , _owner(nullptr)
+  , _attachedCount(0)
   , _pinHandlerCount(0)
+  , _readHandlerCount(0)
+  , _readingPin(-1)
+  , _readCacheCount(0)
+  , _coalesceCount(0)
+  , _coalesceHeld(0)
+  , _topicPrefixLen(0)
+  , _sessionLength(0)
+  , _sessionOptions(0)
   , _connectHandler(nullptr)
   , _disconnectHandler(nullptr)
   , _messageHandler(nullptr)
+  , _otaTarget(nullptr)
+  , _otaHandler(nullptr)
+  , _otaWindowEnd(0)
+  , _otaRequestedAt(0)
+  , _otaRetries(0)
+  , _otaApplyPending(false)
+  , _otaDoneAt(0)
+  , _pendingHead(VWIRE_PENDING_NONE)
+  , _pendingTail(VWIRE_PENDING_NONE)
+  , _pendingCount(0)
+  , _pendingUnsent(0)
   , _deliveryCallback(nullptr)
   , _msgIdCounter(0)
+  , _policyCount(0)
+  , _policyHeld(0)
+  , _queuedCount(0)
+  , _queueCursor(0)
+  , _publishRate(0)
+  , _publishBurst(1)
+  , _publishTokens(0)
+  , _lastTokenRefill(0)
+  , _scratchUsed(0)
+  , _batching(false)
+  , _batchLen(0)
+  , _batchCount(0)
+  , _batchBinary(false)
+  , _binaryActive(false)
+  , _seriesArenaUsed(0)
+  , _seriesCount(0)
+  , _seriesDelta(false)
+  , _timeSource(nullptr)
+  , _replayBatch(VWIRE_DEFAULT_REPLAY_BATCH)
+  , _replayInterval(VWIRE_DEFAULT_REPLAY_INTERVAL)
+  , _lastReplay(0)
+  , _wifiSsid(nullptr)
+  , _wifiPassword(nullptr)
+  , _resumeChannel(0)
+  , _fastJoin(false)
+  , _wokeFromSleep(false)
+  , _lastAwakeTime(0)
+  #if VWIRE_HAS_NET_TASK
+  , _netTask(nullptr)
+  , _netStopping(false)
+  , _netDispatch(VWIRE_DISPATCH_LOOP)
+  #endif
   #if VWIRE_HAS_OTA
   , _otaEnabled(false)
   #endif
 {
   memset(_deviceId, 0, sizeof(_deviceId));
   memset(_pinHandlers, 0, sizeof(_pinHandlers));
+  memset(_pinDispatch, 0, sizeof(_pinDispatch));
+  memset(_readHandlers, 0, sizeof(_readHandlers));
+  memset(_readDispatch, 0, sizeof(_readDispatch));
+  memset(_readCaches, 0, sizeof(_readCaches));
+  memset(_coalesce, 0, sizeof(_coalesce));
   memset(_pendingMessages, 0, sizeof(_pendingMessages));
-  _vwireInstance = this;
+  memset(_pendingIndex, VWIRE_PENDING_NONE, sizeof(_pendingIndex));
+  memset(_packetIndex, VWIRE_PENDING_NONE, sizeof(_packetIndex));
+  for (uint8_t i = 0; i < VWIRE_MAX_PENDING_MESSAGES; i++) {
+    _pendingMessages[i].next = (i + 1 < VWIRE_MAX_PENDING_MESSAGES) ? i + 1 : VWIRE_PENDING_NONE;
+  }
+  _pendingFree = 0;
+  memset(_policies, 0, sizeof(_policies));
+  memset(_publishQueue, 0, sizeof(_publishQueue));
+  memset(_resumeBssid, 0, sizeof(_resumeBssid));
+  memset(_batchBuffer, 0, sizeof(_batchBuffer));
+  memset(_attached, 0, sizeof(_attached));
+  _updateTopicPrefix();
+  
+  for (uint8_t i = 0; i < VWIRE_MAX_DEVICES; i++) {
+    if (!_vwireRegistry[i]) {
+      _vwireRegistry[i] = this;
+      break;
+    }
+  }
 }
 
 VwireClass::~VwireClass() {
-  disconnect();
+  if (_owner) {
+    detach();
+  } else {
+    while (_attachedCount) _attached[_attachedCount - 1]->detach();
+    disconnect();
+  }
+  
+  for (uint8_t i = 0; i < VWIRE_MAX_DEVICES; i++) {
+    if (_vwireRegistry[i] == this) _vwireRegistry[i] = nullptr;
+  }
 }
 
 // =============================================================================
@@ -95,6 +284,8 @@ void VwireClass::config(const char* authToken, const char* server, uint16_t port
   // Use FULL auth token as device ID for topic authorization
   strncpy(_deviceId, authToken, VWIRE_MAX_TOKEN_LENGTH - 1);
   _deviceId[VWIRE_MAX_TOKEN_LENGTH - 1] = '\0';
+  _updateTopicPrefix();
+  _buildSessionPackets();
   
   _debugPrintf("[Vwire] Config: server=%s, port=%d, transport=%s", 
                _settings.server, _settings.port,
@@ -107,6 +298,8 @@ void VwireClass::config(const VwireSettings& settings) {
   // Use FULL auth token as device ID for topic authorization
   strncpy(_deviceId, settings.authToken, VWIRE_MAX_TOKEN_LENGTH - 1);
   _deviceId[VWIRE_MAX_TOKEN_LENGTH - 1] = '\0';
+  _updateTopicPrefix();
+  _buildSessionPackets();
 }
 
 void VwireClass::setTransport(VwireTransport transport) {
@@ -115,24 +308,67 @@ void VwireClass::setTransport(VwireTransport transport) {
                transport == VWIRE_TRANSPORT_TCP_SSL ? "TLS" : "TCP");
 }
 
+bool VwireClass::setMqttTransport(VwireMqttTransport& transport) {
+  if (_owner || _connectStage != STAGE_IDLE || _mqtt->connected()) return false;
+  _transport = &transport;
+  _mqtt = &transport;
+  
+  // Attached devices follow their owner's client
+  for (uint8_t i = 0; i < _attachedCount; i++) {
+    _attached[i]->_mqtt = &transport;
+  }
+  _debugPrintf("[Vwire] MQTT client: %s", transport.supportsQos1() ? "QoS 1" : "QoS 0");
+  return true;
+}
+
 void VwireClass::setAutoReconnect(bool enable) {
   _settings.autoReconnect = enable;
 }
 
 void VwireClass::setReconnectInterval(unsigned long interval) {
   _settings.reconnectInterval = interval;
+  if (_reconnectAttempts == 0) _reconnectDelay = interval;
+}
+
+void VwireClass::setReconnectBackoff(uint8_t factor, unsigned long maxDelay, uint8_t jitterPercent) {
+  _settings.reconnectBackoff = VwireBackoff(factor ? factor : 1, maxDelay, min(jitterPercent, (uint8_t)100));
+}
+
+void VwireClass::setDnsCacheTtl(unsigned long ttl) {
+  _settings.dnsCacheTtl = ttl;
+  if (ttl == 0) _dnsCached = false;
+}
+
+void VwireClass::setTlsSessionReuse(bool enable) {
+  _settings.tlsSessionReuse = enable;
+}
+
+void VwireClass::setTlsConnectByAddress(bool enable) {
+  _settings.tlsConnectByAddress = enable;
 }
 
 void VwireClass::setHeartbeatInterval(unsigned long interval) {
   _settings.heartbeatInterval = interval;
 }
 
+void VwireClass::setSyncOnConnect(bool enable) {
+  _settings.syncOnConnect = enable;
+}
+
 void VwireClass::setDataQoS(uint8_t qos) {
-  // Note: PubSubClient library only supports QoS 0
-  // This setting is kept for future compatibility if we switch to a different MQTT library
+  // Used by transports that publish at QoS 1 (PubSubClient stays at 0)
   _settings.dataQoS = (qos > 1) ? 1 : qos;
 }
 
+void VwireClass::setEncoding(VwireEncoding encoding) {
+  _settings.encoding = encoding;
+  if (encoding == VWIRE_ENCODING_TEXT) _binaryActive = false;
+}
+
+bool VwireClass::isBinaryActive() {
+  return _binaryActive;
+}
+
 void VwireClass::setDataRetain(bool retain) {
   _settings.dataRetain = retain;
 }
@@ -150,10 +386,190 @@ void VwireClass::setMaxRetries(uint8_t retries) {
   _settings.maxRetries = retries;
 }
 
+void VwireClass::setAckMode(VwireAckMode mode) {
+  _settings.ackMode = mode;
+}
+
+void VwireClass::setRetryBackoff(uint8_t factor, unsigned long maxDelay, uint8_t jitterPercent) {
+  _settings.retryBackoff = VwireBackoff(factor ? factor : 1, maxDelay, min(jitterPercent, (uint8_t)100));
+}
+
 void VwireClass::onDeliveryStatus(DeliveryCallback cb) {
   _deliveryCallback = cb;
 }
 
+// =============================================================================
+// CONNECTION CACHE
+// =============================================================================
+static uint32_t _vwireHashBytes(const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  uint32_t hash = 2166136261UL;  // FNV-1a
+  while (len--) {
+    hash ^= *p++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+#if VWIRE_HAS_RTC_CACHE
+#define VWIRE_RTC_CACHE_MAGIC 0x56574331UL  // "VWC1"
+
+// Image kept in RTC memory across deep sleep
+struct VwireRtcCache {
+  uint32_t magic;
+  uint32_t check;                         // FNV-1a over the fields below
+  uint32_t server;                        // Hash of the hostname ip belongs to
+  uint32_t validFor;                      // Address lifetime left after the sleep (ms)
+  uint8_t ip[4];
+  uint32_t msgId;                         // Message counter, so IDs keep increasing
+  uint32_t awake;                         // Wake-to-sleep time of the cycle (ms)
+  uint8_t bssid[6];                       // Access point for the fast join
+  uint8_t channel;                        // 0 = no WiFi state
+  uint8_t sleeping;                       // Written by sleepFor()
+  #if defined(VWIRE_BOARD_ESP8266) && VWIRE_HAS_SSL
+  uint32_t hasSession;
+  uint8_t session[(sizeof(BearSSL::Session) + 3) & ~3];
+  #endif
+};
+
+#if defined(VWIRE_BOARD_ESP32)
+RTC_DATA_ATTR static VwireRtcCache _vwireRtcCache;
+#endif
+
+static uint32_t _vwireRtcCheck(const VwireRtcCache& cache) {
+  const size_t skip = 2 * sizeof(uint32_t);  // magic + check
+  return _vwireHashBytes((const uint8_t*)&cache + skip, sizeof(cache) - skip);
+}
+
+static bool _vwireRtcWrite(VwireRtcCache& cache) {
+  cache.magic = VWIRE_RTC_CACHE_MAGIC;
+  cache.check = _vwireRtcCheck(cache);
+  #if defined(VWIRE_BOARD_ESP32)
+  _vwireRtcCache = cache;
+  return true;
+  #else
+  return ESP.rtcUserMemoryWrite(VWIRE_RTC_CACHE_OFFSET, (uint32_t*)&cache, sizeof(cache));
+  #endif
+}
+
+static void _vwireRtcInvalidate() {
+  #if defined(VWIRE_BOARD_ESP32)
+  _vwireRtcCache.magic = 0;
+  #else
+  uint32_t zero = 0;
+  ESP.rtcUserMemoryWrite(VWIRE_RTC_CACHE_OFFSET, &zero, sizeof(zero));
+  #endif
+}
+
+static bool _vwireRtcRead(VwireRtcCache& cache) {
+  #if defined(VWIRE_BOARD_ESP32)
+  cache = _vwireRtcCache;
+  #else
+  if (!ESP.rtcUserMemoryRead(VWIRE_RTC_CACHE_OFFSET, (uint32_t*)&cache, sizeof(cache))) return false;
+  #endif
+  return cache.magic == VWIRE_RTC_CACHE_MAGIC && cache.check == _vwireRtcCheck(cache);
+}
+#endif
+
+bool VwireClass::_dnsCacheFresh() {
+  if (!_dnsCached || _settings.dnsCacheTtl == 0) return false;
+  if (millis() - _dnsCachedAt >= _dnsValidFor) return false;
+  // Cached address belongs to the configured broker only
+  return _dnsServerHash == _vwireHashBytes(_settings.server, strlen(_settings.server));
+}
+
+bool VwireClass::saveConnectionCache(unsigned long sleepMs) {
+  return _saveRtcState(sleepMs, false);
+}
+
+bool VwireClass::_saveRtcState(unsigned long sleepMs, bool sleeping) {
+  #if VWIRE_HAS_RTC_CACHE
+  VwireRtcCache cache;
+  memset(&cache, 0, sizeof(cache));
+  cache.sleeping = sleeping;
+  cache.awake = millis();  // millis() restarts on every wake
+  
+  if (_dnsCacheFresh()) {
+    unsigned long left = _dnsValidFor - (millis() - _dnsCachedAt);
+    if (left > sleepMs) {
+      cache.server = _dnsServerHash;
+      cache.validFor = left - sleepMs;
+      for (uint8_t i = 0; i < 4; i++) cache.ip[i] = _serverIP[i];
+    }
+  }
+  
+  if (WiFi.status() == WL_CONNECTED) {
+    const uint8_t* bssid = WiFi.BSSID();
+    if (bssid) {
+      memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+      cache.channel = (uint8_t)WiFi.channel();
+    }
+  }
+  cache.msgId = _msgIdCounter;
+  
+  #if defined(VWIRE_BOARD_ESP8266) && VWIRE_HAS_SSL
+  if (_settings.tlsSessionReuse) {
+    memcpy(cache.session, &_tlsSession, sizeof(_tlsSession));
+    cache.hasSession = 1;
+  }
+  #endif
+  
+  bool ok = _vwireRtcWrite(cache);
+  _debugPrintf("[Vwire] Connection cache %s", ok ? "saved" : "not saved");
+  return ok;
+  #else
+  (void)sleepMs;
+  (void)sleeping;
+  return false;
+  #endif
+}
+
+void VwireClass::clearConnectionCache() {
+  _dnsCached = false;
+  #if defined(VWIRE_BOARD_ESP8266) && VWIRE_HAS_SSL
+  _tlsSession = BearSSL::Session();
+  #endif
+  #if VWIRE_HAS_RTC_CACHE
+  _vwireRtcInvalidate();
+  #endif
+}
+
+void VwireClass::_restoreConnectionCache() {
+  #if VWIRE_HAS_RTC_CACHE
+  VwireRtcCache cache;
+  if (!_vwireRtcRead(cache)) return;
+  _vwireRtcInvalidate();  // One-shot - a later reset starts clean
+  
+  if (cache.validFor && _settings.dnsCacheTtl &&
+      cache.server == _vwireHashBytes(_settings.server, strlen(_settings.server))) {
+    _serverIP = IPAddress(cache.ip[0], cache.ip[1], cache.ip[2], cache.ip[3]);
+    _dnsCached = true;
+    _dnsCachedAt = millis();
+    _dnsValidFor = min((unsigned long)cache.validFor, _settings.dnsCacheTtl);
+    _dnsServerHash = cache.server;
+    _debugPrintf("[Vwire] Restored broker address %s", _serverIP.toString().c_str());
+  }
+  
+  if (cache.channel) {
+    memcpy(_resumeBssid, cache.bssid, sizeof(_resumeBssid));
+    _resumeChannel = cache.channel;
+  }
+  if (cache.msgId > _msgIdCounter) _msgIdCounter = cache.msgId;
+  if (cache.sleeping) {
+    _wokeFromSleep = true;
+    _lastAwakeTime = cache.awake;
+    _debugPrintf("[Vwire] Resumed from sleep (last cycle awake %lu ms)", _lastAwakeTime);
+  }
+  
+  #if defined(VWIRE_BOARD_ESP8266) && VWIRE_HAS_SSL
+  if (cache.hasSession && _settings.tlsSessionReuse) {
+    memcpy(&_tlsSession, cache.session, sizeof(_tlsSession));
+    _debugPrint("[Vwire] Restored TLS session");
+  }
+  #endif
+  #endif
+}
+
 // =============================================================================
 // CONNECTION
 // =============================================================================
@@ -170,130 +586,407 @@ void VwireClass::_setupClient() {
     // RX=2048 for incoming, TX=1024 for outgoing (TLS overhead needs ~500+ bytes)
     _secureClient.setBufferSizes(2048, 1024);
     _secureClient.setTimeout(10000);  // 10 second timeout (ms for ESP8266)
+    // BearSSL stores the negotiated session here after each handshake and
+    // offers it back on the next connect (falls back to a full handshake
+    // if the broker declines)
+    _secureClient.setSession(_settings.tlsSessionReuse ? &_tlsSession : nullptr);
     #endif
     
-    _mqttClient.setClient(_secureClient);
+    _mqtt->setClient(_secureClient);
     _debugPrint("[Vwire] Using TLS/SSL client");
   } else
   #endif
   {
-    _mqttClient.setClient(_wifiClient);
+    _mqtt->setClient(_wifiClient);
     _debugPrint("[Vwire] Using plain TCP client");
   }
   
-  _mqttClient.setServer(_settings.server, _settings.port);
-  _mqttClient.setCallback(_mqttCallbackWrapper);
-  _mqttClient.setBufferSize(VWIRE_MAX_PAYLOAD_LENGTH);
-  _mqttClient.setKeepAlive(30);       // 30 second keepalive (faster disconnect detection)
-  _mqttClient.setSocketTimeout(5);    // 5 second socket timeout (faster error detection)
+  _mqtt->setServer(_settings.server, _settings.port);
+  _mqtt->setCallback(_mqttCallbackWrapper);
+  _mqtt->setAckCallback(_mqttAckWrapper, this);
+  _mqtt->setBufferSize(VWIRE_MAX_PAYLOAD_LENGTH + 1);  // +1 keeps room to terminate in place
+  _mqtt->setKeepAlive(30);       // 30 second keepalive (faster disconnect detection)
+  _mqtt->setSocketTimeout(5);    // 5 second socket timeout (faster error detection)
+  
+  // Pick up a cache saved before deep sleep
+  if (!_dnsCached) _restoreConnectionCache();
 }
 
 bool VwireClass::_connectWiFi(const char* ssid, const char* password) {
-  _state = VWIRE_STATE_CONNECTING_WIFI;
   _debugPrintf("[Vwire] Connecting to WiFi: %s", ssid);
   
   WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid, password);
-  
-  unsigned long startAttempt = millis();
+  _wifiSsid = ssid;
+  _wifiPassword = password;
+  _fastJoin = _resumeChannel != 0;
+  if (_fastJoin) {
+    // Known channel and access point - skips the scan
+    _debugPrintf("[Vwire] Fast join on channel %d", _resumeChannel);
+    WiFi.begin(ssid, password, _resumeChannel, _resumeBssid);
+  } else {
+    WiFi.begin(ssid, password);
+  }
   
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
+  _startConnect(STAGE_WIFI);
+  return true;
+}
+
+bool VwireClass::_connectMQTT() {
+  // Blocking wrapper around the staged connect (used by begin())
+  _startConnect(STAGE_DNS);
+  return _finishConnect();
+}
+
+bool VwireClass::_finishConnect() {
+  for (;;) {
+    ConnectResult result = _advanceConnect();
+    if (result != CONNECT_PENDING) return result == CONNECT_DONE;
+    if (_connectStage == STAGE_WIFI) {
+      delay(100);
+      _debugPrint(".");
+    }
     yield();
-    _debugPrint(".");
+  }
+}
+
+void VwireClass::_startConnect(ConnectStage stage) {
+  _connectStage = stage;
+  _stageStartedAt = millis();
+  _state = (stage == STAGE_WIFI) ? VWIRE_STATE_CONNECTING_WIFI : VWIRE_STATE_CONNECTING_MQTT;
+}
+
+VwireClass::ConnectResult VwireClass::_failConnect(VwireError error) {
+  _setError(error);
+  _connectStage = STAGE_IDLE;
+  _state = VWIRE_STATE_ERROR;
+  _activeClient().stop();
+  return CONNECT_FAILED;
+}
+
+Client& VwireClass::_activeClient() {
+  #if VWIRE_HAS_SSL
+  if (_settings.transport == VWIRE_TRANSPORT_TCP_SSL) return _secureClient;
+  #endif
+  return _wifiClient;
+}
+
+VwireClass::ConnectResult VwireClass::_advanceConnect() {
+  // One stage per call, so run() returns between WiFi, DNS, TCP/TLS, MQTT
+  // and subscribe. Each step is bounded; the DNS lookup (when the cache is
+  // stale) and the TLS handshake still block for their own duration
+  unsigned long now = millis();
+  
+  switch (_connectStage) {
+    case STAGE_IDLE:
+      return connected() ? CONNECT_DONE : CONNECT_FAILED;
     
-    if (millis() - startAttempt >= _settings.wifiTimeout) {
-      _debugPrint("\n[Vwire] WiFi connection timeout!");
-      _setError(VWIRE_ERR_WIFI_FAILED);
-      _state = VWIRE_STATE_ERROR;
-      return false;
+    case STAGE_WIFI:
+      if (WiFi.status() != WL_CONNECTED) {
+        if (_fastJoin && now - _stageStartedAt >= VWIRE_FAST_JOIN_TIMEOUT) {
+          // Access point moved or changed channel - fall back to a full scan
+          _debugPrint("\n[Vwire] Fast join failed, scanning");
+          _fastJoin = false;
+          _resumeChannel = 0;
+          WiFi.disconnect();
+          WiFi.begin(_wifiSsid, _wifiPassword);
+          _startConnect(STAGE_WIFI);
+          return CONNECT_PENDING;
+        }
+        if (now - _stageStartedAt < _settings.wifiTimeout) return CONNECT_PENDING;
+        _debugPrint("\n[Vwire] WiFi connection timeout!");
+        return _failConnect(VWIRE_ERR_WIFI_FAILED);
+      }
+      _fastJoin = false;
+      _debugPrintf("\n[Vwire] WiFi connected! IP: %s", WiFi.localIP().toString().c_str());
+      _startConnect(STAGE_DNS);
+      return CONNECT_PENDING;
+    
+    case STAGE_DNS:
+      if (strlen(_settings.authToken) == 0) {
+        _debugPrint("[Vwire] Error: No auth token configured!");
+        return _failConnect(VWIRE_ERR_NO_TOKEN);
+      }
+      _debugPrintf("[Vwire] Connecting to MQTT: %s:%d", _settings.server, _settings.port);
+      if (_dnsCacheFresh()) {
+        _debugPrintf("[Vwire] Using cached address %s", _serverIP.toString().c_str());
+      } else {
+        _dnsCached = false;
+        if (WiFi.hostByName(_settings.server, _serverIP) != 1) {
+          _debugPrintf("[Vwire] DNS lookup failed: %s", _settings.server);
+          return _failConnect(VWIRE_ERR_MQTT_FAILED);
+        }
+        if (_settings.dnsCacheTtl) {
+          _dnsCached = true;
+          _dnsCachedAt = millis();
+          _dnsValidFor = _settings.dnsCacheTtl;
+          _dnsServerHash = _vwireHashBytes(_settings.server, strlen(_settings.server));
+        }
+      }
+      _startConnect(STAGE_TRANSPORT);
+      return CONNECT_PENDING;
+    
+    case STAGE_TRANSPORT: {
+      // TCP connect, plus the TLS handshake for MQTTS (bounded by the client
+      // timeouts set in _setupClient)
+      bool secure = false;
+      int ok;
+      #if VWIRE_ENABLE_STATS
+      uint32_t started = micros();
+      #endif
+      #if VWIRE_HAS_SSL
+      secure = (_settings.transport == VWIRE_TRANSPORT_TCP_SSL);
+      #endif
+      if (secure) {
+        #if defined(VWIRE_BOARD_ESP32)
+        // Resolved address plus hostname for SNI - no second lookup
+        ok = _secureClient.connect(_serverIP, _settings.port, _settings.server,
+                                   nullptr, nullptr, nullptr);
+        #else
+        // BearSSL only sends SNI when given the hostname, and then resolves
+        // it again - the cached address is used only without SNI
+        if (_settings.tlsConnectByAddress) {
+          ok = _activeClient().connect(_serverIP, _settings.port);
+        } else {
+          ok = _activeClient().connect(_settings.server, _settings.port);
+        }
+        #endif
+      } else {
+        ok = _activeClient().connect(_serverIP, _settings.port);
+      }
+      #if VWIRE_ENABLE_STATS
+      if (ok == 1) _stats.connectTime.add(micros() - started);
+      #endif
+      if (ok != 1) {
+        _debugPrintf("[Vwire] %s connect failed", secure ? "TLS" : "TCP");
+        _dnsCached = false;  // Broker may have moved - resolve again next time
+        return _failConnect(secure ? VWIRE_ERR_SSL_FAILED : VWIRE_ERR_MQTT_FAILED);
+      }
+      _startConnect(STAGE_MQTT);
+      return CONNECT_PENDING;
+    }
+    
+    case STAGE_MQTT: {
+      if (!_activeClient().connected()) {
+        return _failConnect(VWIRE_ERR_TIMEOUT);
+      }
+      
+      // Generate client ID from device ID
+      char clientId[VWIRE_MAX_TOKEN_LENGTH + 8];
+      snprintf(clientId, sizeof(clientId), "vwire-%s", _deviceId);
+      
+      // Last will message
+      char willTopic[VWIRE_MAX_TOPIC_LENGTH];
+      _buildTopic(willTopic, "status");
+      const char* willMessage = "{\"status\":\"offline\"}";
+      
+      _debugPrintf("[Vwire] MQTT connecting as: %s", clientId);
+      
+      // Transport is already up, so this only sends CONNECT and waits for
+      // CONNACK - mqttTimeout bounds that wait (whole seconds, at least 1)
+      unsigned long waitFor = (_settings.mqttTimeout + 999) / 1000;
+      if (waitFor == 0) waitFor = 1;
+      if (waitFor > 0xFFFF) waitFor = 0xFFFF;
+      _mqtt->setSocketTimeout((uint16_t)waitFor);
+      // Connect with token as both username and password (server validates password)
+      bool accepted = _mqtt->connect(clientId, _settings.authToken, _settings.authToken,
+                                     willTopic, 1, true, willMessage);
+      _mqtt->setSocketTimeout(5);  // Back to the normal socket timeout
+      if (!accepted) {
+        _debugPrintf("[Vwire] MQTT failed, state=%d", _mqtt->state());
+        return _failConnect(VWIRE_ERR_MQTT_FAILED);
+      }
+      _startConnect(STAGE_SUBSCRIBE);
+      return CONNECT_PENDING;
     }
+    
+    case STAGE_SUBSCRIBE:
+      _connectStage = STAGE_IDLE;
+      _onMqttConnected();
+      return CONNECT_DONE;
   }
-  
-  _debugPrintf("\n[Vwire] WiFi connected! IP: %s", WiFi.localIP().toString().c_str());
-  return true;
+  return CONNECT_FAILED;
 }
 
-bool VwireClass::_connectMQTT() {
-  if (strlen(_settings.authToken) == 0) {
-    _setError(VWIRE_ERR_NO_TOKEN);
-    _debugPrint("[Vwire] Error: No auth token configured!");
-    return false;
+void VwireClass::_onMqttConnected() {
+  _state = VWIRE_STATE_CONNECTED;
+  _debugPrint("[Vwire] MQTT connected!");
+  
+  // Online status, subscriptions (cmd/# at QoS 1; read/#, ack and enc when
+  // needed) and the encoding/sync requests go out as one write - the packets
+  // were preformatted, so a reconnect builds no topics and allocates nothing
+  if (_sessionLength == 0 || _sessionOptions != _currentSessionOptions()) {
+    _buildSessionPackets();
+  }
+  if (!_mqtt->writePackets(_sessionPackets, _sessionLength)) {
+    _debugPrint("[Vwire] Session setup write failed");
   }
+  #if VWIRE_ENABLE_STATS
+  _stats.bytesSent += _sessionLength;
+  #endif
+  _binaryActive = false;  // Text until the server confirms
   
-  _state = VWIRE_STATE_CONNECTING_MQTT;
-  _debugPrintf("[Vwire] Connecting to MQTT: %s:%d", _settings.server, _settings.port);
+  _startTime = millis();
   
-  // Generate client ID from device ID
-  String clientId = "vwire-";
-  clientId += _deviceId;
+  // A new session - packet IDs of the old one mean nothing now, so pending
+  // messages go out again as new ones
+  for (uint8_t i = 0; i < VWIRE_MAX_PENDING_MESSAGES; i++) {
+    _pendingMessages[i].packetId = 0;
+  }
+  memset(_packetIndex, VWIRE_PENDING_NONE, sizeof(_packetIndex));
+  _pendingUnsent = _pendingCount;
   
-  // Last will message
-  String willTopic = _buildTopic("status");
-  const char* willMessage = "{\"status\":\"offline\"}";
+  // Publish fresh values after a reconnect, whatever policies say
+  for (int i = 0; i < VWIRE_MAX_PUBLISH_POLICIES; i++) {
+    _policies[i].hasLast = false;
+  }
   
-  _debugPrintf("[Vwire] MQTT connecting as: %s", clientId.c_str());
+  // An interrupted firmware download continues where it stopped
+  if (_ota.active()) {
+    _otaRetries = 0;
+    _requestOtaWindow();
+  }
   
-  // Connect with token as both username and password (server validates password)
-  bool connected = _mqttClient.connect(clientId.c_str(), _settings.authToken, _settings.authToken, 
-                          willTopic.c_str(), 1, true, willMessage);
+  _notifyConnection(true);
   
-  if (connected) {
-    _state = VWIRE_STATE_CONNECTED;
-    _debugPrint("[Vwire] MQTT connected!");
-    
-    // Publish online status (retained so server knows device is online)
-    _mqttClient.beginPublish(willTopic.c_str(), 19, true);  // retained=true
-    _mqttClient.print("{\"status\":\"online\"}");
-    _mqttClient.endPublish();
-    
-    // Subscribe to command topics with QoS 1 for reliable command delivery
-    String cmdTopic = _buildTopic("cmd") + "/#";
-    _mqttClient.subscribe(cmdTopic.c_str(), 1);  // QoS 1 - commands are delivered at least once
-    _debugPrintf("[Vwire] Subscribed to: %s (QoS 1)", cmdTopic.c_str());
-    
-    // Subscribe to ACK topic for reliable delivery (if enabled)
-    if (_settings.reliableDelivery) {
-      String ackTopic = _buildTopic("ack");
-      _mqttClient.subscribe(ackTopic.c_str(), 1);
-      _debugPrintf("[Vwire] Subscribed to: %s (ACK)", ackTopic.c_str());
+  // Attached devices share this session - bring each of them online too
+  for (uint8_t i = 0; i < _attachedCount; i++) {
+    _attached[i]->_onMqttConnected();
+  }
+}
+
+uint8_t VwireClass::_currentSessionOptions() {
+  uint8_t options = 0;
+  if (_hasReadHandlers()) options |= SESSION_READ;
+  // No ack topic when the broker's PUBACK is the ACK
+  if (_settings.reliableDelivery && !_mqtt->supportsQos1()) options |= SESSION_ACK;
+  if (_settings.encoding == VWIRE_ENCODING_BINARY) options |= SESSION_ENC;
+  if (_settings.syncOnConnect) options |= SESSION_SYNC;
+  if (_otaTarget) options |= SESSION_OTA;
+  return options;
+}
+
+void VwireClass::_buildSessionPackets() {
+  _sessionLength = 0;
+  _sessionOptions = _currentSessionOptions();
+  uint16_t packetId = VWIRE_SESSION_PACKET_ID;
+  bool ok = _appendSessionPacket(0x31, 0, "status", "{\"status\":\"online\"}", -1)  // Retained
+         && _appendSessionPacket(0x82, packetId++, "cmd/#", nullptr, 1);
+  if (ok && (_sessionOptions & SESSION_READ)) {
+    ok = _appendSessionPacket(0x82, packetId++, "read/#", nullptr, 0);  // The server polls again
+  }
+  if (ok && (_sessionOptions & SESSION_ACK)) {
+    ok = _appendSessionPacket(0x82, packetId++, "ack", nullptr, 1);
+  }
+  if (ok && (_sessionOptions & SESSION_ENC)) {
+    ok = _appendSessionPacket(0x82, packetId++, "enc", nullptr, 1)
+      && _appendSessionPacket(0x30, 0, "enc/req", VWIRE_BINARY_PROTOCOL, -1);
+  }
+  if (ok && (_sessionOptions & SESSION_OTA)) {
+    // Chunks at QoS 0 - a lost one is requested again
+    ok = _appendSessionPacket(0x82, packetId++, "ota", nullptr, 1)
+      && _appendSessionPacket(0x82, packetId++, "ota/data", nullptr, 0);
+  }
+  if (ok && (_sessionOptions & SESSION_SYNC)) {
+    ok = _appendSessionPacket(0x30, 0, "sync", "all", -1);
+  }
+  if (!ok) _setError(VWIRE_ERR_BUFFER_FULL);  // Sized for the worst case - not expected
+  _debugPrintf("[Vwire] Session setup: %u bytes", _sessionLength);
+}
+
+bool VwireClass::_appendSessionPacket(uint8_t header, uint16_t packetId, const char* type,
+                                      const char* payload, int subscribeQos) {
+  // PUBLISH (QoS 0): [topic][payload]; SUBSCRIBE: [packet ID][topic][QoS]
+  size_t typeLen = strlen(type);
+  size_t topicLen = _topicPrefixLen + typeLen;
+  size_t payloadLen = payload ? strlen(payload) : 0;
+  size_t remaining = 2 + topicLen + payloadLen + (subscribeQos >= 0 ? 3 : 0);
+  size_t lengthBytes = remaining < 128 ? 1 : 2;
+  if (_sessionLength + 1 + lengthBytes + remaining > sizeof(_sessionPackets)) return false;
+  
+  uint8_t* p = _sessionPackets + _sessionLength;
+  *p++ = header;
+  if (lengthBytes == 2) {
+    *p++ = (uint8_t)(remaining & 0x7F) | 0x80;
+    *p++ = (uint8_t)(remaining >> 7);
+  } else {
+    *p++ = (uint8_t)remaining;
+  }
+  if (subscribeQos >= 0) {
+    *p++ = (uint8_t)(packetId >> 8);
+    *p++ = (uint8_t)packetId;
+  }
+  *p++ = (uint8_t)(topicLen >> 8);
+  *p++ = (uint8_t)topicLen;
+  memcpy(p, _topicPrefix, _topicPrefixLen);
+  p += _topicPrefixLen;
+  memcpy(p, type, typeLen);
+  p += typeLen;
+  if (subscribeQos >= 0) *p++ = (uint8_t)subscribeQos;
+  if (payloadLen) {
+    memcpy(p, payload, payloadLen);
+    p += payloadLen;
+  }
+  _sessionLength = p - _sessionPackets;
+  return true;
+}
+
+void VwireClass::_notifyConnection(bool up) {
+  #if VWIRE_HAS_NET_TASK
+  // On the network task, leave the handlers to the application's run()
+  if (_netTask && _netDispatch == VWIRE_DISPATCH_LOOP) {
+    VwireRingRecord* rec = _netInbox.reserve();
+    if (rec) {
+      rec->type = up ? VWIRE_RING_CONNECT : VWIRE_RING_DISCONNECT;
+      _netInbox.commit();
     }
-    
-    _startTime = millis();
-    
-    // Call connect handler (manual registration first, then auto-registered)
+    return;
+  }
+  #endif
+  
+  // Manual registration first, then auto-registered
+  // (auto-registered handlers are global, so they follow the owner only)
+  if (up) {
     if (_connectHandler) _connectHandler();
-    if (_vwireAutoConnectHandler) _vwireAutoConnectHandler();
-    
-    return true;
+    if (_vwireAutoConnectHandler && !_owner) _vwireAutoConnectHandler();
   } else {
-    int mqttState = _mqttClient.state();
-    _debugPrintf("[Vwire] MQTT failed, state=%d", mqttState);
-    _setError(VWIRE_ERR_MQTT_FAILED);
-    _state = VWIRE_STATE_ERROR;
-    return false;
+    if (_disconnectHandler) _disconnectHandler();
+    if (_vwireAutoDisconnectHandler && !_owner) _vwireAutoDisconnectHandler();
   }
 }
 
 bool VwireClass::begin(const char* ssid, const char* password) {
+  return beginAsync(ssid, password) && _finishConnect();
+}
+
+bool VwireClass::begin() {
+  return beginAsync() && _finishConnect();
+}
+
+bool VwireClass::beginAsync(const char* ssid, const char* password) {
   _debugPrint("\n[Vwire] ========================================");
   _debugPrintf("[Vwire] Vwire IOT Library v%s", VWIRE_VERSION);
   _debugPrintf("[Vwire] Board: %s", VWIRE_BOARD_NAME);
   _debugPrint("[Vwire] ========================================\n");
   
+  if (_owner) {
+    _debugPrint("[Vwire] Error: attached devices connect through their owner");
+    return false;
+  }
+  
   // Setup network client first
   _setupClient();
+  _buildDispatchTable();
   
-  // Connect to WiFi
-  if (!_connectWiFi(ssid, password)) {
+  // Start WiFi association - run() (or begin()) takes it from here
+  return _connectWiFi(ssid, password);
+}
+
+bool VwireClass::beginAsync() {
+  if (_owner) {
+    _debugPrint("[Vwire] Error: attached devices connect through their owner");
     return false;
   }
   
-  // Connect to MQTT
-  return _connectMQTT();
-}
-
-bool VwireClass::begin() {
   // Assume WiFi is already connected
   if (WiFi.status() != WL_CONNECTED) {
     _debugPrint("[Vwire] Error: WiFi not connected!");
@@ -302,24 +995,41 @@ bool VwireClass::begin() {
   }
   
   _setupClient();
-  return _connectMQTT();
+  _buildDispatchTable();
+  _startConnect(STAGE_DNS);
+  return true;
 }
 
 void VwireClass::run() {
+  #if VWIRE_ENABLE_STATS
+  uint32_t started = micros();
+  _run();
+  _stats.runTime.add(micros() - started);
+  #else
+  _run();
+  #endif
+}
+
+void VwireClass::_run() {
+  #if VWIRE_HAS_NET_TASK
+  // The network task does the rest - just hand over what it received
+  if (_netPosting()) {
+    _netDrainInbox();
+    if (_netQueuesCommands() && _coalesceHeld) _flushCoalesced();
+    return;
+  }
+  #endif
+  
+  // Attached devices are driven by the owner's run()
+  if (_owner) return;
+  
   // Process MQTT messages FIRST - critical for low latency command reception
-  if (_mqttClient.connected()) {
-    _mqttClient.loop();
-    
-    // Process reliable delivery retries (if enabled)
-    if (_settings.reliableDelivery) {
-      _processRetries();
-    }
+  if (_connectStage == STAGE_IDLE && _mqtt->connected()) {
+    _mqtt->loop();
     
-    // Send heartbeat (only when connected)
-    unsigned long now = millis();
-    if (now - _lastHeartbeat >= _settings.heartbeatInterval) {
-      _lastHeartbeat = now;
-      _sendHeartbeat();
+    _serviceConnected();
+    for (uint8_t i = 0; i < _attachedCount; i++) {
+      if (_attached[i]->connected()) _attached[i]->_serviceConnected();
     }
     return;  // Fast path - everything is good
   }
@@ -336,142 +1046,689 @@ void VwireClass::run() {
   }
   #endif
   
+  // Connection in progress - advance one stage and return
+  if (_connectStage != STAGE_IDLE) {
+    ConnectResult result = _advanceConnect();
+    if (result == CONNECT_DONE) {
+      _reconnectAttempts = 0;
+      _reconnectDelay = _settings.reconnectInterval;
+      #if VWIRE_ENABLE_STATS
+      _stats.reconnects++;
+      #endif
+    } else if (result == CONNECT_FAILED) {
+      #if VWIRE_ENABLE_STATS
+      _stats.connectFailures++;
+      #endif
+      _lastReconnectAttempt = millis();
+      if (_reconnectAttempts < 255) _reconnectAttempts++;
+      _reconnectDelay = _backoffDelay(_settings.reconnectBackoff,
+                                      _settings.reconnectInterval, _reconnectAttempts);
+      _debugPrintf("[Vwire] Next reconnect in %lu ms", _reconnectDelay);
+    }
+    return;
+  }
+  
   // Check WiFi
   if (WiFi.status() != WL_CONNECTED) {
     if (_state == VWIRE_STATE_CONNECTED) {
-      _state = VWIRE_STATE_DISCONNECTED;
       _debugPrint("[Vwire] WiFi disconnected!");
-      if (_disconnectHandler) _disconnectHandler();
-      if (_vwireAutoDisconnectHandler) _vwireAutoDisconnectHandler();
+      _connectionLost();
     }
     return;
   }
   
   // MQTT disconnected but WiFi is up
   if (_state == VWIRE_STATE_CONNECTED) {
-    _state = VWIRE_STATE_DISCONNECTED;
     _debugPrint("[Vwire] MQTT disconnected!");
-    if (_disconnectHandler) _disconnectHandler();
-    if (_vwireAutoDisconnectHandler) _vwireAutoDisconnectHandler();
+    _connectionLost();
   }
   
-  // Attempt reconnect
+  // Attempt reconnect (interval grows per failure if a backoff is configured)
   if (_settings.autoReconnect) {
     unsigned long now = millis();
-    if (now - _lastReconnectAttempt >= _settings.reconnectInterval) {
+    if (now - _lastReconnectAttempt >= _reconnectDelay) {
       _lastReconnectAttempt = now;
-      _connectMQTT();
+      _startConnect(STAGE_DNS);  // Advanced by the following run() calls
     }
   }
 }
 
-bool VwireClass::connected() {
-  return _state == VWIRE_STATE_CONNECTED && _mqttClient.connected();
-}
-
-void VwireClass::disconnect() {
-  if (_mqttClient.connected()) {
-    // Publish offline status (retained so server knows device went offline)
-    char topic[96];
-    snprintf(topic, sizeof(topic), "vwire/%s/status", _deviceId);
-    _mqttClient.beginPublish(topic, 20, true);  // retained=true
-    _mqttClient.print("{\"status\":\"offline\"}");
-    _mqttClient.endPublish();
-    _mqttClient.disconnect();
+void VwireClass::_serviceConnected() {
+  // Latest value of each coalesced pin - one handler call per run(). With
+  // commands queued for loop(), the held values belong to that side.
+  if (!_netQueuesCommands() && _coalesceHeld) _flushCoalesced();
+  
+  // Cloud OTA chunk timeouts and the restart after an update
+  if (_ota.active() || _otaApplyPending) _serviceOta();
+  
+  // Values setPublishInterval() held back
+  if (_policyHeld) _flushHeldValues();
+  
+  // Process reliable delivery retries (if enabled)
+  if (_settings.reliableDelivery) {
+    _processRetries();
   }
-  _state = VWIRE_STATE_DISCONNECTED;
-}
-
-VwireState VwireClass::getState() { return _state; }
-VwireError VwireClass::getLastError() { return _lastError; }
+  
+  // Drain rate-limited publish queue (if enabled)
+  if (_queuedCount) {
+    _drainPublishQueue(false);
+  }
+  
+  // Publish record() buffers whose oldest sample reached its deadline
+  if (_seriesCount) {
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < _seriesCount; i++) {
+      if (_series[i].count && now - _series[i].firstAt >= _series[i].maxAge) {
+        _publishSeries(_series[i]);
+      }
+    }
+  }
+  
+  // Replay sends captured while offline (throttled, live traffic first)
+  if (_offlineLog.count()) {
+    _replayOfflineLog();
+  }
+  
+  // Send heartbeat (only when connected)
+  unsigned long now = millis();
+  if (now - _lastHeartbeat >= _settings.heartbeatInterval) {
+    _lastHeartbeat = now;
+    _sendHeartbeat();
+  }
+}
+
+void VwireClass::_connectionLost() {
+  _state = VWIRE_STATE_DISCONNECTED;
+  _notifyConnection(false);
+  
+  // The attached devices lost it with us
+  for (uint8_t i = 0; i < _attachedCount; i++) {
+    VwireClass* device = _attached[i];
+    if (device->_state == VWIRE_STATE_CONNECTED) {
+      device->_state = VWIRE_STATE_DISCONNECTED;
+      device->_notifyConnection(false);
+    }
+  }
+}
+
+bool VwireClass::connected() {
+  // PubSubClient may close the socket when asked - not from another task
+  if (_netPosting()) return _state == VWIRE_STATE_CONNECTED;
+  return _state == VWIRE_STATE_CONNECTED && _mqtt->connected();
+}
+
+void VwireClass::disconnect() {
+  #if VWIRE_HAS_NET_TASK
+  if (_netPosting()) stopNetworkTask();  // Own the client again first
+  #endif
+  // Attached devices go offline before the connection they share
+  for (uint8_t i = 0; i < _attachedCount; i++) {
+    _attached[i]->disconnect();
+  }
+  
+  if (_mqtt->connected() && (!_owner || _state == VWIRE_STATE_CONNECTED)) {
+    // Publish offline status (retained so server knows device went offline)
+    char topic[VWIRE_MAX_TOPIC_LENGTH];
+    _buildTopic(topic, "status");
+    _beginPublish(topic, 20, true);  // retained=true
+    _mqtt->print("{\"status\":\"offline\"}");
+    _endPublish();
+  }
+  if (_owner) {
+    // Leave the session to the owner, just stop receiving commands
+    if (_mqtt->connected()) {
+      char topic[VWIRE_MAX_TOPIC_LENGTH];
+      _buildTopic(topic, "cmd/#");
+      _mqtt->unsubscribe(topic);
+      if (_hasReadHandlers()) {
+        _buildTopic(topic, "read/#");
+        _mqtt->unsubscribe(topic);
+      }
+    }
+  } else if (_mqtt->connected()) {
+    _mqtt->disconnect();
+  }
+  _state = VWIRE_STATE_DISCONNECTED;
+}
+
+// =============================================================================
+// GATEWAY (SEVERAL DEVICES, ONE CONNECTION)
+// =============================================================================
+bool VwireClass::attachTo(VwireClass& owner) {
+  // One level only: an owner is never attached, an attached device owns nothing
+  if (&owner == this || owner._owner || _owner || _attachedCount) return false;
+  #if VWIRE_HAS_NET_TASK
+  if (_netTask || owner._netTask) return false;
+  #endif
+  if (owner._attachedCount >= VWIRE_MAX_DEVICES - 1) {
+    _setError(VWIRE_ERR_BUFFER_FULL);
+    return false;
+  }
+  if (_deviceId[0] == '\0') {
+    _setError(VWIRE_ERR_NO_TOKEN);
+    return false;
+  }
+  
+  owner._attached[owner._attachedCount++] = this;
+  _owner = &owner;
+  _mqtt = owner._mqtt;
+  _buildDispatchTable();  // Drops the auto-registered handlers
+  
+  // Flash segment files are the owner's
+  if (_offlineLog.usesFlash()) {
+    _offlineLog.end();
+    _offlineLog.begin(false);
+  }
+  
+  // Joining a live session - announce ourselves right away
+  if (owner.connected()) _onMqttConnected();
+  _debugPrintf("[Vwire] Attached %s to %s", _deviceId, owner._deviceId);
+  return true;
+}
+
+void VwireClass::detach() {
+  if (!_owner) return;
+  disconnect();
+  
+  VwireClass& owner = *_owner;
+  for (uint8_t i = 0; i < owner._attachedCount; i++) {
+    if (owner._attached[i] == this) {
+      owner._attached[i] = owner._attached[--owner._attachedCount];
+      owner._attached[owner._attachedCount] = nullptr;
+      break;
+    }
+  }
+  _owner = nullptr;
+  _mqtt = _transport;
+  _buildDispatchTable();
+}
+
+VwireState VwireClass::getState() { return _state; }
+VwireError VwireClass::getLastError() { return _lastError; }
 int VwireClass::getWiFiRSSI() { return WiFi.RSSI(); }
 
 // =============================================================================
 // MQTT CALLBACK
 // =============================================================================
 void VwireClass::_mqttCallbackWrapper(char* topic, byte* payload, unsigned int length) {
-  if (_vwireInstance) {
-    _vwireInstance->_handleMessage(topic, payload, length);
+  // Each device's topics start with its own "vwire/<deviceId>/"; anything
+  // else goes to the first connection owner (raw onMessage() handlers)
+  VwireClass* target = nullptr;
+  for (uint8_t i = 0; i < VWIRE_MAX_DEVICES; i++) {
+    VwireClass* inst = _vwireRegistry[i];
+    if (!inst) continue;
+    if (strncmp(topic, inst->_topicPrefix, inst->_topicPrefixLen) == 0) {
+      target = inst;
+      break;
+    }
+    if (!target && !inst->_owner) target = inst;
+  }
+  if (target) {
+    target->_handleMessage(topic, payload, length);
+  }
+}
+
+// Little-endian field access for binary frames
+static void _vwirePut32(uint8_t* out, uint32_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+  out[2] = value >> 16;
+  out[3] = value >> 24;
+}
+
+static uint32_t _vwireGet32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// Find "key":"value" in a flat JSON object and copy the value (no escapes).
+// Returns false if the key is missing, not a string or does not fit.
+static bool _vwireJsonString(const char* json, const char* key, char* out, size_t size) {
+  size_t keyLen = strlen(key);
+  for (const char* p = strchr(json, '"'); p; p = strchr(p + 1, '"')) {
+    if (strncmp(p + 1, key, keyLen) != 0 || p[keyLen + 1] != '"' || p[keyLen + 2] != ':') continue;
+    p += keyLen + 3;
+    while (*p == ' ') p++;
+    if (*p++ != '"') return false;
+    const char* end = strchr(p, '"');
+    if (!end || (size_t)(end - p) >= size) return false;
+    memcpy(out, p, end - p);
+    out[end - p] = '\0';
+    return true;
+  }
+  return false;
+}
+
+// Find "key": in a flat JSON object and parse its value as an unsigned
+// number, quoted or not. Returns false if the key is missing or not numeric.
+static bool _vwireJsonUint(const char* json, const char* key, uint32_t* out) {
+  size_t keyLen = strlen(key);
+  for (const char* p = strchr(json, '"'); p; p = strchr(p + 1, '"')) {
+    if (strncmp(p + 1, key, keyLen) != 0 || p[keyLen + 1] != '"' || p[keyLen + 2] != ':') continue;
+    p += keyLen + 3;
+    while (*p == ' ') p++;
+    if (*p == '"') p++;
+    if (*p < '0' || *p > '9') return false;
+    *out = strtoul(p, nullptr, 10);
+    return true;
+  }
+  return false;
+}
+
+// =============================================================================
+// SCRATCH ARENA
+// =============================================================================
+char* VwireClass::_scratchAlloc(size_t size) {
+  if (size > VWIRE_SCRATCH_SIZE - _scratchUsed) return nullptr;
+  char* p = _scratch + _scratchUsed;
+  _scratchUsed += size;
+  return p;
+}
+
+const char* VwireClass::_stableCopy(const char* data, size_t length) {
+  // Receive buffer contents are overwritten by the next publish
+  char* copy = _scratchAlloc(length + 1);
+  if (!copy) return data;  // Arena full - in place, valid until the next publish
+  memcpy(copy, data, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+char* VwireClass::_terminatePayload(char* topic, byte* payload, unsigned int length) {
+  // In place when the client says the byte after the payload is spare
+  if (_mqtt->payloadTerminable(topic, payload, length)) {
+    payload[length] = '\0';
+    return (char*)payload;
+  }
+  
+  char* copy = _scratchAlloc(length + 1);
+  if (copy) {
+    memcpy(copy, payload, length);
+    copy[length] = '\0';
   }
+  return copy;
 }
 
 void VwireClass::_handleMessage(char* topic, byte* payload, unsigned int length) {
-  // Copy payload to null-terminated string
-  char payloadStr[VWIRE_MAX_PAYLOAD_LENGTH];
-  int copyLen = min((unsigned int)(VWIRE_MAX_PAYLOAD_LENGTH - 1), length);
-  memcpy(payloadStr, payload, copyLen);
-  payloadStr[copyLen] = '\0';
+  // Null-terminate in the client's buffer instead of copying it; anything
+  // copied to scratch below is released when the message is done
+  size_t scratchMark = _scratchUsed;
+  char* payloadStr = _terminatePayload(topic, payload, length);
+  if (!payloadStr) {
+    _debugPrint("[Vwire] Message too large, dropped");
+    _setError(VWIRE_ERR_BUFFER_FULL);
+    return;
+  }
+  int copyLen = length;
+  bool stable = (char*)payload != payloadStr;
+  
+  #if VWIRE_ENABLE_STATS
+  _stats.messagesReceived++;
+  _stats.bytesReceived += strlen(topic) + length;
+  #endif
   
   _debugPrintf("[Vwire] Received: %s = %s", topic, payloadStr);
   
+  // Route before the raw handler - a publish from it overwrites the topic
+  int pin = -1;
+  TopicKind kind = _parseTopic(topic, &pin);
+  
   // Call raw message handler if set
   if (_messageHandler) {
+    if (!stable) {
+      payloadStr = (char*)_stableCopy(payloadStr, length);
+      stable = true;
+    }
+    #if VWIRE_ENABLE_STATS
+    uint32_t started = micros();
     _messageHandler(topic, payloadStr);
+    _stats.handlerCalls++;
+    _stats.handlerTime.add(micros() - started);
+    #else
+    _messageHandler(topic, payloadStr);
+    #endif
   }
   
-  // Check for ACK topic first: vwire/{deviceId}/ack
-  char* ackPos = strstr(topic, "/ack");
-  if (ackPos && *(ackPos + 4) == '\0') {
-    // This is an ACK message - parse JSON: {"msgId":"xxx","ok":true/false}
-    // Simple parse without ArduinoJson to save memory
-    char* msgIdStart = strstr(payloadStr, "\"msgId\":\"");
-    char* okStart = strstr(payloadStr, "\"ok\":");
-    
-    if (msgIdStart && okStart) {
-      msgIdStart += 9;  // Skip to value
-      char* msgIdEnd = strchr(msgIdStart, '\"');
-      if (msgIdEnd) {
-        char msgId[16];
-        int len = min((int)(msgIdEnd - msgIdStart), 15);
-        strncpy(msgId, msgIdStart, len);
-        msgId[len] = '\0';
-        
-        bool success = (strstr(okStart, "true") != nullptr);
-        _handleAck(msgId, success);
+  switch (kind) {
+    case TOPIC_ACK: {
+      // Binary ACK frames: [0x20][msgId][ok] or [0x21][upTo][mask]
+      const uint8_t* frame = (const uint8_t*)payloadStr;
+      if (frame[0] == VWIRE_FRAME_ACK && copyLen >= 6) {
+        _handleAck(_vwireGet32(frame + 1), frame[5] != 0);
+        break;
+      }
+      if (frame[0] == VWIRE_FRAME_ACK_CUMULATIVE && copyLen >= 9) {
+        _handleCumulativeAck(_vwireGet32(frame + 1), _vwireGet32(frame + 5));
+        break;
+      }
+      
+      // Simple parse without ArduinoJson to save memory
+      uint32_t upTo, mask = 0, msgId;
+      if (_vwireJsonUint(payloadStr, "upTo", &upTo)) {
+        // Cumulative ACK: {"upTo":1234,"mask":5}
+        _vwireJsonUint(payloadStr, "mask", &mask);
+        _handleCumulativeAck(upTo, mask);
+      } else if (_vwireJsonUint(payloadStr, "msgId", &msgId)) {
+        // Per-message ACK: {"msgId":"xxx","ok":true/false}
+        const char* okStart = strstr(payloadStr, "\"ok\":");
+        if (okStart) {
+          bool success = (strstr(okStart, "true") != nullptr);
+          _handleAck(msgId, success);
+        }
       }
+      break;
     }
-    return;  // ACK processed, don't continue as command
+    
+    case TOPIC_ENC:
+      // Server answer to our encoding request
+      _binaryActive = (_settings.encoding == VWIRE_ENCODING_BINARY) &&
+                      strcmp(payloadStr, VWIRE_BINARY_PROTOCOL) == 0;
+      _debugPrintf("[Vwire] Encoding: %s", _binaryActive ? "binary" : "text");
+      break;
+    
+    case TOPIC_CMD:
+      _routeCommand(pin, payloadStr, copyLen, stable);
+      break;
+    
+    case TOPIC_CMD_BATCH:
+      // Entries are handed out one at a time - a handler publishing must
+      // not overwrite the rest of the frame
+      if (!stable) {
+        const char* copy = _stableCopy(payloadStr, copyLen);
+        if (copy == payloadStr) {
+          _debugPrint("[Vwire] Command batch too large, dropped");
+          _setError(VWIRE_ERR_BUFFER_FULL);
+          break;
+        }
+        payloadStr = (char*)copy;
+      }
+      _handleCommandBatch(payloadStr, copyLen);
+      break;
+    
+    case TOPIC_READ:
+      #if VWIRE_HAS_NET_TASK
+      if (_netQueuesCommands()) {
+        // A fresh cached value is answered right here, the handler runs in loop()
+        if (_answerFromCache(pin)) break;
+        VwireRingRecord* rec = _readDispatch[pin] ? _netInbox.reserve() : nullptr;
+        if (rec) {
+          rec->type = VWIRE_RING_READ;
+          rec->pin = pin;
+          rec->len = 0;
+          _netInbox.commit();
+        }
+        break;
+      }
+      #endif
+      if (!_answerFromCache(pin)) _runReadHandler(pin);
+      break;
+    
+    case TOPIC_OTA:
+      _handleOtaAnnounce(payloadStr);
+      break;
+    
+    case TOPIC_OTA_DATA:
+      _handleOtaData((const uint8_t*)payloadStr, copyLen);
+      break;
+    
+    default:
+      break;  // Not a topic we handle
   }
   
-  // Fast parse: find "/cmd/" in topic using strstr (no heap allocation)
-  char* cmdPos = strstr(topic, "/cmd/");
-  if (!cmdPos) return;  // Not a command topic
+  _scratchUsed = scratchMark;
+}
+
+VwireClass::TopicKind VwireClass::_parseTopic(const char* topic, int* pin) {
+  // Every inbound topic must start with "vwire/<deviceId>/" - check it once
+  if (strncmp(topic, _topicPrefix, _topicPrefixLen) != 0) return TOPIC_UNKNOWN;
+  const char* suffix = topic + _topicPrefixLen;
+  
+  switch (suffix[0]) {
+    case 'a':
+      // vwire/<id>/ack
+      return (strcmp(suffix, "ack") == 0) ? TOPIC_ACK : TOPIC_UNKNOWN;
+    
+    case 'e':
+      // vwire/<id>/enc
+      return (strcmp(suffix, "enc") == 0) ? TOPIC_ENC : TOPIC_UNKNOWN;
+    
+    case 'o':
+      // vwire/<id>/ota or vwire/<id>/ota/data
+      if (strcmp(suffix, "ota") == 0) return TOPIC_OTA;
+      return (strcmp(suffix, "ota/data") == 0) ? TOPIC_OTA_DATA : TOPIC_UNKNOWN;
+    
+    case 'c':
+    case 'r': {
+      // vwire/<id>/cmd/V<n> or vwire/<id>/read/V<n> (V prefix optional),
+      // or vwire/<id>/cmd for a batch
+      if (strcmp(suffix, "cmd") == 0) return TOPIC_CMD_BATCH;
+      TopicKind kind;
+      const char* p;
+      if (strncmp(suffix, "cmd/", 4) == 0) {
+        kind = TOPIC_CMD;
+        p = suffix + 4;
+      } else if (strncmp(suffix, "read/", 5) == 0) {
+        kind = TOPIC_READ;
+        p = suffix + 5;
+      } else {
+        return TOPIC_UNKNOWN;
+      }
+      if (*p == 'V' || *p == 'v') p++;
+      if (*p < '0' || *p > '9') return TOPIC_UNKNOWN;
+      
+      int value = 0;
+      while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        if (value >= VWIRE_MAX_VIRTUAL_PINS) return TOPIC_UNKNOWN;
+        p++;
+      }
+      *pin = value;
+      return kind;
+    }
+    
+    default:
+      return TOPIC_UNKNOWN;
+  }
+}
+
+void VwireClass::_routeCommand(uint8_t pin, const char* value, size_t len, bool stable) {
+  // Direct lookup - manual handlers take precedence over VWIRE_RECEIVE
+  PinHandler handler = _pinDispatch[pin];
+  if (!handler) return;
   
-  // Get pin string after "/cmd/"
-  char* pinStr = cmdPos + 5;  // Skip "/cmd/"
-  if (!pinStr || *pinStr == '\0') return;
+  #if VWIRE_HAS_NET_TASK
+  if (_netQueuesCommands()) {
+    // Copied into the inbox - run() calls the handler in loop()
+    VwireRingRecord* rec = (len <= VWIRE_NET_VALUE_LENGTH) ? _netInbox.reserve() : nullptr;
+    if (!rec) {
+      _debugPrintf("[Vwire] V%d command dropped (inbox)", pin);
+      _setError(VWIRE_ERR_BUFFER_FULL);
+      return;
+    }
+    rec->type = VWIRE_RING_CMD;
+    rec->pin = pin;
+    rec->len = len;
+    memcpy(rec->value, value, len);
+    rec->value[len] = '\0';
+    _netInbox.commit();
+    return;
+  }
+  #endif
   
-  // Parse pin number (handle V prefix)
-  int pin = -1;
-  if (*pinStr == 'V' || *pinStr == 'v') {
-    pin = atoi(pinStr + 1);
+  // Coalesced pins keep the value until the end of this run()
+  if (_coalesceCount && _holdCommand(pin, value, len)) return;
+  
+  // Short values are copied inline, longer ones viewed from scratch,
+  // so the value survives the handler publishing
+  VirtualPin vpin;
+  if (stable) {
+    vpin.setView(value, len);
+  } else if (len < VWIRE_VPIN_BUFFER_SIZE) {
+    vpin.set(value, len);
   } else {
-    pin = atoi(pinStr);
+    vpin.setView(_stableCopy(value, len), len);
+  }
+  _callPinHandler(handler, vpin);
+}
+
+// Unescape a JSON string in place, starting after its opening quote. The
+// value is NUL-terminated; returns the character after the closing quote,
+// or nullptr if the string is not terminated.
+static char* _vwireJsonUnescape(char* p, size_t* len) {
+  char* start = p;
+  char* out = p;
+  while (*p && *p != '"') {
+    if (*p != '\\' || !p[1]) {
+      *out++ = *p++;
+      continue;
+    }
+    p++;
+    switch (*p) {
+      case 'n': *out++ = '\n'; p++; break;
+      case 'r': *out++ = '\r'; p++; break;
+      case 't': *out++ = '\t'; p++; break;
+      case 'u':
+        if (isxdigit((unsigned char)p[1]) && isxdigit((unsigned char)p[2]) &&
+            isxdigit((unsigned char)p[3]) && isxdigit((unsigned char)p[4])) {
+          char hex[5] = {p[1], p[2], p[3], p[4], '\0'};
+          unsigned long code = strtoul(hex, nullptr, 16);
+          *out++ = (code < 0x80) ? (char)code : '?';  // Control characters; no UTF-8 output
+          p += 5;
+          break;
+        }
+        *out++ = *p++;
+        break;
+      default:
+        *out++ = *p++;  // \" \\ \/
+        break;
+    }
   }
+  if (*p != '"') return nullptr;
+  *out = '\0';
+  *len = out - start;
+  return p + 1;
+}
+
+void VwireClass::_handleCommandBatch(char* payload, size_t len) {
+  // payload is NUL-terminated and stays valid until the batch is done
+  char number[VWIRE_VPIN_BUFFER_SIZE];
   
-  // Handle the pin if valid
-  if (pin >= 0 && pin < VWIRE_MAX_VIRTUAL_PINS) {
-    VirtualPin vpin;
-    vpin.set(payloadStr);
-    
-    // First, check manually registered handlers (onVirtualReceive)
-    for (int i = 0; i < _pinHandlerCount; i++) {
-      if (_pinHandlers[i].active && _pinHandlers[i].pin == pin) {
-        if (_pinHandlers[i].handler) {
-          _pinHandlers[i].handler(vpin);
+  if (len && (uint8_t)payload[0] == VWIRE_FRAME_PINS) {
+    // Binary: [0x10]([pin][tlv])... - the frame the device sends
+    uint8_t* p = (uint8_t*)payload + 1;
+    uint8_t* end = (uint8_t*)payload + len;
+    while (end - p >= 2) {
+      uint8_t pin = p[0];
+      uint8_t type = p[1];
+      p += 2;
+      const char* value = number;
+      size_t valueLen;
+      char* terminated = nullptr;
+      char saved = 0;
+      
+      if (type == VWIRE_TLV_INT8 && end - p >= 1) {
+        valueLen = snprintf(number, sizeof(number), "%d", (int)(int8_t)p[0]);
+        p += 1;
+      } else if ((type == VWIRE_TLV_INT32 || type == VWIRE_TLV_FLOAT32) && end - p >= 4) {
+        uint32_t raw = _vwireGet32(p);
+        p += 4;
+        if (type == VWIRE_TLV_INT32) {
+          valueLen = snprintf(number, sizeof(number), "%ld", (long)(int32_t)raw);
+        } else {
+          float f;
+          memcpy(&f, &raw, sizeof(f));
+          valueLen = VirtualPin::formatFloat(number, sizeof(number), f, 4);
         }
-        return;  // Found handler, exit immediately
+      } else if (type == VWIRE_TLV_TEXT && end - p >= 1 && end - p - 1 >= p[0]) {
+        // Terminate in place - the next byte is the following pin (or the
+        // terminator after the frame) and is put back afterwards
+        value = (const char*)p + 1;
+        valueLen = p[0];
+        p += 1 + valueLen;
+        terminated = (char*)p;
+        saved = *terminated;
+        *terminated = '\0';
+      } else {
+        _debugPrint("[Vwire] Malformed command frame");
+        return;
       }
+      
+      if (pin < VWIRE_MAX_VIRTUAL_PINS) _routeCommand(pin, value, valueLen, true);
+      if (terminated) *terminated = saved;
+    }
+    return;
+  }
+  
+  // JSON: {"V0":"23.50","V1":61,"V2":true} - values terminated in place
+  char* p = payload;
+  while ((p = strchr(p, '"')) != nullptr) {
+    p++;
+    if (*p == 'V' || *p == 'v') p++;
+    if (*p < '0' || *p > '9') break;
+    int pin = 0;
+    while (*p >= '0' && *p <= '9') {
+      if (pin < VWIRE_MAX_VIRTUAL_PINS) pin = pin * 10 + (*p - '0');
+      p++;
     }
+    if (*p++ != '"') break;
+    while (*p == ' ') p++;
+    if (*p++ != ':') break;
+    while (*p == ' ') p++;
     
-    // Then, check auto-registered handlers (VWIRE_RECEIVE macros)
-    for (uint8_t i = 0; i < _vwireAutoReceiveCount; i++) {
-      if (_vwireAutoReceiveHandlers[i].pin == pin) {
-        if (_vwireAutoReceiveHandlers[i].handler) {
-          _vwireAutoReceiveHandlers[i].handler(vpin);
-        }
-        return;  // Found handler, exit immediately
-      }
+    char* value;
+    size_t valueLen;
+    if (*p == '"') {
+      value = p + 1;
+      p = _vwireJsonUnescape(value, &valueLen);
+      if (!p) break;
+    } else {
+      // Number or literal - ends at the separator, which is not needed again
+      value = p;
+      while (*p && *p != ',' && *p != '}' && *p != ' ') p++;
+      valueLen = p - value;
+      if (*p) *p++ = '\0';
+    }
+    
+    if (pin < VWIRE_MAX_VIRTUAL_PINS) _routeCommand(pin, value, valueLen, true);
+  }
+}
+
+void VwireClass::_updateTopicPrefix() {
+  int len = snprintf(_topicPrefix, sizeof(_topicPrefix), "vwire/%s/", _deviceId);
+  _topicPrefixLen = (len > 0 && len < (int)sizeof(_topicPrefix)) ? len : strlen(_topicPrefix);
+}
+
+void VwireClass::_buildDispatchTable() {
+  memset(_pinDispatch, 0, sizeof(_pinDispatch));
+  
+  // Manual handlers first (first registration for a pin wins, as before)
+  for (int i = 0; i < _pinHandlerCount; i++) {
+    uint8_t pin = _pinHandlers[i].pin;
+    if (_pinHandlers[i].active && pin < VWIRE_MAX_VIRTUAL_PINS && !_pinDispatch[pin]) {
+      _pinDispatch[pin] = _pinHandlers[i].handler;
+    }
+  }
+  
+  // Then auto-registered handlers (VWIRE_RECEIVE) for pins still unclaimed -
+  // they are global, so an attached device only gets its own handlers
+  for (uint8_t i = 0; !_owner && i < _vwireAutoReceiveCount; i++) {
+    uint8_t pin = _vwireAutoReceiveHandlers[i].pin;
+    if (pin < VWIRE_MAX_VIRTUAL_PINS && !_pinDispatch[pin]) {
+      _pinDispatch[pin] = _vwireAutoReceiveHandlers[i].handler;
+    }
+  }
+  
+  // Read handlers the same way (onVirtualRead() first, then VWIRE_READ)
+  memset(_readDispatch, 0, sizeof(_readDispatch));
+  for (uint8_t i = 0; i < _readHandlerCount; i++) {
+    uint8_t pin = _readHandlers[i].pin;
+    if (pin < VWIRE_MAX_VIRTUAL_PINS && !_readDispatch[pin]) {
+      _readDispatch[pin] = _readHandlers[i].handler;
+    }
+  }
+  for (uint8_t i = 0; !_owner && i < _vwireAutoReadCount; i++) {
+    uint8_t pin = _vwireAutoReadHandlers[i].pin;
+    if (pin < VWIRE_MAX_VIRTUAL_PINS && !_readDispatch[pin]) {
+      _readDispatch[pin] = _vwireAutoReadHandlers[i].handler;
     }
   }
 }
@@ -479,9 +1736,50 @@ void VwireClass::_handleMessage(char* topic, byte* payload, unsigned int length)
 // =============================================================================
 // VIRTUAL PIN OPERATIONS
 // =============================================================================
-void VwireClass::_virtualSendInternal(uint8_t pin, const String& value) {
+void VwireClass::virtualSend(uint8_t pin, const char* value) {
+  _virtualSendInternal(pin, value ? value : "");
+}
+
+void VwireClass::virtualSend(uint8_t pin, const String& value) {
+  _virtualSendInternal(pin, value.c_str());
+}
+
+void VwireClass::_virtualSendInternal(uint8_t pin, const char* value) {
+  // A send from inside a read handler answers the read request
+  bool answer = (pin == _readingPin);
+  
+  // Everything below runs on the network task when there is one
+  if (_netPosting()) {
+    _netPost(answer ? VWIRE_RING_ANSWER : VWIRE_RING_PIN, pin, value, strlen(value));
+    return;
+  }
+  
+  _sendPinValue(pin, value, answer);
+}
+
+void VwireClass::_sendPinValue(uint8_t pin, const char* value, bool answer) {
   if (!connected()) {
     _setError(VWIRE_ERR_NOT_CONNECTED);
+    if (_offlineLog.isEnabled()) _captureOffline(pin, value);
+    return;
+  }
+  
+  // Any value sent on a cached pin is the freshest answer to a read request
+  if (_readCacheCount) {
+    ReadCache* cache = _findReadCache(pin);
+    size_t len = strlen(value);
+    if (cache && len < sizeof(cache->value)) {
+      memcpy(cache->value, value, len + 1);
+      cache->cachedAt = millis();
+      cache->valid = true;
+    } else if (cache) {
+      cache->valid = false;
+    }
+  }
+  
+  // Drop redundant values before doing any work (deadband / on-change / interval) -
+  // except answers, the server asked for those
+  if (_policyCount && !answer && !_passesPolicy(pin, value)) {
     return;
   }
   
@@ -491,144 +1789,1638 @@ void VwireClass::_virtualSendInternal(uint8_t pin, const String& value) {
     return;
   }
   
+  // Collect into the current batch (falls through if the value can't fit)
+  if (_batching && _batchAppend(pin, value)) {
+    return;
+  }
+  
+  // Hand off to the rate-limited queue (falls through for oversized values)
+  if (_publishRate && _enqueuePublish(pin, value)) {
+    return;
+  }
+  
+  _publishPin(pin, value);
+}
+
+void VwireClass::_virtualSendTlv(uint8_t pin, const VwireTlv& value) {
+  // [0x10][pin][tag][value] - 7 bytes at most
+  uint8_t frame[8];
+  frame[0] = VWIRE_FRAME_PINS;
+  frame[1] = pin;
+  size_t len = 2 + value.encode(frame + 2);
+  
+  if (_batching && _batchAppendRecord(frame + 1, len - 1)) return;
+  _publishFrame(frame, len, _settings.dataRetain);
+}
+
+void VwireClass::_publishFrame(const uint8_t* frame, size_t len, bool retain) {
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "bin");
+  _beginDataPublish(topic, len, retain);
+  _mqtt->write(frame, len);
+  _endPublish();
+}
+
+bool VwireClass::_beginDataPublish(const char* topic, size_t length, bool retain) {
+  // QoS 1 where the transport has it - nobody waits for that PUBACK, and a
+  // full inflight window just means this one goes at QoS 0. While reliable
+  // messages wait for the window, data leaves it to them.
+  if (_settings.dataQoS && _mqtt->supportsQos1() && !_reliableWaiting() &&
+      _mqtt->beginPublishQos1(topic, length, retain, 0)) {
+    _countPublish(topic, length);
+    return true;
+  }
+  return _beginPublish(topic, length, retain);
+}
+
+bool VwireClass::_beginPublish(const char* topic, size_t length, bool retain) {
+  _countPublish(topic, length);
+  return _mqtt->beginPublish(topic, length, retain);
+}
+
+int VwireClass::_endPublish() {
+  int result = _mqtt->endPublish();
+  #if VWIRE_ENABLE_STATS
+  _stats.publishTime.add(micros() - _publishStartedAt);
+  #endif
+  return result;
+}
+
+void VwireClass::_publishPin(uint8_t pin, const char* value) {
+  // Binary mode: text values go out as a TLV text record (up to 255 bytes)
+  size_t len = strlen(value);
+  if (_binaryActive && len <= 255) {
+    uint8_t frame[2 + 2 + 255];
+    frame[0] = VWIRE_FRAME_PINS;
+    frame[1] = pin;
+    _publishFrame(frame, 2 + VwireTlv::encodeText(frame + 2, value, len), _settings.dataRetain);
+    return;
+  }
+  
   // Standard fire-and-forget delivery
   // Use stack-allocated buffer for topic (avoid heap allocation)
-  char topic[96];
-  snprintf(topic, sizeof(topic), "vwire/%s/pin/V%d", _deviceId, pin);
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "pin", pin);
   
   // Publish data to server
-  const char* payload = value.c_str();
-  unsigned int len = strlen(payload);
-  _mqttClient.beginPublish(topic, len, _settings.dataRetain);
-  _mqttClient.print(payload);
-  _mqttClient.endPublish();
-  _debugPrintf("[Vwire] Send V%d = %s", pin, value.c_str());
+  _beginDataPublish(topic, len, _settings.dataRetain);
+  _mqtt->print(value);
+  _endPublish();
+  _debugPrintf("[Vwire] Send V%d = %s", pin, value);
 }
 
-void VwireClass::virtualSendArray(uint8_t pin, float* values, int count) {
-  String str = "";
+// Streams a payload in two passes: measure first (client == nullptr), then
+// write through a small staging buffer after beginPublish() with that length.
+// With a dest buffer the text is copied there instead (room is the caller's job).
+struct VwireStreamWriter {
+  VwireMqttTransport* client;
+  char* dest;
+  size_t length;
+  uint8_t used;
+  uint8_t buf[64];
+  
+  explicit VwireStreamWriter(VwireMqttTransport* c, char* d = nullptr)
+    : client(c), dest(d), length(0), used(0) {}
+  
+  void put(const char* s, size_t n) {
+    if (dest) memcpy(dest + length, s, n);
+    length += n;
+    if (!client) return;
+    while (n) {
+      size_t chunk = min(n, sizeof(buf) - used);
+      memcpy(buf + used, s, chunk);
+      used += chunk;
+      s += chunk;
+      n -= chunk;
+      if (used == sizeof(buf)) flush();
+    }
+  }
+  void put(const char* s) { put(s, strlen(s)); }
+  void flush() {
+    if (client && used) client->write(buf, used);
+    used = 0;
+  }
+};
+
+// "1.50,2.25,..." - exactly one of floats / ints is set
+static void _vwireWriteArray(VwireStreamWriter& out, const float* floats, const int* ints,
+                             int count, uint8_t decimals) {
+  char num[48];
   for (int i = 0; i < count; i++) {
-    if (i > 0) str += ",";
-    str += String(values[i], 2);
+    if (i) out.put(",", 1);
+    size_t n = floats ? VirtualPin::formatFloat(num, sizeof(num), floats[i], decimals)
+                      : (size_t)snprintf(num, sizeof(num), "%d", ints[i]);
+    out.put(num, n);
   }
-  _virtualSendInternal(pin, str);
 }
 
-void VwireClass::virtualSendArray(uint8_t pin, int* values, int count) {
-  String str = "";
-  for (int i = 0; i < count; i++) {
-    if (i > 0) str += ",";
-    str += String(values[i]);
+void VwireClass::virtualSendArray(uint8_t pin, const float* values, int count, uint8_t decimals) {
+  _sendArray(pin, values, nullptr, count, decimals);
+}
+
+void VwireClass::virtualSendArray(uint8_t pin, const int* values, int count) {
+  _sendArray(pin, nullptr, values, count, 0);
+}
+
+void VwireClass::_sendArray(uint8_t pin, const float* floats, const int* ints, int count, uint8_t decimals) {
+  if (count < 0) count = 0;
+  
+  // Pass 1: length only - nothing is held in RAM yet
+  VwireStreamWriter measure(nullptr);
+  _vwireWriteArray(measure, floats, ints, count, decimals);
+  size_t length = measure.length;
+  
+  #if VWIRE_HAS_NET_TASK
+  // Scratch belongs to the network task - format straight into the record
+  if (_netPosting()) {
+    VwireRingRecord* rec = (length <= VWIRE_NET_VALUE_LENGTH) ? _netOutbox.reserve() : nullptr;
+    if (!rec) {
+      _setError(VWIRE_ERR_BUFFER_FULL);
+      return;
+    }
+    VwireStreamWriter build(nullptr, rec->value);
+    _vwireWriteArray(build, floats, ints, count, decimals);
+    rec->value[length] = '\0';
+    rec->type = VWIRE_RING_PIN;
+    rec->pin = pin;
+    rec->len = length;
+    _netOutbox.commit();
+    xTaskNotifyGive(_netTask);
+    return;
+  }
+  #endif
+  
+  // Policies, reliable delivery, batches, the queue, the offline log and
+  // short TLV records all need the text - build it in scratch when it fits
+  bool needsText = !connected() || _policyCount || _settings.reliableDelivery ||
+                   _batching || _publishRate || (_binaryActive && length <= 255);
+  if (needsText) {
+    size_t scratchMark = _scratchUsed;
+    char* text = _scratchAlloc(length + 1);
+    if (text) {
+      VwireStreamWriter build(nullptr, text);
+      _vwireWriteArray(build, floats, ints, count, decimals);
+      text[length] = '\0';
+      _virtualSendInternal(pin, text);
+      _scratchUsed = scratchMark;
+      return;
+    }
+    // Too long for scratch. Offline log, reliable delivery and policies
+    // cannot work without the text - refuse rather than send it weaker.
+    // Batches and the publish queue let oversized values through anyway
+    bool answer = (pin == _readingPin);
+    if (!connected() || _settings.reliableDelivery ||
+        (_policyCount && !answer && _findPolicy(pin, false))) {
+      _setError(VWIRE_ERR_BUFFER_FULL);
+      return;
+    }
+  }
+  
+  // Keep read caches as current as a virtualSend() would
+  if (_readCacheCount) {
+    ReadCache* cache = _findReadCache(pin);
+    if (cache && length < sizeof(cache->value)) {
+      VwireStreamWriter build(nullptr, cache->value);
+      _vwireWriteArray(build, floats, ints, count, decimals);
+      cache->value[length] = '\0';
+      cache->cachedAt = millis();
+      cache->valid = true;
+    } else if (cache) {
+      cache->valid = false;  // Too long to cache - never answer with an older value
+    }
   }
-  _virtualSendInternal(pin, str);
+  
+  // Pass 2: format straight into the MQTT packet
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "pin", pin);
+  if (!_beginDataPublish(topic, length, _settings.dataRetain)) return;
+  VwireStreamWriter out(_mqtt);
+  _vwireWriteArray(out, floats, ints, count, decimals);
+  out.flush();
+  _endPublish();
+  _debugPrintf("[Vwire] Send V%d = [%d values, %u bytes]", pin, count, (unsigned)length);
 }
 
 void VwireClass::virtualSendf(uint8_t pin, const char* format, ...) {
   char buffer[128];
   va_list args;
   va_start(args, format);
-  vsnprintf(buffer, sizeof(buffer), format, args);
+  int n = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (n < 0) return;
+  if ((size_t)n < sizeof(buffer)) {
+    _virtualSendInternal(pin, buffer);
+    return;
+  }
+  
+  // Longer output: format again into scratch, or a one-off heap block
+  // (scratch belongs to the network task while it runs)
+  size_t scratchMark = _scratchUsed;
+  char* text = _netPosting() ? nullptr : _scratchAlloc(n + 1);
+  bool heap = !text;
+  if (heap) text = (char*)malloc(n + 1);
+  if (!text) {
+    _setError(VWIRE_ERR_BUFFER_FULL);
+    return;
+  }
+  va_start(args, format);
+  vsnprintf(text, n + 1, format, args);
   va_end(args);
-  _virtualSendInternal(pin, String(buffer));
+  _virtualSendInternal(pin, text);
+  if (heap) free(text);
+  _scratchUsed = scratchMark;
+}
+
+void VwireClass::syncVirtual(uint8_t pin) {
+  if (_netPosting()) {
+    _netPost(VWIRE_RING_SYNC, pin, "", 0);
+    return;
+  }
+  if (!connected()) return;
+  // Use stack buffer for topic
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "sync", pin);
+  _beginPublish(topic, 0, false);
+  _endPublish();
+}
+
+void VwireClass::syncAll() {
+  if (_netPosting()) {
+    _netPost(VWIRE_RING_SYNC, 0xFF, "", 0);
+    return;
+  }
+  if (!connected()) return;
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "sync");
+  _beginPublish(topic, 3, false);
+  _mqtt->print("all");
+  _endPublish();
+}
+
+// =============================================================================
+// PUBLISH POLICIES
+// =============================================================================
+static uint32_t _vwireHash(const char* text) {
+  uint32_t hash = 2166136261UL;  // FNV-1a
+  while (*text) {
+    hash ^= (uint8_t)*text++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+VwireClass::PublishPolicy* VwireClass::_findPolicy(uint8_t pin, bool create) {
+  PublishPolicy* freeSlot = nullptr;
+  for (int i = 0; i < VWIRE_MAX_PUBLISH_POLICIES; i++) {
+    if (_policies[i].active) {
+      if (_policies[i].pin == pin) return &_policies[i];
+    } else if (!freeSlot) {
+      freeSlot = &_policies[i];
+    }
+  }
+  
+  if (!create) return nullptr;
+  if (!freeSlot) {
+    _setError(VWIRE_ERR_BUFFER_FULL);
+    _debugPrint("[Vwire] Error: Max publish policies reached!");
+    return nullptr;
+  }
+  
+  memset(freeSlot, 0, sizeof(PublishPolicy));
+  freeSlot->pin = pin;
+  freeSlot->active = true;
+  _policyCount++;
+  return freeSlot;
+}
+
+bool VwireClass::setDeadband(uint8_t pin, float absolute, float percent) {
+  PublishPolicy* policy = _findPolicy(pin, true);
+  if (!policy) return false;
+  policy->deadbandAbs = fabs(absolute);
+  policy->deadbandPct = fabs(percent);
+  return true;
+}
+
+bool VwireClass::setPublishOnChange(uint8_t pin, bool enable) {
+  PublishPolicy* policy = _findPolicy(pin, true);
+  if (!policy) return false;
+  policy->onChange = enable;
+  return true;
+}
+
+bool VwireClass::setPublishInterval(uint8_t pin, unsigned long minInterval, unsigned long maxSilence) {
+  PublishPolicy* policy = _findPolicy(pin, true);
+  if (!policy) return false;
+  policy->minInterval = minInterval;
+  policy->maxSilence = maxSilence;
+  return true;
+}
+
+void VwireClass::clearPublishPolicy(uint8_t pin) {
+  PublishPolicy* policy = _findPolicy(pin, false);
+  if (policy) {
+    _releaseHeld(*policy);
+    policy->active = false;
+    _policyCount--;
+  }
+}
+
+void VwireClass::_releaseHeld(PublishPolicy& policy) {
+  if (!policy.held) return;
+  policy.held = false;
+  _policyHeld--;
+}
+
+void VwireClass::_flushHeldValues() {
+  // The last value of a burst goes out once minInterval has passed - it
+  // still has to clear the deadband / on-change check against the last send
+  unsigned long now = millis();
+  for (int i = 0; i < VWIRE_MAX_PUBLISH_POLICIES && _policyHeld; i++) {
+    PublishPolicy& policy = _policies[i];
+    if (!policy.active || !policy.held || now - policy.lastSentAt < policy.minInterval) continue;
+    char value[VWIRE_POLICY_VALUE_LENGTH];
+    memcpy(value, policy.heldValue, sizeof(value));
+    _releaseHeld(policy);
+    _sendPinValue(policy.pin, value, false);
+  }
+}
+
+bool VwireClass::_passesPolicy(uint8_t pin, const char* value) {
+  PublishPolicy* policy = _findPolicy(pin, false);
+  if (!policy) return true;
+  
+  unsigned long now = millis();
+  bool numeric = policy->deadbandAbs > 0 || policy->deadbandPct > 0;
+  float number = numeric ? (float)atof(value) : 0;
+  uint32_t hash = numeric ? 0 : _vwireHash(value);
+  
+  if (policy->hasLast) {
+    unsigned long elapsed = now - policy->lastSentAt;
+    if (policy->minInterval && elapsed < policy->minInterval) {
+      // Too soon - keep the newest value for run() to send when the interval ends
+      size_t len = strlen(value);
+      if (len < sizeof(policy->heldValue)) {
+        memcpy(policy->heldValue, value, len + 1);
+        if (!policy->held) _policyHeld++;
+        policy->held = true;
+      } else {
+        _releaseHeld(*policy);  // Older than this one - never send it
+      }
+      return false;
+    }
+    _releaseHeld(*policy);  // This value supersedes it either way
+    
+    // Unchanged values are still sent once maxSilence has passed (heartbeat)
+    bool forced = policy->maxSilence && elapsed >= policy->maxSilence;
+    if (!forced) {
+      if (numeric) {
+        float band = policy->deadbandAbs;
+        float pctBand = fabs(policy->lastValue) * policy->deadbandPct / 100.0f;
+        if (pctBand > band) band = pctBand;
+        if (fabs(number - policy->lastValue) < band) return false;
+      } else if (policy->onChange && hash == policy->lastHash) {
+        return false;
+      }
+    }
+  }
+  
+  _releaseHeld(*policy);
+  policy->hasLast = true;
+  policy->lastSentAt = now;
+  policy->lastValue = number;
+  policy->lastHash = hash;
+  return true;
+}
+
+// =============================================================================
+// PUBLISH QUEUE
+// =============================================================================
+void VwireClass::setPublishRate(uint16_t messagesPerSecond, uint8_t burst) {
+  // Switching to synchronous mode must not strand queued values
+  if (messagesPerSecond == 0 && _queuedCount) {
+    flushPublishQueue();
+  }
+  
+  _publishRate = messagesPerSecond;
+  _publishBurst = burst ? burst : 1;
+  _publishTokens = (uint32_t)_publishBurst * 1000;
+  _lastTokenRefill = millis();
+  _debugPrintf("[Vwire] Publish rate: %u msg/s (burst %u)", messagesPerSecond, _publishBurst);
+}
+
+void VwireClass::flushPublishQueue() {
+  _drainPublishQueue(true);
+}
+
+uint8_t VwireClass::getQueuedCount() { return _queuedCount; }
+
+bool VwireClass::_enqueuePublish(uint8_t pin, const char* value) {
+  size_t len = strlen(value);
+  if (len >= VWIRE_QUEUE_VALUE_LENGTH) return false;  // Too long - send now
+  
+  // Last value wins: reuse the pin's pending slot, else take a free one
+  QueuedValue* slot = nullptr;
+  QueuedValue* freeSlot = nullptr;
+  for (int i = 0; i < VWIRE_PUBLISH_QUEUE_SIZE; i++) {
+    if (_publishQueue[i].pending) {
+      if (_publishQueue[i].pin == pin) {
+        slot = &_publishQueue[i];
+        break;
+      }
+    } else if (!freeSlot) {
+      freeSlot = &_publishQueue[i];
+    }
+  }
+  
+  if (!slot) {
+    if (!freeSlot) {
+      _setError(VWIRE_ERR_QUEUE_FULL);
+      _debugPrintf("[Vwire] Publish queue full, dropped V%d", pin);
+      return true;  // Dropped - never block the caller
+    }
+    slot = freeSlot;
+    slot->pin = pin;
+    slot->pending = true;
+    _queuedCount++;
+  }
+  
+  memcpy(slot->value, value, len + 1);
+  return true;
+}
+
+void VwireClass::_drainPublishQueue(bool ignoreRate) {
+  if (!connected()) return;
+  
+  if (!ignoreRate) {
+    // Refill token bucket: rate tokens per second, scaled by 1000
+    unsigned long now = millis();
+    unsigned long elapsed = now - _lastTokenRefill;
+    uint32_t capacity = (uint32_t)_publishBurst * 1000;
+    _lastTokenRefill = now;
+    if (elapsed >= (capacity + _publishRate - 1) / _publishRate) {
+      _publishTokens = capacity;  // Idle long enough to fill up (avoids overflow)
+    } else {
+      uint32_t earned = (uint32_t)elapsed * _publishRate;
+      _publishTokens = (earned >= capacity - _publishTokens) ? capacity : _publishTokens + earned;
+    }
+  }
+  
+  for (int scanned = 0; _queuedCount && scanned < VWIRE_PUBLISH_QUEUE_SIZE; scanned++) {
+    if (!ignoreRate && _publishTokens < 1000) break;
+    
+    QueuedValue& slot = _publishQueue[_queueCursor];
+    _queueCursor = (_queueCursor + 1) % VWIRE_PUBLISH_QUEUE_SIZE;
+    if (!slot.pending) continue;
+    
+    slot.pending = false;
+    _queuedCount--;
+    if (!ignoreRate) _publishTokens -= 1000;
+    _publishPin(slot.pin, slot.value);
+  }
+}
+
+// =============================================================================
+// BATCHED SENDS
+// =============================================================================
+// JSON string escaping for batch values
+static size_t _vwireJsonEscapedLength(const char* in) {
+  size_t len = 0;
+  for (; *in; in++) {
+    unsigned char c = (unsigned char)*in;
+    if (c == '"' || c == '\\') len += 2;
+    else if (c < 0x20) len += 6;  // \u00XX
+    else len++;
+  }
+  return len;
+}
+
+static char* _vwireJsonEscape(char* out, const char* in) {
+  static const char hex[] = "0123456789abcdef";
+  for (; *in; in++) {
+    unsigned char c = (unsigned char)*in;
+    if (c == '"' || c == '\\') {
+      *out++ = '\\';
+      *out++ = c;
+    } else if (c < 0x20) {
+      *out++ = '\\'; *out++ = 'u'; *out++ = '0'; *out++ = '0';
+      *out++ = hex[c >> 4];
+      *out++ = hex[c & 0x0F];
+    } else {
+      *out++ = c;
+    }
+  }
+  return out;
+}
+
+void VwireClass::beginBatch() {
+  if (_netPosting()) {
+    _netPost(VWIRE_RING_BATCH_BEGIN, 0, "", 0);
+    return;
+  }
+  _batching = true;
+  _batchLen = 0;
+  _batchCount = 0;
+  _batchBinary = _binaryActive;  // Fixed for the whole batch
+}
+
+bool VwireClass::_batchAppendRecord(const uint8_t* record, size_t len) {
+  // TLV batch: [0x10] followed by [pin][tlv] records
+  if (!_batchBinary) return false;
+  if (_batchLen + len + (_batchCount == 0) > sizeof(_batchBuffer)) {
+    if (_batchCount == 0) return false;
+    _publishBatch();
+    if (1 + len > sizeof(_batchBuffer)) return false;
+  }
+  if (_batchCount == 0) _batchBuffer[_batchLen++] = VWIRE_FRAME_PINS;
+  memcpy(_batchBuffer + _batchLen, record, len);
+  _batchLen += len;
+  _batchCount++;
+  return true;
+}
+
+bool VwireClass::flushBatch() {
+  if (_netPosting()) return _netPost(VWIRE_RING_BATCH_FLUSH, 0, "", 0);
+  bool published = _publishBatch();
+  _batching = false;
+  return published;
+}
+
+bool VwireClass::isBatching() { return _batching; }
+
+bool VwireClass::_batchAppend(uint8_t pin, const char* value) {
+  if (_batchBinary) {
+    uint8_t record[1 + 2 + 255];
+    record[0] = pin;
+    size_t len = 1 + VwireTlv::encodeText(record + 1, value, strlen(value));
+    return _batchAppendRecord(record, len);
+  }
+  
+  // Entry: ,"V255":"<escaped>"  - always keep room for the closing '}' and NUL
+  char key[12];
+  int keyLen = snprintf(key, sizeof(key), "\"V%d\":\"", pin);
+  size_t needed = 1 + keyLen + _vwireJsonEscapedLength(value) + 1;
+  
+  if (_batchLen + needed + 2 > sizeof(_batchBuffer)) {
+    // Too big even for an empty batch - caller publishes it on its own
+    if (_batchCount == 0) return false;
+    _publishBatch();
+    if (needed + 2 > sizeof(_batchBuffer)) return false;
+  }
+  
+  char* out = _batchBuffer + _batchLen;
+  *out++ = (_batchCount == 0) ? '{' : ',';
+  memcpy(out, key, keyLen);
+  out += keyLen;
+  out = _vwireJsonEscape(out, value);
+  *out++ = '"';
+  
+  _batchLen = out - _batchBuffer;
+  _batchCount++;
+  return true;
+}
+
+bool VwireClass::_publishBatch() {
+  if (_batchCount == 0) return false;
+  
+  bool published = false;
+  if (_batchBinary) {
+    if (connected()) {
+      _publishFrame((const uint8_t*)_batchBuffer, _batchLen, _settings.dataRetain);
+      published = true;
+    } else {
+      _setError(VWIRE_ERR_NOT_CONNECTED);
+    }
+    _batchLen = 0;
+    _batchCount = 0;
+    return published;
+  }
+  
+  _batchBuffer[_batchLen++] = '}';
+  _batchBuffer[_batchLen] = '\0';
+  
+  if (connected()) {
+    char topic[VWIRE_MAX_TOPIC_LENGTH];
+    _buildTopic(topic, "batch");
+    _beginDataPublish(topic, _batchLen, _settings.dataRetain);
+    _mqtt->write((const uint8_t*)_batchBuffer, _batchLen);
+    _endPublish();
+    _debugPrintf("[Vwire] Batch: %d pins, %d bytes", _batchCount, _batchLen);
+    published = true;
+  } else {
+    _setError(VWIRE_ERR_NOT_CONNECTED);
+  }
+  
+  _batchLen = 0;
+  _batchCount = 0;
+  return published;
+}
+
+// =============================================================================
+// TIME-SERIES RECORDING
+// =============================================================================
+// Samples are packed as (uint16 dt, float value) - 6 bytes, no padding
+#define VWIRE_SERIES_SAMPLE_SIZE 6
+#define VWIRE_SERIES_ARENA_SAMPLES (VWIRE_SERIES_ARENA_SIZE / VWIRE_SERIES_SAMPLE_SIZE)
+
+bool VwireClass::setSeries(uint8_t pin, uint16_t samples, unsigned long maxAge, uint8_t decimals) {
+  if (pin >= VWIRE_MAX_VIRTUAL_PINS || samples == 0) {
+    _setError(VWIRE_ERR_INVALID_PIN);
+    return false;
+  }
+  
+  SeriesBuffer* series = _findSeries(pin);
+  if (series) {
+    // Arena space is never moved, so an existing buffer can only shrink
+    if (samples > series->capacity) {
+      _setError(VWIRE_ERR_BUFFER_FULL);
+      return false;
+    }
+    if (series->count >= samples && !_publishSeries(*series) && !_spillSeries(*series) &&
+        series->count > samples) {
+      _dropSeries(*series, series->count - samples);
+    }
+  } else {
+    if (_seriesCount >= VWIRE_MAX_SERIES || _seriesArenaUsed + samples > VWIRE_SERIES_ARENA_SAMPLES) {
+      _setError(VWIRE_ERR_BUFFER_FULL);
+      return false;
+    }
+    series = &_series[_seriesCount++];
+    series->pin = pin;
+    series->offset = _seriesArenaUsed;
+    series->count = 0;
+    _seriesArenaUsed += samples;
+  }
+  
+  series->capacity = samples;
+  series->maxAge = maxAge;
+  series->decimals = min(decimals, (uint8_t)6);
+  return true;
+}
+
+bool VwireClass::record(uint8_t pin, float value) {
+  // Through the outbox, stamped now so queueing does not skew the series
+  if (_netPosting()) return _netPost(VWIRE_RING_RECORD, pin, (const char*)&value, sizeof(value), millis());
+  return _recordAt(pin, value, millis());
+}
+
+bool VwireClass::_recordAt(uint8_t pin, float value, unsigned long now) {
+  SeriesBuffer* series = _findSeries(pin);
+  if (!series) {
+    if (!setSeries(pin, VWIRE_SERIES_DEFAULT_SAMPLES)) return false;
+    series = _findSeries(pin);
+  }
+  
+  // Deltas are 16-bit - start a new message after a long pause. Unsent
+  // samples older than the pause cannot stay in the buffer
+  if (series->count && now - series->lastAt > 0xFFFF) {
+    if (!_publishSeries(*series) && !_spillSeries(*series)) _dropSeries(*series, series->count);
+  }
+  
+  // Still full from an offline moment - try again, else hand the samples to
+  // the offline log, else drop the oldest so the buffer keeps the latest
+  bool dropped = false;
+  if (series->count >= series->capacity && !_publishSeries(*series) && !_spillSeries(*series)) {
+    _dropSeries(*series, series->count - series->capacity + 1);
+    dropped = true;
+  }
+  
+  uint16_t dt = series->count ? (uint16_t)(now - series->lastAt) : 0;
+  if (series->count == 0) series->firstAt = now;
+  series->lastAt = now;
+  
+  uint8_t* sample = _seriesArena + (size_t)(series->offset + series->count) * VWIRE_SERIES_SAMPLE_SIZE;
+  memcpy(sample, &dt, sizeof(dt));
+  memcpy(sample + sizeof(dt), &value, sizeof(value));
+  series->count++;
+  
+  // Full - publish, or spill to the offline log right away (no retry right
+  // after a drop, which keeps VWIRE_ERR_BUFFER_FULL as the last error)
+  if (!dropped && series->count >= series->capacity && !_publishSeries(*series)) _spillSeries(*series);
+  return true;
+}
+
+bool VwireClass::flushSeries(uint8_t pin) {
+  if (_netPosting()) return _netPost(VWIRE_RING_SERIES_FLUSH, pin, "", 0);
+  SeriesBuffer* series = _findSeries(pin);
+  return series ? _publishSeries(*series) : false;
+}
+
+void VwireClass::flushSeries() {
+  if (_netPosting()) {
+    _netPost(VWIRE_RING_SERIES_FLUSH, 0xFF, "", 0);
+    return;
+  }
+  for (uint8_t i = 0; i < _seriesCount; i++) {
+    _publishSeries(_series[i]);
+  }
+}
+
+void VwireClass::clearSeries() {
+  _seriesCount = 0;
+  _seriesArenaUsed = 0;
+}
+
+void VwireClass::setSeriesDeltaEncoding(bool enable) {
+  _seriesDelta = enable;
+}
+
+VwireClass::SeriesBuffer* VwireClass::_findSeries(uint8_t pin) {
+  for (uint8_t i = 0; i < _seriesCount; i++) {
+    if (_series[i].pin == pin) return &_series[i];
+  }
+  return nullptr;
+}
+
+bool VwireClass::_publishSeries(SeriesBuffer& series) {
+  if (series.count == 0) return false;
+  if (!connected()) {
+    _setError(VWIRE_ERR_NOT_CONNECTED);
+    return false;
+  }
+  
+  const uint8_t* samples = _seriesArena + (size_t)series.offset * VWIRE_SERIES_SAMPLE_SIZE;
+  uint16_t dt;
+  float value;
+  
+  // Fixed-rate sampling collapses "dt" to a single number
+  bool uniform = true;
+  uint16_t firstDt = 0;
+  for (uint16_t i = 1; i < series.count; i++) {
+    memcpy(&dt, samples + i * VWIRE_SERIES_SAMPLE_SIZE, sizeof(dt));
+    if (i == 1) firstDt = dt;
+    else if (dt != firstDt) { uniform = false; break; }
+  }
+  
+  long scale = 1;
+  for (uint8_t i = 0; i < series.decimals; i++) scale *= 10;
+  
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "series");
+  unsigned long age = millis() - series.firstAt;
+  size_t length = 0;
+  
+  // Pass 0 measures the payload, pass 1 streams it
+  for (uint8_t pass = 0; pass < 2; pass++) {
+    VwireStreamWriter out(pass ? _mqtt : nullptr);
+    if (pass && !_beginDataPublish(topic, length, false)) return false;
+    
+    char num[48];
+    snprintf(num, sizeof(num), "{\"pin\":\"V%d\",\"age\":%lu", series.pin, age);
+    out.put(num);
+    
+    if (series.count > 1) {
+      out.put(",\"dt\":");
+      if (uniform) {
+        snprintf(num, sizeof(num), "%u", firstDt);
+        out.put(num);
+      } else {
+        for (uint16_t i = 1; i < series.count; i++) {
+          memcpy(&dt, samples + i * VWIRE_SERIES_SAMPLE_SIZE, sizeof(dt));
+          snprintf(num, sizeof(num), "%c%u", (i == 1) ? '[' : ',', dt);
+          out.put(num);
+        }
+        out.put("]");
+      }
+    }
+    
+    if (_seriesDelta) {
+      snprintf(num, sizeof(num), ",\"enc\":\"delta\",\"scale\":%ld", scale);
+      out.put(num);
+    }
+    out.put(",\"v\":");
+    
+    long previous = 0;
+    for (uint16_t i = 0; i < series.count; i++) {
+      memcpy(&value, samples + i * VWIRE_SERIES_SAMPLE_SIZE + sizeof(dt), sizeof(value));
+      num[0] = (i == 0) ? '[' : ',';
+      size_t n;
+      if (_seriesDelta) {
+        long scaled = (long)(value * scale + (value < 0 ? -0.5f : 0.5f));
+        n = snprintf(num + 1, sizeof(num) - 1, "%ld", scaled - previous);
+        previous = scaled;
+      } else {
+        n = VirtualPin::formatFloat(num + 1, sizeof(num) - 1, value, series.decimals);
+      }
+      out.put(num, n + 1);
+    }
+    out.put("]}");
+    
+    if (pass) {
+      out.flush();
+      _endPublish();
+    }
+    length = out.length;
+  }
+  
+  _debugPrintf("[Vwire] Series V%d: %u samples, %u bytes", series.pin, series.count, (unsigned)length);
+  series.count = 0;
+  return true;
+}
+
+// =============================================================================
+// OFFLINE BUFFER
+// =============================================================================
+bool VwireClass::enableOfflineLog(bool useFlash) {
+  // Attached devices would share the owner's segment files - keep them in RAM
+  if (!_offlineLog.begin(useFlash && !_owner)) {
+    _setError(VWIRE_ERR_BUFFER_FULL);
+    return false;
+  }
+  _debugPrintf("[Vwire] Offline log: %s, %lu records buffered",
+               _offlineLog.usesFlash() ? "LittleFS" : "RAM", (unsigned long)_offlineLog.count());
+  return true;
+}
+
+void VwireClass::disableOfflineLog() {
+  _offlineLog.end();
+}
+
+void VwireClass::clearOfflineLog() {
+  _offlineLog.clear();
+}
+
+uint32_t VwireClass::getOfflineCount() {
+  return _offlineLog.count();
+}
+
+void VwireClass::setOfflineReplay(uint8_t maxPerBatch, unsigned long interval) {
+  _replayBatch = constrain(maxPerBatch, 1, VWIRE_OFFLINE_REPLAY_MAX);
+  _replayInterval = interval;
+}
+
+void VwireClass::setTimeSource(TimeSourceCallback cb) {
+  _timeSource = cb;
+}
+
+void VwireClass::_captureOffline(uint8_t pin, const char* value) {
+  // Same filtering as live sends, so deadbands also save flash writes
+  if (_policyCount && !_passesPolicy(pin, value)) return;
+  
+  uint32_t stamp = _timeSource ? _timeSource() : 0;
+  if (stamp) {
+    _offlineLog.append(pin, value, stamp, VWIRE_LOG_EPOCH);
+  } else {
+    _offlineLog.append(pin, value, millis(), 0);
+  }
+}
+
+void VwireClass::_spillSeries() {
+  for (uint8_t i = 0; i < _seriesCount; i++) {
+    _spillSeries(_series[i]);
+  }
+}
+
+bool VwireClass::_spillSeries(SeriesBuffer& series) {
+  if (!_offlineLog.isEnabled()) return false;
+  
+  unsigned long now = millis();
+  uint32_t epoch = _timeSource ? _timeSource() : 0;
+  const uint8_t* sample = _seriesArena + (size_t)series.offset * VWIRE_SERIES_SAMPLE_SIZE;
+  unsigned long at = series.firstAt;
+  for (uint16_t n = 0; n < series.count; n++, sample += VWIRE_SERIES_SAMPLE_SIZE) {
+    uint16_t dt;
+    float value;
+    memcpy(&dt, sample, sizeof(dt));
+    memcpy(&value, sample + sizeof(dt), sizeof(value));
+    at += dt;
+    
+    char text[24];
+    VirtualPin::formatFloat(text, sizeof(text), value, series.decimals);
+    if (epoch) {
+      _offlineLog.append(series.pin, text, epoch - (now - at) / 1000, VWIRE_LOG_EPOCH);
+    } else {
+      _offlineLog.append(series.pin, text, at, 0);
+    }
+  }
+  series.count = 0;
+  return true;
+}
+
+void VwireClass::_dropSeries(SeriesBuffer& series, uint16_t samples) {
+  if (samples > series.count) samples = series.count;
+  if (samples == 0) return;
+  _debugPrintf("[Vwire] Series V%d: offline, %u samples dropped", series.pin, samples);
+  _setError(VWIRE_ERR_BUFFER_FULL);
+  #if VWIRE_ENABLE_STATS
+  _stats.samplesDropped += samples;
+  #endif
+  
+  series.count -= samples;
+  if (series.count == 0) return;
+  
+  // The new first sample keeps its time, with a zero delta like any first sample
+  uint8_t* first = _seriesArena + (size_t)series.offset * VWIRE_SERIES_SAMPLE_SIZE;
+  uint8_t* kept = first + (size_t)samples * VWIRE_SERIES_SAMPLE_SIZE;
+  const uint8_t* sample = first + VWIRE_SERIES_SAMPLE_SIZE;
+  uint16_t dt;
+  for (uint16_t n = 1; n <= samples; n++, sample += VWIRE_SERIES_SAMPLE_SIZE) {
+    memcpy(&dt, sample, sizeof(dt));
+    series.firstAt += dt;
+  }
+  memmove(first, kept, (size_t)series.count * VWIRE_SERIES_SAMPLE_SIZE);
+  dt = 0;
+  memcpy(first, &dt, sizeof(dt));
+}
+
+void VwireClass::_replayOfflineLog() {
+  unsigned long now = millis();
+  if (now - _lastReplay < _replayInterval) return;
+  
+  // Live values queued by setPublishRate() or an open batch go first
+  if (_queuedCount || _batching) return;
+  
+  VwireLogRecord records[VWIRE_OFFLINE_REPLAY_MAX];
+  uint8_t count = _offlineLog.peek(records, _replayBatch);
+  if (count == 0) return;
+  
+  // [{"seq":12,"pin":"V0","value":"23.5","age":61000},...]
+  size_t scratchMark = _scratchUsed;
+  size_t capacity = min((size_t)VWIRE_JSON_BUFFER_SIZE, (size_t)(VWIRE_SCRATCH_SIZE - _scratchUsed));
+  if (capacity < 64) return;  // Arena busy - try again next run()
+  char* payload = _scratchAlloc(capacity);
+  size_t len = 0;
+  uint8_t used = 0, sent = 0;
+  payload[len++] = '[';
+  
+  for (; used < count; used++) {
+    VwireLogRecord& rec = records[used];
+    if (rec.pin == VWIRE_LOG_INVALID) continue;  // Unreadable on flash - skip it
+    
+    char value[VWIRE_OFFLINE_VALUE_LENGTH + 1];
+    memcpy(value, rec.value, rec.len);
+    value[rec.len] = '\0';
+    
+    char head[48];
+    int headLen = snprintf(head, sizeof(head), "%s{\"seq\":%lu,\"pin\":\"V%d\",\"value\":\"",
+                           sent ? "," : "", (unsigned long)rec.seq, rec.pin);
+    char tail[24];
+    int tailLen;
+    if (rec.flags & VWIRE_LOG_EPOCH) {
+      tailLen = snprintf(tail, sizeof(tail), "\",\"ts\":%lu}", (unsigned long)rec.stamp);
+    } else if ((int32_t)(rec.seq - _offlineLog.bootSeq()) >= 0) {
+      tailLen = snprintf(tail, sizeof(tail), "\",\"age\":%lu}", (unsigned long)(now - rec.stamp));
+    } else {
+      tailLen = snprintf(tail, sizeof(tail), "\"}");  // millis() from a previous boot - no timing
+    }
+    
+    size_t needed = headLen + _vwireJsonEscapedLength(value) + tailLen;
+    if (len + needed + 2 > capacity) {
+      if (sent == 0) used++;  // Can never fit - drop it rather than stall the log
+      break;
+    }
+    
+    memcpy(payload + len, head, headLen);
+    len += headLen;
+    len = _vwireJsonEscape(payload + len, value) - payload;
+    memcpy(payload + len, tail, tailLen);
+    len += tailLen;
+    sent++;
+  }
+  payload[len++] = ']';
+  payload[len] = '\0';
+  
+  if (sent) {
+    char topic[VWIRE_MAX_TOPIC_LENGTH];
+    _buildTopic(topic, "backlog");
+    bool ok = _beginDataPublish(topic, len, false);
+    if (ok) {
+      _mqtt->write((const uint8_t*)payload, len);
+      ok = _endPublish();
+    }
+    _scratchUsed = scratchMark;
+    if (!ok) return;  // Keep records for next time
+    _debugPrintf("[Vwire] Replayed %d offline records (%lu left)",
+                 sent, (unsigned long)(_offlineLog.count() - used));
+  }
+  
+  _scratchUsed = scratchMark;
+  _offlineLog.consume(used);
+  _lastReplay = now;
+}
+
+// =============================================================================
+// EVENT HANDLERS
+// =============================================================================
+void VwireClass::onVirtualReceive(uint8_t pin, PinHandler handler) {
+  if (_pinHandlerCount >= VWIRE_MAX_HANDLERS) {
+    _setError(VWIRE_ERR_HANDLER_FULL);
+    _debugPrint("[Vwire] Error: Max handlers reached!");
+    return;
+  }
+  
+  _pinHandlers[_pinHandlerCount].pin = pin;
+  _pinHandlers[_pinHandlerCount].handler = handler;
+  _pinHandlers[_pinHandlerCount].active = true;
+  _pinHandlerCount++;
+  
+  // Keep the dispatch table current for handlers added after begin()
+  _buildDispatchTable();
+  
+  _debugPrintf("[Vwire] Handler registered for V%d", pin);
+}
+
+void VwireClass::onVirtualRead(uint8_t pin, ReadHandler handler) {
+  if (_readHandlerCount >= VWIRE_MAX_READ_HANDLERS) {
+    _setError(VWIRE_ERR_HANDLER_FULL);
+    _debugPrint("[Vwire] Error: Max read handlers reached!");
+    return;
+  }
+  
+  // The first handler added while online needs the read subscription
+  bool subscribe = !_hasReadHandlers() && connected();
+  
+  _readHandlers[_readHandlerCount].pin = pin;
+  _readHandlers[_readHandlerCount].handler = handler;
+  _readHandlerCount++;
+  _buildDispatchTable();
+  
+  if (subscribe) {
+    char topic[VWIRE_MAX_TOPIC_LENGTH];
+    _buildTopic(topic, "read/#");
+    _mqtt->subscribe(topic, 0);
+  }
+  
+  _debugPrintf("[Vwire] Read handler registered for V%d", pin);
+}
+
+void VwireClass::onConnect(ConnectionHandler handler) { _connectHandler = handler; }
+void VwireClass::onDisconnect(ConnectionHandler handler) { _disconnectHandler = handler; }
+void VwireClass::onMessage(RawMessageHandler handler) { _messageHandler = handler; }
+
+// =============================================================================
+// READ REQUESTS
+// =============================================================================
+bool VwireClass::setReadCache(uint8_t pin, unsigned long ttl) {
+  ReadCache* cache = _findReadCache(pin);
+  if (ttl == 0) {
+    if (cache) {
+      cache->active = false;
+      _readCacheCount--;
+    }
+    return true;
+  }
+  
+  if (!cache) {
+    for (uint8_t i = 0; i < VWIRE_MAX_READ_CACHES && !cache; i++) {
+      if (!_readCaches[i].active) cache = &_readCaches[i];
+    }
+    if (!cache) {
+      _setError(VWIRE_ERR_BUFFER_FULL);
+      _debugPrint("[Vwire] Error: Max read caches reached!");
+      return false;
+    }
+    memset(cache, 0, sizeof(ReadCache));
+    cache->pin = pin;
+    cache->active = true;
+    _readCacheCount++;
+  }
+  cache->ttl = ttl;
+  return true;
+}
+
+VwireClass::ReadCache* VwireClass::_findReadCache(uint8_t pin) {
+  for (uint8_t i = 0; i < VWIRE_MAX_READ_CACHES; i++) {
+    if (_readCaches[i].active && _readCaches[i].pin == pin) return &_readCaches[i];
+  }
+  return nullptr;
+}
+
+bool VwireClass::_answerFromCache(uint8_t pin) {
+  // Polled again inside the TTL - resend the last value, skip the sensor
+  ReadCache* cache = _readCacheCount ? _findReadCache(pin) : nullptr;
+  if (!cache || !cache->valid || millis() - cache->cachedAt >= cache->ttl) return false;
+  _publishPin(pin, cache->value);
+  return true;
+}
+
+void VwireClass::_runReadHandler(uint8_t pin) {
+  ReadHandler handler = _readDispatch[pin];
+  if (!handler) return;
+  _readingPin = pin;
+  #if VWIRE_ENABLE_STATS
+  uint32_t started = micros();
+  handler();
+  _stats.handlerCalls++;
+  _stats.handlerTime.add(micros() - started);
+  #else
+  handler();
+  #endif
+  _readingPin = -1;
+}
+
+// =============================================================================
+// COMMAND COALESCING
+// =============================================================================
+bool VwireClass::setCoalesce(uint8_t pin, bool enable) {
+  CoalesceSlot* slot = _findCoalesce(pin);
+  if (!enable) {
+    if (slot) {
+      if (slot->held) _runHeldCommand(*slot);
+      slot->active = false;
+      _coalesceCount--;
+    }
+    return true;
+  }
+  if (slot) return true;
+  
+  for (uint8_t i = 0; i < VWIRE_MAX_COALESCED_PINS && !slot; i++) {
+    if (!_coalesce[i].active) slot = &_coalesce[i];
+  }
+  if (!slot) {
+    _setError(VWIRE_ERR_BUFFER_FULL);
+    _debugPrint("[Vwire] Error: Max coalesced pins reached!");
+    return false;
+  }
+  memset(slot, 0, sizeof(CoalesceSlot));
+  slot->pin = pin;
+  slot->active = true;
+  _coalesceCount++;
+  return true;
+}
+
+VwireClass::CoalesceSlot* VwireClass::_findCoalesce(uint8_t pin) {
+  for (uint8_t i = 0; i < VWIRE_MAX_COALESCED_PINS; i++) {
+    if (_coalesce[i].active && _coalesce[i].pin == pin) return &_coalesce[i];
+  }
+  return nullptr;
+}
+
+bool VwireClass::_holdCommand(uint8_t pin, const char* value, size_t len) {
+  CoalesceSlot* slot = _findCoalesce(pin);
+  if (!slot) return false;
+  
+  #if VWIRE_ENABLE_STATS
+  if (slot->held) _stats.commandsCoalesced++;
+  #endif
+  
+  if (len >= sizeof(slot->value)) {
+    // Too long to hold - it goes to the handler now and the older value is stale
+    if (slot->held) {
+      slot->held = false;
+      _coalesceHeld--;
+    }
+    return false;
+  }
+  
+  memcpy(slot->value, value, len);
+  slot->value[len] = '\0';
+  slot->len = len;
+  if (!slot->held) {
+    slot->held = true;
+    _coalesceHeld++;
+  }
+  return true;
+}
+
+void VwireClass::_runHeldCommand(CoalesceSlot& slot) {
+  slot.held = false;
+  _coalesceHeld--;
+  PinHandler handler = _pinDispatch[slot.pin];
+  if (!handler) return;
+  
+  // Copied - a command arriving while the handler runs may refill the slot
+  VirtualPin vpin;
+  vpin.set(slot.value, slot.len);
+  _callPinHandler(handler, vpin);
+}
+
+void VwireClass::_flushCoalesced() {
+  for (uint8_t i = 0; i < VWIRE_MAX_COALESCED_PINS && _coalesceHeld; i++) {
+    if (_coalesce[i].active && _coalesce[i].held) _runHeldCommand(_coalesce[i]);
+  }
+}
+
+void VwireClass::_callPinHandler(PinHandler handler, VirtualPin& vpin) {
+  #if VWIRE_ENABLE_STATS
+  uint32_t started = micros();
+  handler(vpin);
+  _stats.handlerCalls++;
+  _stats.handlerTime.add(micros() - started);
+  #else
+  handler(vpin);
+  #endif
+}
+
+// =============================================================================
+// NOTIFICATIONS
+// =============================================================================
+void VwireClass::notify(const char* message) {
+  if (_netPosting()) {
+    _netPost(VWIRE_RING_NOTIFY, 0, message, strlen(message));
+    return;
+  }
+  if (!connected()) return;
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "notify");
+  unsigned int len = strlen(message);
+  _beginPublish(topic, len, false);
+  _mqtt->print(message);
+  _endPublish();
+  _debugPrintf("[Vwire] Notify: %s", message);
+}
+
+void VwireClass::email(const char* subject, const char* body) {
+  #if VWIRE_HAS_NET_TASK
+  if (_netPosting()) {
+    // "subject\0body" in one record
+    size_t subjectLen = strlen(subject);
+    size_t bodyLen = strlen(body);
+    VwireRingRecord* rec = (subjectLen + 1 + bodyLen <= VWIRE_NET_VALUE_LENGTH) ? _netOutbox.reserve() : nullptr;
+    if (!rec) {
+      _setError(VWIRE_ERR_BUFFER_FULL);
+      return;
+    }
+    memcpy(rec->value, subject, subjectLen + 1);
+    memcpy(rec->value + subjectLen + 1, body, bodyLen + 1);
+    rec->type = VWIRE_RING_EMAIL;
+    rec->len = subjectLen + 1 + bodyLen;
+    _netOutbox.commit();
+    xTaskNotifyGive(_netTask);
+    return;
+  }
+  #endif
+  if (!connected()) return;
+  
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "email");
+  
+  // {"subject":"...","body":"..."} streamed without a payload buffer
+  size_t subjectLen = strlen(subject);
+  size_t bodyLen = strlen(body);
+  _beginPublish(topic, 24 + subjectLen + bodyLen, false);
+  _mqtt->print("{\"subject\":\"");
+  _mqtt->write((const uint8_t*)subject, subjectLen);
+  _mqtt->print("\",\"body\":\"");
+  _mqtt->write((const uint8_t*)body, bodyLen);
+  _mqtt->print("\"}");
+  _endPublish();
+  _debugPrintf("[Vwire] Email: %s", subject);
+}
+
+void VwireClass::log(const char* message) {
+  if (_netPosting()) {
+    _netPost(VWIRE_RING_LOG, 0, message, strlen(message));
+    return;
+  }
+  if (!connected()) return;
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "log");
+  unsigned int len = strlen(message);
+  _beginPublish(topic, len, false);
+  _mqtt->print(message);
+  _endPublish();
+}
+
+// =============================================================================
+// DEVICE INFO
+// =============================================================================
+const char* VwireClass::getDeviceId() { return _deviceId; }
+const char* VwireClass::getBoardName() { return VWIRE_BOARD_NAME; }
+const char* VwireClass::getVersion() { return VWIRE_VERSION; }
+
+uint32_t VwireClass::getFreeHeap() {
+  #if defined(VWIRE_BOARD_ESP32) || defined(VWIRE_BOARD_ESP8266)
+  return ESP.getFreeHeap();
+  #else
+  return 0;
+  #endif
+}
+
+uint32_t VwireClass::getMaxFreeBlock() {
+  #if defined(VWIRE_BOARD_ESP32)
+  return ESP.getMaxAllocHeap();
+  #elif defined(VWIRE_BOARD_ESP8266)
+  return ESP.getMaxFreeBlockSize();
+  #else
+  return 0;
+  #endif
+}
+
+uint8_t VwireClass::getHeapFragmentation() {
+  #if defined(VWIRE_BOARD_ESP8266)
+  return ESP.getHeapFragmentation();
+  #elif defined(VWIRE_BOARD_ESP32)
+  uint32_t freeHeap = getFreeHeap();
+  if (freeHeap == 0) return 0;
+  return 100 - (uint8_t)((uint64_t)getMaxFreeBlock() * 100 / freeHeap);
+  #else
+  return 0;
+  #endif
+}
+
+uint32_t VwireClass::getUptime() {
+  return (millis() - _startTime) / 1000;
+}
+
+// =============================================================================
+// STATISTICS
+// =============================================================================
+const VwireStats& VwireClass::getStats() {
+  #if VWIRE_ENABLE_STATS
+  return _stats;
+  #else
+  static const VwireStats none;  // Compiled out - always zero
+  return none;
+  #endif
+}
+
+void VwireClass::resetStats() {
+  #if VWIRE_ENABLE_STATS
+  _stats.reset();
+  #endif
 }
 
-void VwireClass::syncVirtual(uint8_t pin) {
-  if (!connected()) return;
-  // Use stack buffer for topic
-  char topic[96];
-  snprintf(topic, sizeof(topic), "vwire/%s/sync/V%d", _deviceId, pin);
-  _mqttClient.beginPublish(topic, 0, false);
-  _mqttClient.endPublish();
+void VwireClass::setHeartbeatStats(bool enable) {
+  _heartbeatStats = enable;
 }
 
-void VwireClass::syncAll() {
-  if (!connected()) return;
-  char topic[96];
-  snprintf(topic, sizeof(topic), "vwire/%s/sync", _deviceId);
-  _mqttClient.beginPublish(topic, 3, false);
-  _mqttClient.print("all");
-  _mqttClient.endPublish();
+#if VWIRE_ENABLE_STATS
+size_t VwireClass::_formatStats(char* out, size_t size) {
+  // Counters, then [min,avg,max] in microseconds per histogram
+  const VwireHistogram* timings[4] = {
+    &_stats.runTime, &_stats.publishTime, &_stats.handlerTime, &_stats.connectTime
+  };
+  static const char* const names[4] = {"run", "publish", "handler", "connect"};
+
+  int len = snprintf(out, size,
+                     "{\"pub\":%lu,\"txBytes\":%lu,\"rx\":%lu,\"rxBytes\":%lu,"
+                     "\"dropOffline\":%lu,\"dropFull\":%lu,\"retries\":%lu,"
+                     "\"reconnects\":%lu,\"connectFails\":%lu,\"handlers\":%lu,\"coalesced\":%lu,"
+                     "\"samplesDropped\":%lu,"
+                     "\"maxBlock\":%lu,\"frag\":%u",
+                     (unsigned long)_stats.publishes, (unsigned long)_stats.bytesSent,
+                     (unsigned long)_stats.messagesReceived, (unsigned long)_stats.bytesReceived,
+                     (unsigned long)_stats.dropsNotConnected, (unsigned long)_stats.dropsQueueFull,
+                     (unsigned long)_stats.retries, (unsigned long)_stats.reconnects,
+                     (unsigned long)_stats.connectFailures, (unsigned long)_stats.handlerCalls,
+                     (unsigned long)_stats.commandsCoalesced, (unsigned long)_stats.samplesDropped,
+                     (unsigned long)getMaxFreeBlock(), (unsigned)getHeapFragmentation());
+  for (uint8_t i = 0; i < 4 && len > 0 && (size_t)len < size; i++) {
+    len += snprintf(out + len, size - len, ",\"%s\":[%lu,%lu,%lu]", names[i],
+                    (unsigned long)timings[i]->min, (unsigned long)timings[i]->avg(),
+                    (unsigned long)timings[i]->max);
+  }
+  if (len > 0 && (size_t)len + 1 < size) {
+    out[len++] = '}';
+    out[len] = '\0';
+    return len;
+  }
+  return 0;  // Did not fit
 }
+#endif
 
 // =============================================================================
-// EVENT HANDLERS
+// NETWORK TASK
 // =============================================================================
-void VwireClass::onVirtualReceive(uint8_t pin, PinHandler handler) {
-  if (_pinHandlerCount >= VWIRE_MAX_HANDLERS) {
-    _setError(VWIRE_ERR_HANDLER_FULL);
-    _debugPrint("[Vwire] Error: Max handlers reached!");
-    return;
+#if VWIRE_HAS_NET_TASK
+bool VwireClass::startNetworkTask(VwireDispatch dispatch, uint8_t core) {
+  if (_netTask || _owner || _attachedCount) return false;  // Not in gateway mode
+  if (!_netOutbox.begin(VWIRE_NET_QUEUE_SIZE) || !_netInbox.begin(VWIRE_NET_QUEUE_SIZE)) {
+    _netOutbox.end();
+    _netInbox.end();
+    _setError(VWIRE_ERR_BUFFER_FULL);
+    return false;
   }
   
-  _pinHandlers[_pinHandlerCount].pin = pin;
-  _pinHandlers[_pinHandlerCount].handler = handler;
-  _pinHandlers[_pinHandlerCount].active = true;
-  _pinHandlerCount++;
+  _netDispatch = dispatch;
+  _netStopping = false;
+  TaskHandle_t task = nullptr;
+  if (xTaskCreatePinnedToCore(_netTaskEntry, "vwire_net", VWIRE_NET_TASK_STACK, this,
+                              VWIRE_NET_TASK_PRIORITY, &task, core) != pdPASS) {
+    _netOutbox.end();
+    _netInbox.end();
+    return false;
+  }
   
-  _debugPrintf("[Vwire] Handler registered for V%d", pin);
+  // The task waits for this, so it never runs before _netTask is set
+  _netTask = task;
+  xTaskNotifyGive(task);
+  _debugPrintf("[Vwire] Network task started on core %u", core);
+  return true;
 }
 
-void VwireClass::onConnect(ConnectionHandler handler) { _connectHandler = handler; }
-void VwireClass::onDisconnect(ConnectionHandler handler) { _disconnectHandler = handler; }
-void VwireClass::onMessage(RawMessageHandler handler) { _messageHandler = handler; }
+void VwireClass::stopNetworkTask() {
+  if (!_netTask) return;
+  if (!_netPosting()) {
+    _netStopping = true;  // From a handler on the task itself - exits after it
+    return;
+  }
+  
+  __atomic_store_n(&_netStopping, true, __ATOMIC_RELEASE);
+  xTaskNotifyGive(_netTask);
+  while (__atomic_load_n(&_netTask, __ATOMIC_ACQUIRE)) {
+    vTaskDelay(1);
+  }
+  
+  // Handlers still waiting, then back to single-task operation
+  _netDrainInbox();
+  _netOutbox.end();
+  _netInbox.end();
+  _debugPrint("[Vwire] Network task stopped");
+}
 
-// =============================================================================
-// NOTIFICATIONS
-// =============================================================================
-void VwireClass::notify(const char* message) {
-  if (!connected()) return;
-  char topic[96];
-  snprintf(topic, sizeof(topic), "vwire/%s/notify", _deviceId);
-  unsigned int len = strlen(message);
-  _mqttClient.beginPublish(topic, len, false);
-  _mqttClient.print(message);
-  _mqttClient.endPublish();
-  _debugPrintf("[Vwire] Notify: %s", message);
+bool VwireClass::isNetworkTaskRunning() const {
+  return _netTask != nullptr;
 }
 
-void VwireClass::email(const char* subject, const char* body) {
-  if (!connected()) return;
+void VwireClass::_netTaskEntry(void* arg) {
+  VwireClass* self = (VwireClass*)arg;
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // Until startNetworkTask() set _netTask
   
-  char topic[96];
-  char buffer[VWIRE_JSON_BUFFER_SIZE];
-  
-  snprintf(topic, sizeof(topic), "vwire/%s/email", _deviceId);
-  snprintf(buffer, sizeof(buffer), "{\"subject\":\"%s\",\"body\":\"%s\"}", subject, body);
+  while (!__atomic_load_n(&self->_netStopping, __ATOMIC_ACQUIRE)) {
+    self->_netDrainOutbox();
+    self->run();
+    ulTaskNotifyTake(pdTRUE, 1);  // Woken early by the application posting
+  }
+  self->_netDrainOutbox();
   
-  unsigned int len = strlen(buffer);
-  _mqttClient.beginPublish(topic, len, false);
-  _mqttClient.print(buffer);
-  _mqttClient.endPublish();
-  _debugPrintf("[Vwire] Email: %s", subject);
+  // Releases the client and rings back to stopNetworkTask()
+  __atomic_store_n(&self->_netTask, (TaskHandle_t)nullptr, __ATOMIC_RELEASE);
+  vTaskDelete(nullptr);
 }
 
-void VwireClass::log(const char* message) {
-  if (!connected()) return;
-  char topic[96];
-  snprintf(topic, sizeof(topic), "vwire/%s/log", _deviceId);
-  unsigned int len = strlen(message);
-  _mqttClient.beginPublish(topic, len, false);
-  _mqttClient.print(message);
-  _mqttClient.endPublish();
+bool VwireClass::_netPost(uint8_t type, uint8_t pin, const char* data, size_t len, uint32_t stamp) {
+  VwireRingRecord* rec = (len <= VWIRE_NET_VALUE_LENGTH) ? _netOutbox.reserve() : nullptr;
+  if (!rec) {
+    _setError(VWIRE_ERR_BUFFER_FULL);
+    return false;
+  }
+  rec->type = type;
+  rec->pin = pin;
+  rec->len = len;
+  rec->stamp = stamp;
+  memcpy(rec->value, data, len);
+  rec->value[len] = '\0';
+  _netOutbox.commit();
+  xTaskNotifyGive(_netTask);
+  return true;
+}
+
+void VwireClass::_netDrainOutbox() {
+  VwireRingRecord* rec;
+  while ((rec = _netOutbox.front()) != nullptr) {
+    switch (rec->type) {
+      case VWIRE_RING_PIN:
+      case VWIRE_RING_ANSWER:
+        _sendPinValue(rec->pin, rec->value, rec->type == VWIRE_RING_ANSWER);
+        break;
+      case VWIRE_RING_RECORD: {
+        float value;
+        memcpy(&value, rec->value, sizeof(value));
+        _recordAt(rec->pin, value, rec->stamp);
+        break;
+      }
+      case VWIRE_RING_NOTIFY:
+        notify(rec->value);
+        break;
+      case VWIRE_RING_EMAIL:
+        email(rec->value, rec->value + strlen(rec->value) + 1);
+        break;
+      case VWIRE_RING_LOG:
+        log(rec->value);
+        break;
+      case VWIRE_RING_SYNC:
+        if (rec->pin == 0xFF) syncAll(); else syncVirtual(rec->pin);
+        break;
+      case VWIRE_RING_BATCH_BEGIN:
+        beginBatch();
+        break;
+      case VWIRE_RING_BATCH_FLUSH:
+        flushBatch();
+        break;
+      case VWIRE_RING_SERIES_FLUSH:
+        if (rec->pin == 0xFF) flushSeries(); else flushSeries(rec->pin);
+        break;
+      default:
+        break;
+    }
+    _netOutbox.pop();
+  }
+}
+
+void VwireClass::_netDrainInbox() {
+  VwireRingRecord* rec;
+  while ((rec = _netInbox.front()) != nullptr) {
+    switch (rec->type) {
+      case VWIRE_RING_CMD: {
+        // The record stays put until pop(), so the handler can view it
+        PinHandler handler = _pinDispatch[rec->pin];
+        if (handler && !(_coalesceCount && _holdCommand(rec->pin, rec->value, rec->len))) {
+          VirtualPin vpin;
+          vpin.setView(rec->value, rec->len);
+          _callPinHandler(handler, vpin);
+        }
+        break;
+      }
+      case VWIRE_RING_READ:
+        _runReadHandler(rec->pin);  // The network task already tried the cache
+        break;
+      case VWIRE_RING_CONNECT:
+        if (_connectHandler) _connectHandler();
+        if (_vwireAutoConnectHandler) _vwireAutoConnectHandler();
+        break;
+      case VWIRE_RING_DISCONNECT:
+        if (_disconnectHandler) _disconnectHandler();
+        if (_vwireAutoDisconnectHandler) _vwireAutoDisconnectHandler();
+        break;
+      default:
+        break;
+    }
+    _netInbox.pop();
+  }
+}
+#else
+bool VwireClass::startNetworkTask(VwireDispatch dispatch, uint8_t core) {
+  (void)dispatch;
+  (void)core;
+  return false;
+}
+
+void VwireClass::stopNetworkTask() {}
+
+bool VwireClass::isNetworkTaskRunning() const {
+  return false;
 }
+#endif
 
 // =============================================================================
-// DEVICE INFO
+// DEEP SLEEP
 // =============================================================================
-const char* VwireClass::getDeviceId() { return _deviceId; }
-const char* VwireClass::getBoardName() { return VWIRE_BOARD_NAME; }
-const char* VwireClass::getVersion() { return VWIRE_VERSION; }
-
-uint32_t VwireClass::getFreeHeap() {
-  #if defined(VWIRE_BOARD_ESP32) || defined(VWIRE_BOARD_ESP8266)
-  return ESP.getFreeHeap();
+bool VwireClass::sleepFor(unsigned long ms) {
+  #if VWIRE_HAS_RTC_CACHE
+  if (_owner) return false;  // The owner puts the whole board to sleep
+  #if VWIRE_HAS_NET_TASK
+  if (_netPosting()) stopNetworkTask();  // Flush its queue, then sleep from here
+  #endif
+  if (connected()) {
+    // Everything still buffered goes out now, in as few messages as possible
+    _flushForSleep();
+    for (uint8_t i = 0; i < _attachedCount; i++) {
+      if (_attached[i]->connected()) _attached[i]->_flushForSleep();
+    }
+    
+    unsigned long start = millis();
+    while (millis() - start < VWIRE_SLEEP_FLUSH_TIMEOUT) {
+      bool pending = _pendingCount != 0;
+      for (uint8_t i = 0; i < _attachedCount && !pending; i++) {
+        pending = _attached[i]->_pendingCount != 0;
+      }
+      if (!pending) break;
+      _mqtt->loop();
+      yield();
+    }
+    
+    _publishSleeping(ms);
+    for (uint8_t i = 0; i < _attachedCount; i++) {
+      if (_attached[i]->connected()) _attached[i]->_publishSleeping(ms);
+    }
+    
+    _mqtt->disconnect();  // Clean DISCONNECT - no last will
+  }
+  
+  // Anything record() could not send is kept in the offline log
+  _spillSeries();
+  for (uint8_t i = 0; i < _attachedCount; i++) {
+    _attached[i]->_spillSeries();
+    _attached[i]->_state = VWIRE_STATE_DISCONNECTED;
+  }
+  
+  _lastAwakeTime = millis();
+  _debugPrintf("[Vwire] Sleeping %lu ms (awake %lu ms)", ms, _lastAwakeTime);
+  _saveRtcState(ms, true);
+  _connectStage = STAGE_IDLE;
+  _state = VWIRE_STATE_DISCONNECTED;
+  
+  #if defined(VWIRE_BOARD_ESP32)
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+  esp_deep_sleep_start();
+  #elif defined(VWIRE_BOARD_ESP8266)
+  ESP.deepSleep(min((uint64_t)ms * 1000ULL, ESP.deepSleepMax()));
+  #endif
+  return true;
   #else
-  return 0;
+  (void)ms;
+  return false;
   #endif
 }
 
-uint32_t VwireClass::getUptime() {
-  return (millis() - _startTime) / 1000;
+void VwireClass::_flushForSleep() {
+  if (_batching) flushBatch();
+  if (_queuedCount) _drainPublishQueue(true);
+  flushSeries();
+}
+
+void VwireClass::_publishSleeping(unsigned long ms) {
+  // Retained, so the dashboard shows "sleeping" instead of "offline"
+  char payload[64];
+  int len = snprintf(payload, sizeof(payload),
+                     "{\"status\":\"sleeping\",\"wakeIn\":%lu,\"awake\":%lu}",
+                     ms, millis());
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "status");
+  _beginPublish(topic, len, true);
+  _mqtt->write((const uint8_t*)payload, len);
+  _endPublish();
 }
 
 // =============================================================================
@@ -673,39 +3465,301 @@ void VwireClass::handleOTA() {
 }
 #endif
 
+// =============================================================================
+// CLOUD OTA
+// =============================================================================
+bool VwireClass::enableCloudOTA(VwireOtaTarget* target) {
+  if (_owner) return false;  // The owner's firmware is the one running
+  #if VWIRE_HAS_OTA
+  static VwireFlashOtaTarget flashTarget;
+  if (!target) target = &flashTarget;
+  #endif
+  if (!target) {
+    _debugPrint("[Vwire] Cloud OTA needs a target on this board");
+    return false;
+  }
+  
+  // Enabled while online - subscribe now, later sessions include it
+  bool subscribe = !_otaTarget && connected();
+  _otaTarget = target;
+  if (subscribe) {
+    char topic[VWIRE_MAX_TOPIC_LENGTH];
+    _buildTopic(topic, "ota");
+    _mqtt->subscribe(topic, 1);
+    _buildTopic(topic, "ota/data");
+    _mqtt->subscribe(topic, 0);
+  }
+  _debugPrint("[Vwire] Cloud OTA enabled");
+  return true;
+}
+
+void VwireClass::onOtaProgress(OtaProgressHandler handler) {
+  _otaHandler = handler;
+}
+
+void VwireClass::_handleOtaAnnounce(const char* json) {
+  if (!_otaTarget) return;
+  
+  if (strstr(json, "\"cancel\":true")) {
+    if (_ota.active()) {
+      _debugPrint("[Vwire] OTA cancelled by server");
+      _failOta("cancelled");
+    }
+    return;
+  }
+  
+  char id[VWIRE_OTA_ID_LENGTH];
+  char md5[33] = "";
+  char base[33] = "";
+  uint32_t size, image;
+  if (!_vwireJsonString(json, "id", id, sizeof(id)) || !_vwireJsonUint(json, "size", &size) || size == 0) {
+    _debugPrint("[Vwire] OTA announcement ignored (no id/size)");
+    return;
+  }
+  if (!_vwireJsonUint(json, "image", &image)) image = size;
+  _vwireJsonString(json, "md5", md5, sizeof(md5));
+  _vwireJsonString(json, "base", base, sizeof(base));
+  
+  // The same job announced again - carry on from the current offset
+  if (_ota.active() && strcmp(_ota.id(), id) == 0) {
+    _otaRetries = 0;
+    _requestOtaWindow();
+    return;
+  }
+  if (_otaApplyPending) return;  // About to restart into the last image
+  
+  // A different job replaces the current one
+  if (!_ota.start(_otaTarget, id, size, image, md5, base)) {
+    _debugPrintf("[Vwire] OTA %s refused: %s", id, _ota.error());
+    _failOta();
+    return;
+  }
+  _debugPrintf("[Vwire] OTA %s: %lu bytes%s", id, (unsigned long)size, base[0] ? " (delta)" : "");
+  _publishOtaStatus("download", nullptr);
+  if (_otaHandler) _otaHandler(VWIRE_OTA_DOWNLOADING, 0, size);
+  _otaRetries = 0;
+  _requestOtaWindow();
+}
+
+void VwireClass::_handleOtaData(const uint8_t* data, size_t len) {
+  // [offset u32][bytes] - anything but the next expected offset is stale
+  if (!_ota.active() || len <= 4 || _vwireGet32(data) != _ota.received()) return;
+  
+  if (!_ota.write(data + 4, len - 4)) {
+    _debugPrintf("[Vwire] OTA write failed: %s", _ota.error());
+    _failOta();
+    return;
+  }
+  _otaRetries = 0;
+  _otaRequestedAt = millis();  // Progress - the timeout starts over
+  if (_otaHandler) _otaHandler(VWIRE_OTA_DOWNLOADING, _ota.received(), _ota.size());
+  
+  if (_ota.complete()) {
+    if (!_ota.finish()) {
+      _debugPrintf("[Vwire] OTA image rejected: %s", _ota.error());
+      _failOta();
+      return;
+    }
+    _debugPrint("[Vwire] OTA complete");
+    _publishOtaStatus("done", nullptr);
+    if (_otaHandler) _otaHandler(VWIRE_OTA_DONE, _ota.received(), _ota.size());
+    _otaApplyPending = true;  // Once the status had time to leave
+    _otaDoneAt = millis();
+    return;
+  }
+  
+  if (_ota.received() >= _otaWindowEnd) _requestOtaWindow();
+}
+
+void VwireClass::_requestOtaWindow() {
+  if (!connected()) return;  // Requested again by the next session
+  
+  // Largest chunk that fits the MQTT buffer next to the fixed header, topic,
+  // packet ID and offset - plus a spare byte so it is terminated in place
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  size_t overhead = 1 + 3 + 2 + _buildTopic(topic, "ota/data") + 2 + 4 + 1;
+  uint32_t chunk = VWIRE_OTA_CHUNK_SIZE;
+  uint16_t buffer = _mqtt->getBufferSize();
+  if (buffer > overhead && buffer - overhead < chunk) chunk = buffer - overhead;
+  
+  uint32_t offset = _ota.received();
+  uint32_t count = (_ota.size() - offset + chunk - 1) / chunk;
+  if (count > VWIRE_OTA_WINDOW) count = VWIRE_OTA_WINDOW;
+  _otaWindowEnd = offset + chunk * count;
+  if (_otaWindowEnd > _ota.size()) _otaWindowEnd = _ota.size();
+  _otaRequestedAt = millis();
+  
+  char payload[VWIRE_OTA_ID_LENGTH + 64];
+  int len = snprintf(payload, sizeof(payload), "{\"id\":\"%s\",\"offset\":%lu,\"chunk\":%lu,\"count\":%lu}",
+                     _ota.id(), (unsigned long)offset, (unsigned long)chunk, (unsigned long)count);
+  _buildTopic(topic, "ota/req");
+  _beginPublish(topic, len, false);
+  _mqtt->write((const uint8_t*)payload, len);
+  _endPublish();
+}
+
+void VwireClass::_publishOtaStatus(const char* state, const char* error) {
+  if (!connected()) return;
+  char payload[VWIRE_OTA_ID_LENGTH + 96];
+  int len;
+  if (error) {
+    len = snprintf(payload, sizeof(payload),
+                   "{\"id\":\"%s\",\"state\":\"%s\",\"offset\":%lu,\"size\":%lu,\"error\":\"%s\"}",
+                   _ota.id(), state, (unsigned long)_ota.received(), (unsigned long)_ota.size(), error);
+  } else {
+    len = snprintf(payload, sizeof(payload), "{\"id\":\"%s\",\"state\":\"%s\",\"offset\":%lu,\"size\":%lu}",
+                   _ota.id(), state, (unsigned long)_ota.received(), (unsigned long)_ota.size());
+  }
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "ota/status");
+  _beginPublish(topic, len, false);
+  _mqtt->write((const uint8_t*)payload, len);
+  _endPublish();
+}
+
+void VwireClass::_failOta(const char* error) {
+  _ota.abort();
+  if (!error) error = _ota.error() ? _ota.error() : "aborted";
+  _publishOtaStatus("error", error);
+  if (_otaHandler) _otaHandler(VWIRE_OTA_FAILED, _ota.received(), _ota.size());
+}
+
+void VwireClass::_serviceOta() {
+  unsigned long now = millis();
+  if (_otaApplyPending) {
+    if (now - _otaDoneAt >= VWIRE_OTA_RESTART_DELAY) {
+      _otaApplyPending = false;
+      _otaTarget->apply();
+    }
+    return;
+  }
+  
+  // Window lost or the server stalled - ask again from the current offset
+  if (now - _otaRequestedAt < VWIRE_OTA_CHUNK_TIMEOUT) return;
+  if (++_otaRetries > VWIRE_OTA_MAX_RETRIES) {
+    _debugPrint("[Vwire] OTA timed out");
+    _failOta("timeout");
+    return;
+  }
+  _debugPrintf("[Vwire] OTA retry %d from offset %lu", _otaRetries, (unsigned long)_ota.received());
+  _requestOtaWindow();
+}
+
 // =============================================================================
 // HELPERS
 // =============================================================================
-String VwireClass::_buildTopic(const char* type, int pin) {
-  String topic = "vwire/";
-  topic += _deviceId;
-  topic += "/";
-  topic += type;
+size_t VwireClass::_buildTopic(char* out, const char* type, int pin) {
+  // "vwire/<deviceId>/" is formatted once by config(), so a topic is two
+  // short copies plus at most three digits - no printf per publish
+  size_t len = _topicPrefixLen;
+  memcpy(out, _topicPrefix, len);
+  size_t typeLen = strlen(type);
+  if (len + typeLen + 6 > VWIRE_MAX_TOPIC_LENGTH) typeLen = VWIRE_MAX_TOPIC_LENGTH - 6 - len;
+  memcpy(out + len, type, typeLen);
+  len += typeLen;
   
   if (pin >= 0) {
-    topic += "/";
-    topic += String(pin);
+    out[len++] = '/';
+    out[len++] = 'V';
+    if (pin >= 100) out[len++] = '0' + (pin / 100) % 10;
+    if (pin >= 10) out[len++] = '0' + (pin / 10) % 10;
+    out[len++] = '0' + pin % 10;
   }
-  
-  return topic;
+  out[len] = '\0';
+  return len;
 }
 
 void VwireClass::_sendHeartbeat() {
   if (!connected()) return;
   
   // Use stack buffers to avoid heap allocation
-  char topic[96];
-  char buffer[96];
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  char head[64];
+  
+  if (_binaryActive && !_heartbeatStats) {
+    // [0x12][uptime][heap][rssi] - 10 bytes instead of ~45
+    uint8_t frame[10];
+    frame[0] = VWIRE_FRAME_HEARTBEAT;
+    _vwirePut32(frame + 1, getUptime());
+    _vwirePut32(frame + 5, getFreeHeap());
+    frame[9] = (uint8_t)(int8_t)getWiFiRSSI();
+    _publishFrame(frame, sizeof(frame), false);
+    return;
+  }
   
-  snprintf(topic, sizeof(topic), "vwire/%s/heartbeat", _deviceId);
-  snprintf(buffer, sizeof(buffer), "{\"uptime\":%lu,\"heap\":%lu,\"rssi\":%d}",
-           getUptime(), getFreeHeap(), getWiFiRSSI());
+  _buildTopic(topic, "heartbeat");
+  int headLen = snprintf(head, sizeof(head), "{\"uptime\":%lu,\"heap\":%lu,\"rssi\":%d",
+                         (unsigned long)getUptime(), (unsigned long)getFreeHeap(), getWiFiRSSI());
+  if (headLen < 0 || (size_t)headLen >= sizeof(head)) return;
   
-  _mqttClient.publish(topic, buffer);
+  // Streamed in parts - the stats object is formatted into scratch (or a
+  // one-off heap block when scratch is short), not onto the stack
+  static const char key[] = ",\"stats\":";
+  const char* stats = nullptr;
+  size_t statsLen = 0;
+  #if VWIRE_ENABLE_STATS
+  size_t scratchMark = _scratchUsed;
+  char* statsBuffer = nullptr;
+  bool heap = false;
+  if (_heartbeatStats) {
+    statsBuffer = _scratchAlloc(VWIRE_STATS_JSON_LENGTH);
+    heap = !statsBuffer;
+    if (heap) statsBuffer = (char*)malloc(VWIRE_STATS_JSON_LENGTH);
+    if (statsBuffer) statsLen = _formatStats(statsBuffer, VWIRE_STATS_JSON_LENGTH);
+    stats = statsBuffer;
+  }
+  #endif
+  
+  size_t len = headLen + (statsLen ? sizeof(key) - 1 + statsLen : 0) + 1;
+  _beginPublish(topic, len, false);
+  _mqtt->write((const uint8_t*)head, headLen);
+  if (statsLen) {
+    _mqtt->write((const uint8_t*)key, sizeof(key) - 1);
+    _mqtt->write((const uint8_t*)stats, statsLen);
+  }
+  _mqtt->write((const uint8_t*)"}", 1);
+  _endPublish();
+  
+  #if VWIRE_ENABLE_STATS
+  if (heap) free(statsBuffer);
+  _scratchUsed = scratchMark;
+  #endif
 }
 
 void VwireClass::_setError(VwireError error) {
   _lastError = error;
+  #if VWIRE_ENABLE_STATS
+  // Both are only ever raised by a send that was dropped
+  if (error == VWIRE_ERR_NOT_CONNECTED) _stats.dropsNotConnected++;
+  else if (error == VWIRE_ERR_QUEUE_FULL) _stats.dropsQueueFull++;
+  #endif
+}
+
+unsigned long VwireClass::_backoffDelay(const VwireBackoff& policy, unsigned long base, uint8_t attempt) {
+  // base * factor^attempt, capped at maxDelay
+  unsigned long delayMs = base;
+  if (policy.factor > 1) {
+    for (uint8_t i = 0; i < attempt && delayMs < policy.maxDelay; i++) {
+      delayMs = (delayMs > policy.maxDelay / policy.factor) ? policy.maxDelay : delayMs * policy.factor;
+    }
+    if (policy.maxDelay && delayMs > policy.maxDelay) delayMs = policy.maxDelay;
+  }
+  
+  if (policy.jitterPercent == 0 || delayMs == 0) return delayMs;
+  
+  // Library-private xorshift32, seeded per device so boards don't share a sequence
+  if (_jitterState == 0) {
+    _jitterState = _vwireHash(_deviceId) ^ micros();
+    if (_jitterState == 0) _jitterState = 0x9E3779B9UL;
+  }
+  _jitterState ^= _jitterState << 13;
+  _jitterState ^= _jitterState >> 17;
+  _jitterState ^= _jitterState << 5;
+  
+  // Spread uniformly over delay +/- jitterPercent
+  unsigned long spread = delayMs / 100 * policy.jitterPercent + (delayMs % 100) * policy.jitterPercent / 100;
+  unsigned long offset = spread ? _jitterState % (2 * spread + 1) : 0;
+  return delayMs - spread + offset;
 }
 
 // =============================================================================
@@ -758,64 +3812,217 @@ void VwireClass::printDebugInfo() {
 // RELIABLE DELIVERY
 // =============================================================================
 uint8_t VwireClass::getPendingCount() {
-  uint8_t count = 0;
-  for (int i = 0; i < VWIRE_MAX_PENDING_MESSAGES; i++) {
-    if (_pendingMessages[i].active) count++;
-  }
-  return count;
+  return _pendingCount;
 }
 
 bool VwireClass::isDeliveryPending() {
-  return getPendingCount() > 0;
+  return _pendingCount > 0;
 }
 
-int VwireClass::_findPendingSlot() {
-  for (int i = 0; i < VWIRE_MAX_PENDING_MESSAGES; i++) {
-    if (!_pendingMessages[i].active) return i;
+uint32_t VwireClass::_indexKey(const uint8_t* index, uint8_t slot) {
+  const PendingMessage& msg = _pendingMessages[slot];
+  return (index == _packetIndex) ? msg.packetId : msg.msgId;
+}
+
+int VwireClass::_findIndexed(const uint8_t* index, uint32_t key) {
+  // The index is never more than half full, so an empty bucket ends the probe
+  uint16_t i = key % VWIRE_PENDING_INDEX_SIZE;
+  while (index[i] != VWIRE_PENDING_NONE) {
+    if (_indexKey(index, index[i]) == key) return index[i];
+    i = (i + 1) % VWIRE_PENDING_INDEX_SIZE;
   }
-  return -1;  // Queue full
+  return -1;
 }
 
-void VwireClass::_removePending(const char* msgId) {
-  for (int i = 0; i < VWIRE_MAX_PENDING_MESSAGES; i++) {
-    if (_pendingMessages[i].active && strcmp(_pendingMessages[i].msgId, msgId) == 0) {
-      _pendingMessages[i].active = false;
-      _debugPrintf("[Vwire] Removed pending message: %s", msgId);
-      return;
+int VwireClass::_findPending(uint32_t msgId) {
+  return _findIndexed(_pendingIndex, msgId);
+}
+
+void VwireClass::_indexPending(uint8_t* index, uint8_t slot) {
+  uint16_t i = _indexKey(index, slot) % VWIRE_PENDING_INDEX_SIZE;
+  while (index[i] != VWIRE_PENDING_NONE) i = (i + 1) % VWIRE_PENDING_INDEX_SIZE;
+  index[i] = slot;
+}
+
+void VwireClass::_unindexPending(uint8_t* index, uint8_t slot) {
+  uint16_t hole = _indexKey(index, slot) % VWIRE_PENDING_INDEX_SIZE;
+  while (index[hole] != slot) hole = (hole + 1) % VWIRE_PENDING_INDEX_SIZE;
+  index[hole] = VWIRE_PENDING_NONE;
+  
+  // Backward-shift deletion: pull later entries of the probe run into the
+  // hole unless their home bucket lies after it - no tombstones needed
+  uint16_t i = hole;
+  for (;;) {
+    i = (i + 1) % VWIRE_PENDING_INDEX_SIZE;
+    uint8_t entry = index[i];
+    if (entry == VWIRE_PENDING_NONE) return;
+    uint16_t home = _indexKey(index, entry) % VWIRE_PENDING_INDEX_SIZE;
+    bool stays = (hole <= i) ? (hole < home && home <= i) : (hole < home || home <= i);
+    if (stays) continue;
+    index[hole] = entry;
+    index[i] = VWIRE_PENDING_NONE;
+    hole = i;
+  }
+}
+
+void VwireClass::_linkPending(uint8_t slot) {
+  PendingMessage& msg = _pendingMessages[slot];
+  
+  // Walk back from the tail - new deadlines are almost always the latest
+  uint8_t after = _pendingTail;
+  while (after != VWIRE_PENDING_NONE &&
+         (long)(_pendingMessages[after].dueAt - msg.dueAt) > 0) {
+    after = _pendingMessages[after].prev;
+  }
+  
+  msg.prev = after;
+  msg.next = (after != VWIRE_PENDING_NONE) ? _pendingMessages[after].next : _pendingHead;
+  if (after != VWIRE_PENDING_NONE) _pendingMessages[after].next = slot;
+  else _pendingHead = slot;
+  if (msg.next != VWIRE_PENDING_NONE) _pendingMessages[msg.next].prev = slot;
+  else _pendingTail = slot;
+}
+
+void VwireClass::_unlinkPending(uint8_t slot) {
+  PendingMessage& msg = _pendingMessages[slot];
+  if (msg.prev != VWIRE_PENDING_NONE) _pendingMessages[msg.prev].next = msg.next;
+  else _pendingHead = msg.next;
+  if (msg.next != VWIRE_PENDING_NONE) _pendingMessages[msg.next].prev = msg.prev;
+  else _pendingTail = msg.prev;
+}
+
+void VwireClass::_removePending(uint8_t slot) {
+  _unlinkPending(slot);
+  _unindexPending(_pendingIndex, slot);
+  if (_pendingMessages[slot].packetId) _unindexPending(_packetIndex, slot);
+  else _pendingUnsent--;
+  _pendingMessages[slot].active = false;
+  _pendingMessages[slot].next = _pendingFree;
+  _pendingFree = slot;
+  _pendingCount--;
+}
+
+void VwireClass::_notifyDelivery(uint32_t msgId, bool success) {
+  if (_deliveryCallback) {
+    char idStr[12];
+    snprintf(idStr, sizeof(idStr), "%lu", (unsigned long)msgId);
+    _deliveryCallback(idStr, success);
+  }
+}
+
+void VwireClass::_handleAck(uint32_t msgId, bool success) {
+  _debugPrintf("[Vwire] ACK received: %lu = %s", (unsigned long)msgId, success ? "OK" : "FAIL");
+  
+  int slot = _findPending(msgId);
+  if (slot < 0) {
+    // Message not in pending store (might be duplicate ACK)
+    _debugPrintf("[Vwire] ACK for unknown message: %lu (possibly duplicate)", (unsigned long)msgId);
+    return;
+  }
+  
+  _removePending(slot);
+  _notifyDelivery(msgId, success);
+  
+  if (success) {
+    _debugPrintf("[Vwire] ✓ Message %lu delivered successfully", (unsigned long)msgId);
+  } else {
+    _debugPrintf("[Vwire] ✗ Message %lu delivery failed (server NACK)", (unsigned long)msgId);
+  }
+}
+
+void VwireClass::_handleCumulativeAck(uint32_t upTo, uint32_t mask) {
+  _debugPrintf("[Vwire] Cumulative ACK: up to %lu, mask 0x%lx", (unsigned long)upTo, (unsigned long)mask);
+  
+  // Walk the pending list once; IDs are sequential so "<= upTo" is a
+  // wrap-safe signed distance check
+  uint8_t slot = _pendingHead;
+  while (slot != VWIRE_PENDING_NONE) {
+    uint8_t next = _pendingMessages[slot].next;
+    uint32_t msgId = _pendingMessages[slot].msgId;
+    int32_t ahead = (int32_t)(msgId - upTo);
+    
+    if (ahead <= 0 || (ahead <= 32 && (mask & (1UL << (ahead - 1))))) {
+      _removePending(slot);
+      _notifyDelivery(msgId, true);
     }
+    slot = next;
   }
 }
 
-void VwireClass::_handleAck(const char* msgId, bool success) {
-  _debugPrintf("[Vwire] ACK received: %s = %s", msgId, success ? "OK" : "FAIL");
+bool VwireClass::_publishPending(uint8_t slot) {
+  PendingMessage& msg = _pendingMessages[slot];
+  size_t valueLen = strnlen(msg.value, sizeof(msg.value));
   
-  // Find the pending message
-  for (int i = 0; i < VWIRE_MAX_PENDING_MESSAGES; i++) {
-    if (_pendingMessages[i].active && strcmp(_pendingMessages[i].msgId, msgId) == 0) {
-      _pendingMessages[i].active = false;
-      
-      // Call delivery callback if set
-      if (_deliveryCallback) {
-        _deliveryCallback(msgId, success);
-      }
-      
-      if (success) {
-        _debugPrintf("[Vwire] ✓ Message %s delivered successfully", msgId);
-      } else {
-        _debugPrintf("[Vwire] ✗ Message %s delivery failed (server NACK)", msgId);
-      }
-      return;
+  if (_mqtt->supportsQos1()) {
+    // A plain pin message at QoS 1 - the broker's PUBACK is the ACK
+    char topic[VWIRE_MAX_TOPIC_LENGTH];
+    uint8_t frame[2 + 2 + sizeof(msg.value)];
+    const uint8_t* payload = (const uint8_t*)msg.value;
+    size_t len = valueLen;
+    if (_binaryActive) {
+      frame[0] = VWIRE_FRAME_PINS;
+      frame[1] = msg.pin;
+      len = 2 + VwireTlv::encodeText(frame + 2, msg.value, valueLen);
+      payload = frame;
+      _buildTopic(topic, "bin");
+    } else {
+      _buildTopic(topic, "pin", msg.pin);
+    }
+    
+    uint16_t packetId = _mqtt->beginPublishQos1(topic, len, _settings.dataRetain, msg.packetId);
+    if (!packetId) return false;  // Inflight window full - sent once a PUBACK opens it
+    _countPublish(topic, len);
+    _mqtt->write(payload, len);
+    _endPublish();
+    if (packetId != msg.packetId) {
+      if (msg.packetId) _unindexPending(_packetIndex, slot);
+      else _pendingUnsent--;
+      msg.packetId = packetId;
+      _indexPending(_packetIndex, slot);
     }
+    return true;
   }
   
-  // Message not found in pending queue (might be duplicate ACK)
-  _debugPrintf("[Vwire] ACK for unknown message: %s (possibly duplicate)", msgId);
+  if (_binaryActive) {
+    // [0x11][msgId][pin][text tlv]
+    uint8_t frame[1 + 4 + 1 + 2 + sizeof(msg.value)];
+    frame[0] = VWIRE_FRAME_RELIABLE;
+    _vwirePut32(frame + 1, msg.msgId);
+    frame[5] = msg.pin;
+    size_t len = 6 + VwireTlv::encodeText(frame + 6, msg.value, valueLen);
+    _publishFrame(frame, len, false);
+    return true;
+  }
+  
+  // Build payload with msgId: {"msgId":"123","pin":"V0","value":"42"}
+  // or, for cumulative ACKs, a numeric sequence: {"seq":123,"pin":"V0","value":"42"}
+  // Streamed in three parts - no payload buffer
+  char head[48];
+  int headLen = snprintf(head, sizeof(head),
+                         (_settings.ackMode == VWIRE_ACK_CUMULATIVE)
+                           ? "{\"seq\":%lu,\"pin\":\"V%d\",\"value\":\""
+                           : "{\"msgId\":\"%lu\",\"pin\":\"V%d\",\"value\":\"",
+                         (unsigned long)msg.msgId, msg.pin);
+  
+  // Use /data topic for reliable messages (server will ACK these)
+  char topic[VWIRE_MAX_TOPIC_LENGTH];
+  _buildTopic(topic, "data");
+  
+  _beginPublish(topic, headLen + valueLen + 2, false);
+  _mqtt->write((const uint8_t*)head, headLen);
+  _mqtt->write((const uint8_t*)msg.value, valueLen);
+  _mqtt->write((const uint8_t*)"\"}", 2);
+  _endPublish();
+  return true;
 }
 
-void VwireClass::_sendWithReliableDelivery(uint8_t pin, const String& value) {
-  // Find empty slot in pending queue
-  int slot = _findPendingSlot();
-  if (slot < 0) {
+void VwireClass::_sendWithReliableDelivery(uint8_t pin, const char* value) {
+  // Full only when every slot waits for an ACK
+  uint32_t msgId = _msgIdCounter + 1;
+  if (msgId == 0) msgId = 1;  // 0 is never a valid ID
+  uint8_t slot = _pendingFree;
+  
+  if (slot == VWIRE_PENDING_NONE) {
     _setError(VWIRE_ERR_QUEUE_FULL);
     _debugPrint("[Vwire] Error: Reliable delivery queue full!");
     
@@ -826,79 +4033,112 @@ void VwireClass::_sendWithReliableDelivery(uint8_t pin, const String& value) {
     return;
   }
   
-  // Generate unique message ID: deviceId_counter_millis
-  _msgIdCounter++;
-  snprintf(_pendingMessages[slot].msgId, sizeof(_pendingMessages[slot].msgId),
-           "%04X_%lu", (uint16_t)(_msgIdCounter & 0xFFFF), millis() % 10000);
-  
-  _pendingMessages[slot].pin = pin;
-  strncpy(_pendingMessages[slot].value, value.c_str(), sizeof(_pendingMessages[slot].value) - 1);
-  _pendingMessages[slot].value[sizeof(_pendingMessages[slot].value) - 1] = '\0';
-  _pendingMessages[slot].sentAt = millis();
-  _pendingMessages[slot].retries = 0;
-  _pendingMessages[slot].active = true;
-  
-  // Build payload with msgId: {"msgId":"xxx","pin":"V0","value":"123"}
-  char payload[VWIRE_JSON_BUFFER_SIZE];
-  snprintf(payload, sizeof(payload), 
-           "{\"msgId\":\"%s\",\"pin\":\"V%d\",\"value\":\"%s\"}",
-           _pendingMessages[slot].msgId, pin, _pendingMessages[slot].value);
-  
-  // Use /data topic for reliable messages (server will ACK these)
-  char topic[96];
-  snprintf(topic, sizeof(topic), "vwire/%s/data", _deviceId);
+  _msgIdCounter = msgId;
+  PendingMessage& msg = _pendingMessages[slot];
+  _pendingFree = msg.next;
+  msg.msgId = msgId;
+  msg.pin = pin;
+  strncpy(msg.value, value, sizeof(msg.value) - 1);
+  msg.value[sizeof(msg.value) - 1] = '\0';
+  msg.dueAt = millis() + _settings.ackTimeout;
+  msg.retries = 0;
+  msg.packetId = 0;
+  msg.active = true;
+  _pendingCount++;
+  _pendingUnsent++;
+  _linkPending(slot);
+  _indexPending(_pendingIndex, slot);
   
-  unsigned int len = strlen(payload);
-  _mqttClient.beginPublish(topic, len, false);
-  _mqttClient.print(payload);
-  _mqttClient.endPublish();
+  _publishPending(slot);
   
-  _debugPrintf("[Vwire] Reliable write V%d = %s (msgId: %s)", 
-               pin, value.c_str(), _pendingMessages[slot].msgId);
+  _debugPrintf("[Vwire] Reliable write V%d = %s (msgId: %lu)", 
+               pin, value, (unsigned long)msgId);
 }
 
 void VwireClass::_processRetries() {
   unsigned long now = millis();
   
-  for (int i = 0; i < VWIRE_MAX_PENDING_MESSAGES; i++) {
-    if (!_pendingMessages[i].active) continue;
+  // Messages are linked by next due time - stop at the first one not yet due.
+  // Each message is visited at most once per call.
+  for (uint8_t visits = _pendingCount; visits > 0 && _pendingHead != VWIRE_PENDING_NONE; visits--) {
+    uint8_t slot = _pendingHead;
+    PendingMessage& msg = _pendingMessages[slot];
     
     // Check if ACK timeout has passed
-    if (now - _pendingMessages[i].sentAt >= _settings.ackTimeout) {
-      if (_pendingMessages[i].retries < _settings.maxRetries) {
-        // Retry
-        _pendingMessages[i].retries++;
-        _pendingMessages[i].sentAt = now;
-        
-        // Rebuild and resend payload
-        char payload[VWIRE_JSON_BUFFER_SIZE];
-        snprintf(payload, sizeof(payload), 
-                 "{\"msgId\":\"%s\",\"pin\":\"V%d\",\"value\":\"%s\"}",
-                 _pendingMessages[i].msgId, _pendingMessages[i].pin, _pendingMessages[i].value);
-        
-        char topic[96];
-        snprintf(topic, sizeof(topic), "vwire/%s/data", _deviceId);
-        
-        unsigned int len = strlen(payload);
-        _mqttClient.beginPublish(topic, len, false);
-        _mqttClient.print(payload);
-        _mqttClient.endPublish();
-        
-        _debugPrintf("[Vwire] ↻ Retry %d/%d for message %s", 
-                     _pendingMessages[i].retries, _settings.maxRetries,
-                     _pendingMessages[i].msgId);
-      } else {
-        // Max retries exceeded - give up
-        _debugPrintf("[Vwire] ✗ Message %s dropped after %d retries", 
-                     _pendingMessages[i].msgId, _settings.maxRetries);
-        
-        // Call delivery callback with failure
-        if (_deliveryCallback) {
-          _deliveryCallback(_pendingMessages[i].msgId, false);
-        }
-        
-        _pendingMessages[i].active = false;
+    if ((long)(now - msg.dueAt) < 0) break;
+    
+    // Held back by a full inflight window - that attempt was never made
+    bool sent = msg.packetId || !_mqtt->supportsQos1();
+    
+    if (!sent || msg.retries < _settings.maxRetries) {
+      // Retry - wait ackTimeout * factor^retries (+/- jitter) for the next ACK
+      if (sent) {
+        msg.retries++;
+        #if VWIRE_ENABLE_STATS
+        _stats.retries++;
+        #endif
       }
+      msg.dueAt = now + _backoffDelay(_settings.retryBackoff, _settings.ackTimeout, msg.retries);
+      _unlinkPending(slot);
+      _linkPending(slot);
+      
+      _publishPending(slot);
+      
+      _debugPrintf("[Vwire] ↻ Retry %d/%d for message %lu", 
+                   msg.retries, _settings.maxRetries, (unsigned long)msg.msgId);
+    } else {
+      // Max retries exceeded - give up
+      _debugPrintf("[Vwire] ✗ Message %lu dropped after %d retries", 
+                   (unsigned long)msg.msgId, _settings.maxRetries);
+      
+      if (msg.packetId) _mqtt->releasePacket(msg.packetId);
+      _removePending(slot);
+      _notifyDelivery(msg.msgId, false);
     }
   }
-}
\ No newline at end of file
+}
+
+void VwireClass::_mqttAckWrapper(void* context, uint16_t packetId) {
+  // Packet IDs come from the shared client, so they are unique across devices
+  VwireClass* self = (VwireClass*)context;
+  bool found = self->_handlePacketAck(packetId);
+  for (uint8_t i = 0; !found && i < self->_attachedCount; i++) {
+    found = self->_attached[i]->_handlePacketAck(packetId);
+  }
+  
+  // Any PUBACK - tracked or from a data publish - frees a place in the
+  // window, so the oldest message it held back goes out now
+  if (self->_sendHeldBack()) return;
+  for (uint8_t i = 0; i < self->_attachedCount; i++) {
+    if (self->_attached[i]->_sendHeldBack()) return;
+  }
+}
+
+bool VwireClass::_handlePacketAck(uint16_t packetId) {
+  int slot = _findIndexed(_packetIndex, packetId);
+  if (slot < 0) return false;
+  
+  uint32_t msgId = _pendingMessages[slot].msgId;
+  _debugPrintf("[Vwire] PUBACK for message %lu", (unsigned long)msgId);
+  _removePending(slot);
+  _notifyDelivery(msgId, true);
+  return true;
+}
+
+bool VwireClass::_sendHeldBack() {
+  if (!_pendingUnsent || !_mqtt->supportsQos1()) return false;
+  for (uint8_t slot = _pendingHead; slot != VWIRE_PENDING_NONE; slot = _pendingMessages[slot].next) {
+    if (!_pendingMessages[slot].packetId) return _publishPending(slot);
+  }
+  return false;
+}
+
+bool VwireClass::_reliableWaiting() {
+  // The inflight window is shared by the owner and its attached devices
+  const VwireClass& root = _owner ? *_owner : *this;
+  if (root._pendingUnsent) return true;
+  for (uint8_t i = 0; i < root._attachedCount; i++) {
+    if (root._attached[i]->_pendingUnsent) return true;
+  }
+  return false;
+}
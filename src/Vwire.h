@@ -23,6 +23,10 @@
 #include <Arduino.h>
 #include "VwireConfig.h"
 #include "VwireTimer.h"
+#include "VwireOfflineLog.h"
+#include "VwireRing.h"
+#include "VwireStats.h"
+#include "VwireOta.h"
 
 // =============================================================================
 // PLATFORM-SPECIFIC INCLUDES
@@ -54,9 +58,14 @@
   #include <WiFiClient.h>
 #endif
 
-#include <PubSubClient.h>
+#include "VwireMqttClient.h"
 #include <ArduinoJson.h>
 
+#if VWIRE_HAS_NET_TASK
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/task.h>
+#endif
+
 // =============================================================================
 // VIRTUAL PIN CLASS
 // =============================================================================
@@ -66,6 +75,11 @@
  * 
  * VirtualPin wraps string values with convenient type conversion methods.
  * Supports integers, floats, booleans, strings, and comma-separated arrays.
+ * 
+ * Numbers and short strings are stored in a small inline buffer, so building
+ * a VirtualPin for virtualSend() does not touch the heap. Values received
+ * from the server are passed to handlers as a view over the receive buffer
+ * (no copy); copying a VirtualPin always produces an independent value.
  */
 class VirtualPin {
 public:
@@ -74,87 +88,124 @@ public:
   // =========================================================================
   
   /** @brief Default constructor - creates empty value */
-  VirtualPin() : _value("") {}
+  VirtualPin() : _data(_buf), _len(0), _heap(nullptr) { _buf[0] = '\0'; }
   
   /** @brief Construct from String */
-  VirtualPin(const String& value) : _value(value) {}
+  VirtualPin(const String& value) : _heap(nullptr) { _assign(value.c_str(), value.length()); }
   
   /** @brief Construct from C-string */
-  VirtualPin(const char* value) : _value(value) {}
+  VirtualPin(const char* value) : _heap(nullptr) { _assign(value, value ? strlen(value) : 0); }
   
   /** @brief Construct from integer */
-  VirtualPin(int value) : _value(String(value)) {}
+  VirtualPin(int value) : _heap(nullptr) { _formatSigned(value); }
   
   /** @brief Construct from long */
-  VirtualPin(long value) : _value(String(value)) {}
+  VirtualPin(long value) : _heap(nullptr) { _formatSigned(value); }
   
   /** @brief Construct from unsigned integer */
-  VirtualPin(unsigned int value) : _value(String(value)) {}
+  VirtualPin(unsigned int value) : _heap(nullptr) { _formatUnsigned(value); }
   
   /** @brief Construct from unsigned long */
-  VirtualPin(unsigned long value) : _value(String(value)) {}
+  VirtualPin(unsigned long value) : _heap(nullptr) { _formatUnsigned(value); }
   
   /** @brief Construct from float (2 decimal places) */
-  VirtualPin(float value) : _value(String(value, 2)) {}
+  VirtualPin(float value) : _heap(nullptr) { _formatFloat(value, 2); }
   
   /** @brief Construct from double (4 decimal places) */
-  VirtualPin(double value) : _value(String(value, 4)) {}
+  VirtualPin(double value) : _heap(nullptr) { _formatFloat(value, 4); }
   
   /** @brief Construct from boolean */
-  VirtualPin(bool value) : _value(value ? "1" : "0") {}
+  VirtualPin(bool value) : _heap(nullptr) { _assign(value ? "1" : "0", 1); }
+  
+  /** @brief Copy constructor - the copy owns its value */
+  VirtualPin(const VirtualPin& other) : _heap(nullptr) { _assign(other._data, other._len); }
+  
+  /** @brief Copy assignment - the copy owns its value */
+  VirtualPin& operator=(const VirtualPin& other) {
+    if (this != &other) set(other._data, other._len);
+    return *this;
+  }
+  
+  ~VirtualPin() { _release(); }
   
   // =========================================================================
   // SETTERS
   // =========================================================================
   
   /** @brief Set value from String */
-  void set(const String& value) { _value = value; }
+  void set(const String& value) { set(value.c_str(), value.length()); }
   
   /** @brief Set value from C-string */
-  void set(const char* value) { _value = String(value); }
+  void set(const char* value) { set(value, value ? strlen(value) : 0); }
+  
+  /** @brief Set value from character buffer (copied) */
+  void set(const char* value, size_t length) {
+    // Copy first - value may point into our own storage
+    char* oldHeap = _heap;
+    _heap = nullptr;
+    _assign(value, length);
+    free(oldHeap);
+  }
   
   /** @brief Set value from integer */
-  void set(int value) { _value = String(value); }
+  void set(int value) { _release(); _formatSigned(value); }
   
   /** @brief Set value from long */
-  void set(long value) { _value = String(value); }
+  void set(long value) { _release(); _formatSigned(value); }
   
   /** @brief Set value from unsigned integer */
-  void set(unsigned int value) { _value = String(value); }
+  void set(unsigned int value) { _release(); _formatUnsigned(value); }
   
   /** @brief Set value from unsigned long */
-  void set(unsigned long value) { _value = String(value); }
+  void set(unsigned long value) { _release(); _formatUnsigned(value); }
   
   /** @brief Set value from float (2 decimal places) */
-  void set(float value) { _value = String(value, 2); }
+  void set(float value) { _release(); _formatFloat(value, 2); }
   
   /** @brief Set value from double (4 decimal places) */
-  void set(double value) { _value = String(value, 4); }
+  void set(double value) { _release(); _formatFloat(value, 4); }
   
   /** @brief Set value from boolean */
-  void set(bool value) { _value = value ? "1" : "0"; }
+  void set(bool value) { set(value ? "1" : "0", 1); }
+  
+  /**
+   * @brief Point at an external NUL-terminated buffer without copying
+   * @param data Buffer holding the value (must stay valid while in use)
+   * @param length Value length excluding the terminator
+   * @note Used for inbound commands; the view is only valid inside the handler
+   */
+  void setView(const char* data, size_t length) {
+    _release();
+    _data = data;
+    _len = length;
+  }
   
   // =========================================================================
   // GETTERS
   // =========================================================================
   
   /** @brief Get value as integer */
-  int asInt() const { return _value.toInt(); }
+  int asInt() const { return (int)atol(_data); }
   
   /** @brief Get value as float */
-  float asFloat() const { return _value.toFloat(); }
+  float asFloat() const { return (float)atof(_data); }
   
   /** @brief Get value as double */
-  double asDouble() const { return _value.toDouble(); }
+  double asDouble() const { return atof(_data); }
   
   /** @brief Get value as boolean (true for "1", "true", "on") */
-  bool asBool() const { return _value == "1" || _value.equalsIgnoreCase("true") || _value.equalsIgnoreCase("on"); }
+  bool asBool() const {
+    return strcmp(_data, "1") == 0 || strcasecmp(_data, "true") == 0 || strcasecmp(_data, "on") == 0;
+  }
   
-  /** @brief Get value as String */
-  String asString() const { return _value; }
+  /** @brief Get value as String (allocates - prefer asCString() in hot paths) */
+  String asString() const { return String(_data); }
   
   /** @brief Get value as C-string */
-  const char* asCString() const { return _value.c_str(); }
+  const char* asCString() const { return _data; }
+  
+  /** @brief Get value length in characters */
+  size_t length() const { return _len; }
   
   // =========================================================================
   // ARRAY SUPPORT (comma-separated values)
@@ -165,10 +216,10 @@ public:
    * @return Element count (1 for non-array values)
    */
   int getArraySize() const {
-    if (_value.length() == 0) return 0;
+    if (_len == 0) return 0;
     int count = 1;
-    for (size_t i = 0; i < _value.length(); i++) {
-      if (_value.charAt(i) == ',') count++;
+    for (size_t i = 0; i < _len; i++) {
+      if (_data[i] == ',') count++;
     }
     return count;
   }
@@ -178,14 +229,20 @@ public:
    * @param index Zero-based element index
    * @return Element value as int, 0 if index out of range
    */
-  int getArrayInt(int index) const { return getArrayElement(index).toInt(); }
+  int getArrayInt(int index) const {
+    const char* element = _findElement(index, nullptr);
+    return element ? (int)atol(element) : 0;
+  }
   
   /**
    * @brief Get array element as float
    * @param index Zero-based element index
    * @return Element value as float, 0.0 if index out of range
    */
-  float getArrayFloat(int index) const { return getArrayElement(index).toFloat(); }
+  float getArrayFloat(int index) const {
+    const char* element = _findElement(index, nullptr);
+    return element ? (float)atof(element) : 0.0f;
+  }
   
   /**
    * @brief Get array element as string
@@ -193,18 +250,57 @@ public:
    * @return Element value as String, empty if index out of range
    */
   String getArrayElement(int index) const {
-    int start = 0;
+    size_t elementLen = 0;
+    const char* element = _findElement(index, &elementLen);
+    if (!element) return "";
+    String result;
+    result.reserve(elementLen);
+    for (size_t i = 0; i < elementLen; i++) result += element[i];
+    return result;
+  }
+  
+  /**
+   * @brief Parse all array elements as integers in a single pass
+   * @param out Destination array
+   * @param maxCount Capacity of out
+   * @return Number of elements written (at most maxCount)
+   * @code
+   * int rgb[3];
+   * if (param.parseArray(rgb, 3) == 3) setColor(rgb[0], rgb[1], rgb[2]);
+   * @endcode
+   */
+  int parseArray(int* out, int maxCount) const {
+    if (!out || maxCount <= 0 || _len == 0) return 0;
     int count = 0;
-    for (size_t i = 0; i <= _value.length(); i++) {
-      if (i == _value.length() || _value.charAt(i) == ',') {
-        if (count == index) {
-          return _value.substring(start, i);
-        }
-        count++;
-        start = i + 1;
-      }
+    const char* p = _data;
+    while (count < maxCount) {
+      char* next;
+      out[count++] = (int)strtol(p, &next, 10);
+      p = strchr(next, ',');        // Skip any trailing junk (e.g. "1.5")
+      if (!p) break;
+      p++;
     }
-    return "";
+    return count;
+  }
+  
+  /**
+   * @brief Parse all array elements as floats in a single pass
+   * @param out Destination array
+   * @param maxCount Capacity of out
+   * @return Number of elements written (at most maxCount)
+   */
+  int parseArray(float* out, int maxCount) const {
+    if (!out || maxCount <= 0 || _len == 0) return 0;
+    int count = 0;
+    const char* p = _data;
+    while (count < maxCount) {
+      char* next;
+      out[count++] = (float)strtod(p, &next);
+      p = strchr(next, ',');
+      if (!p) break;
+      p++;
+    }
+    return count;
   }
   
   // =========================================================================
@@ -221,16 +317,175 @@ public:
   operator bool() const { return asBool(); }
   
   /** @brief Implicit conversion to String */
-  operator String() const { return _value; }
+  operator String() const { return asString(); }
+  
+  // =========================================================================
+  // FORMATTING
+  // =========================================================================
+  
+  /**
+   * @brief Format a floating point value without printf float support
+   * @param out Destination buffer
+   * @param size Destination size
+   * @param value Value to format
+   * @param decimals Digits after the decimal point
+   * @return Number of characters written (excluding terminator)
+   * @note Portable replacement for String(value, decimals) / dtostrf()
+   */
+  static size_t formatFloat(char* out, size_t size, double value, uint8_t decimals);
+  
+private:
+  const char* _data;                      ///< Current value (NUL-terminated)
+  size_t _len;                            ///< Value length
+  char* _heap;                            ///< Owned storage for values too long for _buf
+  char _buf[VWIRE_VPIN_BUFFER_SIZE];      ///< Inline storage for numbers and short strings
+  
+  /** @brief Copy a value into inline storage, or the heap if it does not fit */
+  void _assign(const char* value, size_t length) {
+    if (!value) length = 0;
+    char* dest = _buf;
+    if (length >= sizeof(_buf)) {
+      _heap = (char*)malloc(length + 1);
+      if (_heap) {
+        dest = _heap;
+      } else {
+        length = sizeof(_buf) - 1;  // Out of memory - keep a truncated copy
+      }
+    }
+    if (length) memmove(dest, value, length);
+    dest[length] = '\0';
+    _data = dest;
+    _len = length;
+  }
+  
+  void _release() {
+    free(_heap);
+    _heap = nullptr;
+    _data = _buf;
+    _len = 0;
+    _buf[0] = '\0';
+  }
+  
+  void _formatSigned(long value) {
+    int n = snprintf(_buf, sizeof(_buf), "%ld", value);
+    _data = _buf;
+    _len = (n > 0) ? (size_t)n : 0;
+  }
+  
+  void _formatUnsigned(unsigned long value) {
+    int n = snprintf(_buf, sizeof(_buf), "%lu", value);
+    _data = _buf;
+    _len = (n > 0) ? (size_t)n : 0;
+  }
+  
+  void _formatFloat(double value, uint8_t decimals) {
+    _len = formatFloat(_buf, sizeof(_buf), value, decimals);
+    _data = _buf;
+  }
+  
+  /** @brief Locate array element (returns nullptr if out of range) */
+  const char* _findElement(int index, size_t* elementLen) const {
+    if (index < 0 || _len == 0) return nullptr;
+    const char* start = _data;
+    const char* end = _data + _len;
+    for (const char* p = _data; p <= end; p++) {
+      if (p == end || *p == ',') {
+        if (index-- == 0) {
+          if (elementLen) *elementLen = p - start;
+          return start;
+        }
+        start = p + 1;
+      }
+    }
+    return nullptr;
+  }
+  
+};
+
+// =============================================================================
+// BINARY VALUE (TLV)
+// =============================================================================
+
+/**
+ * @brief Typed value for the binary wire format
+ * 
+ * Built directly from numeric arguments, so binary sends skip text
+ * formatting. Types without a numeric encoding (strings) get type 0 and
+ * are sent through the text path as VWIRE_TLV_TEXT instead.
+ */
+struct VwireTlv {
+  uint8_t type;                              ///< VWIRE_TLV_* tag (0 = send as text)
+  union {
+    int32_t i;
+    float f;
+  };
+  
+  VwireTlv(int v) { _setInt(v); }
+  VwireTlv(long v) { if (v >= INT32_MIN && v <= INT32_MAX) _setInt((int32_t)v); else type = 0; }
+  VwireTlv(unsigned int v) { if (v <= (unsigned int)INT32_MAX) _setInt((int32_t)v); else type = 0; }
+  VwireTlv(unsigned long v) { if (v <= (unsigned long)INT32_MAX) _setInt((int32_t)v); else type = 0; }
+  VwireTlv(float v) : type(VWIRE_TLV_FLOAT32) { f = v; }
+  VwireTlv(double v) : type(VWIRE_TLV_FLOAT32) { f = (float)v; }
+  VwireTlv(bool v) : type(VWIRE_TLV_INT8) { i = v ? 1 : 0; }
+  VwireTlv(const char*) : type(0) { i = 0; }
+  VwireTlv(const String&) : type(0) { i = 0; }
+  VwireTlv(const VirtualPin&) : type(0) { i = 0; }
+  
+  /**
+   * @brief Write tag and value (5 bytes at most)
+   * @return Bytes written
+   */
+  size_t encode(uint8_t* out) const {
+    out[0] = type;
+    if (type == VWIRE_TLV_INT8) {
+      out[1] = (uint8_t)(int8_t)i;
+      return 2;
+    }
+    uint32_t raw;
+    memcpy(&raw, &i, sizeof(raw));  // Same bytes for int32 and float
+    out[1] = raw; out[2] = raw >> 8; out[3] = raw >> 16; out[4] = raw >> 24;
+    return 5;
+  }
+  
+  /**
+   * @brief Write a VWIRE_TLV_TEXT value (at most 255 bytes of text)
+   * @return Bytes written (len + 2)
+   */
+  static size_t encodeText(uint8_t* out, const char* text, size_t len) {
+    if (len > 255) len = 255;
+    out[0] = VWIRE_TLV_TEXT;
+    out[1] = len;
+    memcpy(out + 2, text, len);
+    return len + 2;
+  }
   
 private:
-  String _value;
+  void _setInt(int32_t v) {
+    type = (v >= -128 && v <= 127) ? VWIRE_TLV_INT8 : VWIRE_TLV_INT32;
+    i = v;
+  }
 };
 
 // =============================================================================
 // SETTINGS STRUCTURE
 // =============================================================================
 
+/**
+ * @brief Exponential backoff policy for retries and reconnects
+ * 
+ * Attempt n waits base * factor^n, capped at maxDelay, then randomised by
+ * +/- jitterPercent so a fleet does not retry in lockstep.
+ * factor = 1 and jitterPercent = 0 give a fixed interval.
+ */
+struct VwireBackoff {
+  uint8_t factor;                              ///< Growth factor per attempt (1 = fixed)
+  unsigned long maxDelay;                      ///< Upper bound for the delay (ms)
+  uint8_t jitterPercent;                       ///< Random spread, 0-100 %
+  
+  VwireBackoff(uint8_t f = 1, unsigned long max = 0, uint8_t jitter = 0)
+    : factor(f), maxDelay(max), jitterPercent(jitter) {}
+};
+
 /**
  * @brief Configuration settings for Vwire IOT connection
  * 
@@ -246,14 +501,22 @@ struct VwireSettings {
   unsigned long reconnectInterval;             ///< Milliseconds between reconnect attempts
   unsigned long heartbeatInterval;             ///< Milliseconds between heartbeats
   unsigned long wifiTimeout;                   ///< WiFi connection timeout (ms)
-  unsigned long mqttTimeout;                   ///< MQTT connection timeout (ms)
-  uint8_t dataQoS;                             ///< QoS level (note: PubSubClient only supports 0)
+  unsigned long mqttTimeout;                   ///< CONNACK wait (ms, rounded up to seconds)
+  uint8_t dataQoS;                             ///< QoS level (1 needs a QoS 1 transport)
   bool dataRetain;                             ///< Retain flag for data writes
   
   // Reliable Delivery Settings
   bool reliableDelivery;                       ///< Enable application-level acknowledgments
+  VwireAckMode ackMode;                        ///< Per-message or cumulative ACKs
+  VwireEncoding encoding;                      ///< Requested payload encoding
   unsigned long ackTimeout;                    ///< Time to wait for ACK before retry (ms)
   uint8_t maxRetries;                          ///< Max retry attempts before dropping message
+  VwireBackoff retryBackoff;                   ///< Backoff applied to ackTimeout between retries
+  VwireBackoff reconnectBackoff;               ///< Backoff applied to reconnectInterval
+  unsigned long dnsCacheTtl;                   ///< How long a resolved broker address is reused (ms, 0 = never)
+  bool tlsSessionReuse;                        ///< Resume TLS sessions on reconnect (ESP8266)
+  bool tlsConnectByAddress;                    ///< Connect TLS to the cached address without SNI (ESP8266)
+  bool syncOnConnect;                          ///< Request all pin values with the session setup
   
   /**
    * @brief Default constructor - initializes with safe defaults
@@ -270,7 +533,7 @@ struct VwireSettings {
     port = VWIRE_DEFAULT_PORT_TLS;             // Default to secure port
     transport = VWIRE_TRANSPORT_TCP_SSL;       // Default to TLS
     autoReconnect = true;
-    dataQoS = 0;                               // PubSubClient only supports QoS 0
+    dataQoS = 0;                               // Fire-and-forget
     dataRetain = false;                        // Don't retain by default (faster)
     reconnectInterval = VWIRE_DEFAULT_RECONNECT_INTERVAL;
     heartbeatInterval = VWIRE_DEFAULT_HEARTBEAT_INTERVAL;
@@ -279,8 +542,20 @@ struct VwireSettings {
     
     // Reliable Delivery defaults (disabled for backward compatibility)
     reliableDelivery = false;
+    ackMode = VWIRE_ACK_PER_MESSAGE;
+    encoding = VWIRE_ENCODING_TEXT;
     ackTimeout = VWIRE_DEFAULT_ACK_TIMEOUT;
     maxRetries = VWIRE_DEFAULT_MAX_RETRIES;
+    
+    // Fixed intervals by default (backward compatible)
+    retryBackoff = VwireBackoff(1, VWIRE_DEFAULT_MAX_BACKOFF, 0);
+    reconnectBackoff = VwireBackoff(1, VWIRE_DEFAULT_MAX_BACKOFF, 0);
+    
+    // Reconnect shortcuts
+    dnsCacheTtl = VWIRE_DEFAULT_DNS_CACHE_TTL;
+    tlsSessionReuse = true;
+    tlsConnectByAddress = false;
+    syncOnConnect = false;
   }
 };
 
@@ -291,6 +566,9 @@ struct VwireSettings {
 /** @brief Handler function for virtual pin write events */
 typedef void (*PinHandler)(VirtualPin&);
 
+/** @brief Handler function for virtual pin read requests (answer with virtualSend()) */
+typedef void (*ReadHandler)();
+
 /** @brief Handler function for connection/disconnection events */
 typedef void (*ConnectionHandler)();
 
@@ -304,10 +582,30 @@ typedef void (*RawMessageHandler)(const char* topic, const char* payload);
  */
 typedef void (*DeliveryCallback)(const char* msgId, bool success);
 
+/**
+ * @brief Callback for cloud OTA progress
+ * @param state VWIRE_OTA_DOWNLOADING per chunk, then VWIRE_OTA_DONE or VWIRE_OTA_FAILED
+ * @param received Bytes received so far
+ * @param total Bytes to transfer
+ */
+typedef void (*OtaProgressHandler)(VwireOtaState state, uint32_t received, uint32_t total);
+
+/**
+ * @brief Wall-clock source for offline log timestamps
+ * @return Current Unix time in seconds, or 0 if not known yet
+ */
+typedef uint32_t (*TimeSourceCallback)();
+
 // =============================================================================
 // AUTO-REGISTRATION SYSTEM
 // =============================================================================
 
+/** @brief Sentinel for empty reliable delivery links */
+#define VWIRE_PENDING_NONE 0xFF
+
+/** @brief Reliable delivery index buckets - kept at most half full */
+#define VWIRE_PENDING_INDEX_SIZE (2 * VWIRE_MAX_PENDING_MESSAGES)
+
 /** @brief Maximum number of auto-registered handlers */
 #define VWIRE_MAX_AUTO_HANDLERS 32
 
@@ -320,14 +618,26 @@ struct VwireAutoHandler {
   PinHandler handler;    ///< Handler function pointer
 };
 
+/**
+ * @brief Internal structure for auto-registered read handlers
+ * @note Used internally by VWIRE_READ macro
+ */
+struct VwireAutoReadHandler {
+  uint8_t pin;           ///< Virtual pin number
+  ReadHandler handler;   ///< Handler function pointer
+};
+
 // External declarations for the auto-handler system
 extern VwireAutoHandler _vwireAutoReceiveHandlers[];
 extern uint8_t _vwireAutoReceiveCount;
+extern VwireAutoReadHandler _vwireAutoReadHandlers[];
+extern uint8_t _vwireAutoReadCount;
 extern ConnectionHandler _vwireAutoConnectHandler;
 extern ConnectionHandler _vwireAutoDisconnectHandler;
 
 // Internal registration functions (called by macros)
 void _vwireRegisterReceiveHandler(uint8_t pin, PinHandler handler);
+void _vwireRegisterReadHandler(uint8_t pin, ReadHandler handler);
 void _vwireRegisterConnectHandler(ConnectionHandler handler);
 void _vwireRegisterDisconnectHandler(ConnectionHandler handler);
 
@@ -347,6 +657,11 @@ void _vwireRegisterDisconnectHandler(ConnectionHandler handler);
  *   digitalWrite(LED_PIN, value);
  * }
  * 
+ * // Answer a dashboard read request for V1
+ * VWIRE_READ(V1) {
+ *   Vwire.virtualSend(V1, readTemperature());
+ * }
+ * 
  * // Called when connected to server
  * VWIRE_CONNECTED() {
  *   Serial.println("Connected!");
@@ -379,10 +694,19 @@ void _vwireRegisterDisconnectHandler(ConnectionHandler handler);
   void _vwire_receive_handler_##vpin(VirtualPin& param)
 
 /**
- * @brief Placeholder for read requests (server requests data from device)
- * @param vpin Virtual pin number
+ * @brief Register handler for virtual pin read requests (server pulls a value)
+ * @param vpin Virtual pin number (V0-V31 or 0-255)
+ * @note Answer by sending the pin's value with Vwire.virtualSend(vpin, ...).
+ *       With setReadCache(), repeated requests inside the TTL are answered
+ *       from the last value without calling the handler.
  */
 #define VWIRE_READ(vpin) \
+  void _vwire_read_handler_##vpin(); \
+  struct _VWIRE_UNIQUE(_VwireReadReg_, __LINE__) { \
+    _VWIRE_UNIQUE(_VwireReadReg_, __LINE__)() { \
+      _vwireRegisterReadHandler(vpin, _vwire_read_handler_##vpin); \
+    } \
+  } _VWIRE_UNIQUE(_vwireReadRegInstance_, __LINE__); \
   void _vwire_read_handler_##vpin()
 
 /**
@@ -512,6 +836,32 @@ public:
    */
   void setTransport(VwireTransport transport);
   
+  /**
+   * @brief Use a different MQTT client (default: PubSubClient)
+   * 
+   * On a client that publishes at QoS 1 (such as the built-in
+   * VwireMqttClient), reliable delivery sends plain pin messages at
+   * QoS 1 and takes the broker's PUBACK as the ACK - no JSON envelope,
+   * no /data or /ack topic. setDataQoS(1) then sends all other pin
+   * values, arrays, batches, series and the offline backlog at QoS 1
+   * as well.
+   * 
+   * @code
+   * VwireMqttClient mqtt;
+   * 
+   * void setup() {
+   *   Vwire.config(AUTH_TOKEN);
+   *   Vwire.setMqttTransport(mqtt);
+   *   Vwire.setReliableDelivery(true);
+   *   Vwire.begin(WIFI_SSID, WIFI_PASS);
+   * }
+   * @endcode
+   * 
+   * @param transport Client to use; must outlive this instance
+   * @return false while connected or attached to another instance
+   */
+  bool setMqttTransport(VwireMqttTransport& transport);
+  
   /**
    * @brief Enable or disable auto-reconnection
    * @param enable true to enable, false to disable
@@ -524,6 +874,59 @@ public:
    */
   void setReconnectInterval(unsigned long interval);
   
+  /**
+   * @brief Use exponential backoff with jitter between reconnect attempts
+   * @param factor Multiply the reconnect interval by this much per failed attempt
+   * @param maxDelay Upper bound for the wait between attempts (ms)
+   * @param jitterPercent Randomise each wait by +/- this percentage (0-100)
+   * @note The delay resets to the reconnect interval after a successful connect.
+   */
+  void setReconnectBackoff(uint8_t factor, unsigned long maxDelay, uint8_t jitterPercent = 20);
+  
+  /**
+   * @brief Set how long the resolved broker address is reused
+   * @param ttl Milliseconds before the hostname is looked up again (0 = every connect)
+   * @note A failed TCP/TLS connect always drops the cached address.
+   */
+  void setDnsCacheTtl(unsigned long ttl);
+  
+  /**
+   * @brief Enable or disable TLS session resumption on reconnect
+   * @param enable true to resume the previous session (abbreviated handshake)
+   * @note ESP8266 (BearSSL) only; the ESP32 WiFiClientSecure has no session API.
+   *       Call before begin().
+   */
+  void setTlsSessionReuse(bool enable);
+  
+  /**
+   * @brief Connect TLS to the cached broker address instead of the hostname
+   * 
+   * BearSSL only sends SNI and checks the certificate name when it is given
+   * the hostname, and then resolves it again on every connect. Enabled, the
+   * address from the DNS cache (or RTC memory after deep sleep) is used and
+   * no SNI is sent - only for brokers that do not need SNI, with
+   * fingerprint or CA pinning rather than name checks.
+   * @param enable true to connect by address (default: false)
+   * @note ESP8266 only; the ESP32 always connects by address and sends SNI.
+   */
+  void setTlsConnectByAddress(bool enable);
+  
+  /**
+   * @brief Keep the broker address and TLS session across deep sleep
+   * 
+   * Call right before entering deep sleep. The next begin() after wake-up
+   * picks the cache up from RTC memory and skips the DNS lookup (and, on
+   * ESP8266, the full TLS handshake). ESP8266 MQTTS still resolves the
+   * hostname unless setTlsConnectByAddress() is enabled.
+   * 
+   * @param sleepMs Planned sleep time, deducted from the address lifetime
+   * @return true if saved (false on boards without RTC memory support)
+   */
+  bool saveConnectionCache(unsigned long sleepMs = 0);
+  
+  /** @brief Forget the cached broker address and TLS session (RAM and RTC) */
+  void clearConnectionCache();
+  
   /**
    * @brief Set heartbeat interval
    * @param interval Milliseconds between heartbeats
@@ -531,11 +934,44 @@ public:
   void setHeartbeatInterval(unsigned long interval);
   
   /**
-   * @brief Set MQTT QoS level (note: PubSubClient only supports QoS 0)
-   * @param qos QoS level (0, 1, or 2)
+   * @brief Ask the server for all pin values on every connect
+   * @param enable true to send the sync request with the session setup
+   * 
+   * Same as calling syncAll() from VWIRE_CONNECTED(), but the request goes
+   * out in the same write as the subscriptions, before connect handlers run.
+   */
+  void setSyncOnConnect(bool enable);
+  
+  /**
+   * @brief Set MQTT QoS level for pin values
+   * 
+   * Covers everything carrying pin data: values, arrays, binary frames,
+   * batches, record() series and the offline backlog.
+   * @param qos 0 or 1 (2 is treated as 1)
+   * @note QoS 1 needs a transport that supports it (see setMqttTransport());
+   *       PubSubClient publishes at QoS 0 whatever is set here.
    */
   void setDataQoS(uint8_t qos);
   
+  /**
+   * @brief Request the compact binary (TLV) encoding for outgoing messages
+   * @param encoding VWIRE_ENCODING_TEXT (default) or VWIRE_ENCODING_BINARY
+   * 
+   * Binary mode is negotiated on every connect: the device publishes
+   * "tlv1" to vwire/<id>/enc/req and switches only after the server
+   * confirms with "tlv1" on vwire/<id>/enc. Pin values, batches, reliable
+   * messages and heartbeats then go to vwire/<id>/bin as TLV frames
+   * (see VWIRE_FRAME_* / VWIRE_TLV_*), and binary ACK frames are accepted.
+   * Until then, or if the server refuses, text payloads are used.
+   */
+  void setEncoding(VwireEncoding encoding);
+  
+  /**
+   * @brief Check if the server accepted the binary encoding
+   * @return true if outgoing messages currently use TLV frames
+   */
+  bool isBinaryActive();
+  
   /**
    * @brief Set retain flag for published messages
    * @param retain true to retain messages, false for faster delivery
@@ -564,6 +1000,28 @@ public:
    */
   void setMaxRetries(uint8_t retries);
   
+  /**
+   * @brief Select the ACK protocol used by reliable delivery
+   * @param mode VWIRE_ACK_PER_MESSAGE (default) or VWIRE_ACK_CUMULATIVE
+   * 
+   * In cumulative mode data messages carry a numeric "seq" and the server
+   * answers with {"upTo":N,"mask":M}: every message up to N is delivered,
+   * and bit i of M acknowledges N+1+i (selective ACK past a gap). One ACK
+   * can then clear the whole pending window.
+   */
+  void setAckMode(VwireAckMode mode);
+  
+  /**
+   * @brief Use exponential backoff with jitter between reliable delivery retries
+   * @param factor Multiply the ACK timeout by this much per retry (1 = fixed)
+   * @param maxDelay Upper bound for the wait between retries (ms)
+   * @param jitterPercent Randomise each wait by +/- this percentage (0-100)
+   * @code
+   * Vwire.setRetryBackoff(2, 60000, 20);  // 5s, 10s, 20s ... +/-20%
+   * @endcode
+   */
+  void setRetryBackoff(uint8_t factor, unsigned long maxDelay, uint8_t jitterPercent = 20);
+  
   /**
    * @brief Set callback for delivery status notifications
    * @param cb Callback function (msgId, success)
@@ -588,6 +1046,31 @@ public:
    */
   bool begin();
   
+  /**
+   * @brief Start connecting to WiFi and MQTT without blocking
+   * @param ssid WiFi network name
+   * @param password WiFi password
+   * @return true if the connection was started
+   * @note run() advances one stage per call (WiFi, DNS, TCP/TLS, MQTT,
+   *       subscribe), so the sketch keeps running while it connects.
+   *       getState() reports progress; VWIRE_CONNECTED() fires when done.
+   *       Each stage is a single operation bounded by its timeout, but a
+   *       TLS handshake still takes as long as the handshake itself.
+   *       After sleepFor() the credentials are used again if the fast
+   *       join fails, so keep them valid until connected.
+   * @code
+   * void setup() { Vwire.config(TOKEN); Vwire.beginAsync(SSID, PASS); }
+   * void loop()  { Vwire.run(); driveMotors(); }
+   * @endcode
+   */
+  bool beginAsync(const char* ssid, const char* password);
+  
+  /**
+   * @brief Start connecting to MQTT without blocking (WiFi must be connected)
+   * @return true if the connection was started
+   */
+  bool beginAsync();
+  
   /**
    * @brief Process MQTT messages and maintain connection
    * @note Must be called frequently in loop()
@@ -639,34 +1122,276 @@ public:
    */
   template<typename T>
   void virtualSend(uint8_t pin, T value) {
-    VirtualPin vp(value);
-    _virtualSendInternal(pin, vp.asString());
+    // Binary encoding sends numbers as raw int/float - no text formatting
+    if (_binaryActive && _binaryDirect()) {
+      VwireTlv tlv(value);
+      if (tlv.type) {
+        _virtualSendTlv(pin, tlv);
+        return;
+      }
+    }
+    VirtualPin vp(value);  // Formats into an inline buffer - no heap allocation
+    _virtualSendInternal(pin, vp.asCString());
   }
   
+  /**
+   * @brief Send C-string to virtual pin (sent as-is, no copy)
+   * @param pin Virtual pin number (0-255)
+   * @param value NUL-terminated text
+   */
+  void virtualSend(uint8_t pin, const char* value);
+  
+  /**
+   * @brief Send String to virtual pin (sent as-is, no copy)
+   * @param pin Virtual pin number (0-255)
+   * @param value Text to send
+   */
+  void virtualSend(uint8_t pin, const String& value);
+  
   /**
    * @brief Send float array to virtual pin (comma-separated)
    * @param pin Virtual pin number
    * @param values Array of float values
    * @param count Number of values
+   * @param decimals Digits after the decimal point
+   * @note Values are formatted straight into the MQTT packet, so memory use
+   *       does not grow with count (up to the broker's maximum packet size).
+   *       Arrays too long for the scratch arena skip reliable delivery,
+   *       batching, the publish queue and publish policies.
    */
-  void virtualSendArray(uint8_t pin, float* values, int count);
+  void virtualSendArray(uint8_t pin, const float* values, int count, uint8_t decimals = 2);
   
   /**
    * @brief Send int array to virtual pin (comma-separated)
    * @param pin Virtual pin number
    * @param values Array of int values
    * @param count Number of values
+   * @note Streamed like the float version
    */
-  void virtualSendArray(uint8_t pin, int* values, int count);
+  void virtualSendArray(uint8_t pin, const int* values, int count);
   
   /**
    * @brief Send formatted string to virtual pin
    * @param pin Virtual pin number
    * @param format Printf-style format string
    * @param ... Format arguments
+   * @note Output longer than 128 bytes is formatted into the scratch arena
+   *       (or a temporary heap block) instead of being truncated
    */
   void virtualSendf(uint8_t pin, const char* format, ...);
   
+  // =========================================================================
+  // PUBLISH POLICIES (change detection)
+  // =========================================================================
+  
+  /**
+   * @brief Only publish numeric values that moved outside a deadband
+   * @param pin Virtual pin number
+   * @param absolute Minimum absolute change since the last published value
+   * @param percent Minimum change as a percentage of the last published value
+   * @note A value is sent when its change reaches the larger of the two bands.
+   *       Redundant virtualSend() calls are dropped before any network I/O.
+   * @return false if the policy table is full (VWIRE_MAX_PUBLISH_POLICIES)
+   */
+  bool setDeadband(uint8_t pin, float absolute, float percent = 0);
+  
+  /**
+   * @brief Only publish when the value differs from the last published one
+   * @param pin Virtual pin number
+   * @param enable true to drop repeated identical values
+   * @return false if the policy table is full
+   */
+  bool setPublishOnChange(uint8_t pin, bool enable = true);
+  
+  /**
+   * @brief Rate-limit a pin and/or force periodic re-publishing
+   * @param pin Virtual pin number
+   * @param minInterval Minimum milliseconds between publishes (0 = no limit).
+   *        The newest value sent inside the interval is held and published
+   *        by run() when it ends, so the last value of a burst is not lost
+   * @param maxSilence Publish even an unchanged value once this many
+   *        milliseconds passed since the last publish (0 = never)
+   * @return false if the policy table is full
+   */
+  bool setPublishInterval(uint8_t pin, unsigned long minInterval, unsigned long maxSilence = 0);
+  
+  /**
+   * @brief Remove all publish policies from a pin
+   * @param pin Virtual pin number
+   */
+  void clearPublishPolicy(uint8_t pin);
+  
+  // =========================================================================
+  // PUBLISH QUEUE (rate limiting)
+  // =========================================================================
+  
+  /**
+   * @brief Queue virtualSend() calls and publish them from run() at a fixed rate
+   * @param messagesPerSecond Publish budget (0 = publish synchronously, default)
+   * @param burst Messages that may be sent back-to-back after an idle period
+   * @note Each pin holds at most one unsent value; a newer value overwrites
+   *       the older one (last value wins), so bursts coalesce instead of
+   *       backing up. Up to VWIRE_PUBLISH_QUEUE_SIZE pins can be queued.
+   *       Reliable delivery and batched sends are not queued.
+   */
+  void setPublishRate(uint16_t messagesPerSecond, uint8_t burst = 1);
+  
+  /**
+   * @brief Publish all queued values now, ignoring the rate limit
+   */
+  void flushPublishQueue();
+  
+  /**
+   * @brief Get number of pins with a queued, unsent value
+   * @return Queued value count
+   */
+  uint8_t getQueuedCount();
+  
+  // =========================================================================
+  // BATCHED SEND OPERATIONS
+  // =========================================================================
+  
+  /**
+   * @brief Start collecting virtualSend() calls into one batch message
+   * @note Values are packed into a single JSON object published to
+   *       vwire/<id>/batch by flushBatch(), e.g. {"V0":"23.50","V1":"61"}.
+   *       If the batch buffer fills up it is flushed automatically.
+   *       Reliable delivery sends are not batched.
+   * @code
+   * Vwire.beginBatch();
+   * Vwire.virtualSend(V0, temperature);
+   * Vwire.virtualSend(V1, humidity);
+   * Vwire.flushBatch();  // One MQTT publish for both pins
+   * @endcode
+   */
+  void beginBatch();
+  
+  /**
+   * @brief Publish the collected batch and leave batch mode
+   * @return true if a batch was published (false if empty or not connected)
+   */
+  bool flushBatch();
+  
+  /**
+   * @brief Check if virtualSend() calls are currently being batched
+   * @return true between beginBatch() and flushBatch()
+   */
+  bool isBatching();
+  
+  // =========================================================================
+  // TIME-SERIES RECORDING
+  // =========================================================================
+  
+  /**
+   * @brief Reserve a sample buffer for record()
+   * @param pin Virtual pin number
+   * @param samples Buffer capacity (6 bytes each, taken from VWIRE_SERIES_ARENA_SIZE)
+   * @param maxAge Flush at the latest this many ms after the first buffered sample
+   * @param decimals Decimal places kept per value
+   * @return true if configured (false if the arena or series table is full)
+   * @note Capacity is fixed once reserved; clearSeries() releases all buffers.
+   */
+  bool setSeries(uint8_t pin, uint16_t samples, unsigned long maxAge = VWIRE_SERIES_DEFAULT_MAX_AGE,
+                 uint8_t decimals = 2);
+  
+  /**
+   * @brief Buffer a timestamped sample instead of publishing it immediately
+   * @param pin Virtual pin number
+   * @param value Sample value
+   * @return true if buffered
+   * @note The buffer is published as one message to vwire/<id>/series when
+   *       it fills up or its oldest sample reaches maxAge, e.g.
+   *       {"pin":"V0","age":980,"dt":20,"v":[23.50,23.51,23.49]}
+   *       "age" is how many ms ago the first sample was taken and "dt" the
+   *       spacing between samples in ms (an array if it varies).
+   *       Pins without setSeries() get VWIRE_SERIES_DEFAULT_SAMPLES samples.
+   * @code
+   * void sample() { Vwire.record(V0, analogRead(A0) * 0.01f); }
+   * timer.setInterval(10, sample);   // 100 Hz, ~3 publishes per second
+   * @endcode
+   */
+  bool record(uint8_t pin, float value);
+  
+  /**
+   * @brief Publish a pin's buffered samples now
+   * @param pin Virtual pin number
+   * @return true if published (false if empty or not connected)
+   */
+  bool flushSeries(uint8_t pin);
+  
+  /**
+   * @brief Publish all buffered samples now
+   */
+  void flushSeries();
+  
+  /**
+   * @brief Drop all record() buffers and release their arena space
+   */
+  void clearSeries();
+  
+  /**
+   * @brief Delta-encode series values as scaled integers
+   * @param enable true to send {"enc":"delta","scale":100,"v":[2350,1,-2]}
+   *        (first value absolute, then differences), which is much shorter
+   *        for slowly changing signals
+   */
+  void setSeriesDeltaEncoding(bool enable);
+  
+  // =========================================================================
+  // OFFLINE BUFFER
+  // =========================================================================
+  
+  /**
+   * @brief Capture virtualSend() calls while disconnected and replay them later
+   * @param useFlash Keep records in LittleFS (ESP32/ESP8266) so they survive
+   *        reboots; other boards and mount failures fall back to RAM
+   * @return true if the log is ready
+   * @note After reconnecting, records are replayed oldest first to
+   *       vwire/<id>/backlog as a JSON array, at most one batch per replay
+   *       interval and only while the live publish queue is empty:
+   *       [{"seq":12,"pin":"V0","value":"23.5","age":61000}, ...]
+   *       "age" is how many ms ago the value was captured; with a time
+   *       source it is replaced by "ts" (Unix seconds).
+   * @code
+   * Vwire.enableOfflineLog();          // LittleFS on ESP, RAM elsewhere
+   * Vwire.setOfflineReplay(8, 250);    // 8 records every 250 ms
+   * @endcode
+   */
+  bool enableOfflineLog(bool useFlash = true);
+  
+  /**
+   * @brief Stop capturing offline sends (flash records are kept for next time)
+   */
+  void disableOfflineLog();
+  
+  /**
+   * @brief Delete all buffered offline records
+   */
+  void clearOfflineLog();
+  
+  /**
+   * @brief Get number of offline records waiting for replay
+   * @return Buffered record count
+   */
+  uint32_t getOfflineCount();
+  
+  /**
+   * @brief Throttle replay of the offline log after reconnecting
+   * @param maxPerBatch Records per backlog message (1 to VWIRE_OFFLINE_REPLAY_MAX)
+   * @param interval Minimum ms between backlog messages
+   */
+  void setOfflineReplay(uint8_t maxPerBatch, unsigned long interval);
+  
+  /**
+   * @brief Provide wall-clock time so offline records keep absolute timestamps
+   * @param cb Function returning Unix seconds (0 while unknown)
+   * @code
+   * uint32_t unixTime() { time_t t = time(nullptr); return t > 1600000000 ? t : 0; }
+   * Vwire.setTimeSource(unixTime);
+   * @endcode
+   */
+  void setTimeSource(TimeSourceCallback cb);
+  
   // =========================================================================
   // SYNC OPERATIONS
   // =========================================================================
@@ -711,6 +1436,57 @@ public:
    */
   void onVirtualReceive(uint8_t pin, PinHandler handler);
   
+  /**
+   * @brief Register handler for virtual pin read requests (cloud pulls a value)
+   * 
+   * Called when the server publishes to vwire/<deviceId>/read/V<pin>. The
+   * handler answers with virtualSend() on the same pin; that answer skips
+   * the pin's publish policies, since the server asked for it.
+   * 
+   * @param pin Virtual pin number
+   * @param handler Callback function
+   * @note Consider using VWIRE_READ() macro for auto-registration
+   */
+  void onVirtualRead(uint8_t pin, ReadHandler handler);
+  
+  /**
+   * @brief Answer read requests for a pin from its last value for a while
+   * 
+   * Any value sent on the pin (by the read handler or a plain
+   * virtualSend()) starts a window of ttl milliseconds; read requests in
+   * that window are answered with it without calling the handler. Values
+   * longer than VWIRE_READ_CACHE_LENGTH are not cached.
+   * 
+   * @param pin Virtual pin number
+   * @param ttl Cache lifetime in milliseconds (0 = remove the cache)
+   * @return false if the cache table is full (VWIRE_MAX_READ_CACHES)
+   */
+  bool setReadCache(uint8_t pin, unsigned long ttl);
+  
+  /**
+   * @brief Run a pin's handler once per run() with the latest command only
+   * 
+   * Commands for the pin (single or batched) are held instead of calling
+   * the handler for each one; after the messages of a run() cycle have
+   * been processed the handler runs once with the newest value. Meant for
+   * actuators that only care about the final position, such as a servo
+   * or LED driven by a slider being dragged. Values longer than
+   * VWIRE_COALESCE_VALUE_LENGTH - 1 bypass the hold and run the handler
+   * right away, replacing any held value.
+   * 
+   * @code
+   * Vwire.setCoalesce(V1);   // Servo on V1 moves once per run()
+   * @endcode
+   * 
+   * @param pin Virtual pin number
+   * @param enable true to coalesce, false to call the handler per command
+   *        (a value still held is handed to the handler right away)
+   * @return false if the table is full (VWIRE_MAX_COALESCED_PINS)
+   * @note Call from the context that runs handlers (loop(), or the network
+   *       task with VWIRE_DISPATCH_NETWORK)
+   */
+  bool setCoalesce(uint8_t pin, bool enable = true);
+  
   /**
    * @brief Register connection handler
    * @param handler Callback function
@@ -728,6 +1504,9 @@ public:
   /**
    * @brief Register raw message handler
    * @param handler Callback function receiving topic and payload
+   * @note The payload is copied to the scratch arena so it stays valid if
+   *       the handler publishes; the topic lives in the MQTT receive
+   *       buffer and is overwritten by the first publish.
    */
   void onMessage(RawMessageHandler handler);
   
@@ -798,12 +1577,150 @@ public:
    */
   uint32_t getFreeHeap();
   
+  /**
+   * @brief Get the largest block the heap can allocate
+   * @return Bytes (0 on unsupported platforms)
+   */
+  uint32_t getMaxFreeBlock();
+  
+  /**
+   * @brief Get heap fragmentation
+   * @return 0 (one free block) to 100 percent (0 on unsupported platforms)
+   */
+  uint8_t getHeapFragmentation();
+  
   /**
    * @brief Get uptime since connection
    * @return Seconds since begin() was called
    */
   uint32_t getUptime();
   
+  // =========================================================================
+  // STATISTICS
+  // =========================================================================
+  
+  /**
+   * @brief Read the built-in counters and duration histograms
+   * @return Statistics since begin() or resetStats() (all zero when
+   *         VWIRE_ENABLE_STATS is 0)
+   */
+  const VwireStats& getStats();
+  
+  /** @brief Zero all counters and histograms */
+  void resetStats();
+  
+  /**
+   * @brief Add statistics to every heartbeat
+   * @param enable true to append counters, min/avg/max durations and heap
+   *        fragmentation to the heartbeat JSON
+   * @note Heartbeats then stay text even after the binary encoding was
+   *       accepted (the binary heartbeat frame has no room for them)
+   */
+  void setHeartbeatStats(bool enable);
+  
+  // =========================================================================
+  // GATEWAY (SEVERAL DEVICES, ONE CONNECTION)
+  // =========================================================================
+  
+  /**
+   * @brief Serve this device over another instance's broker connection
+   * 
+   * Call after config() instead of begin(). The owner's connection (one
+   * TCP/TLS session) then carries this device too: it subscribes to this
+   * device's topics, and the owner's run() also runs this device's
+   * heartbeat, retries, queue, series and replay. Topics arriving on the
+   * connection are routed to the instance whose device ID they carry.
+   * 
+   * Each instance keeps its own handlers (onVirtualReceive(), onConnect(),
+   * ...); VWIRE_RECEIVE / VWIRE_CONNECTED / VWIRE_DISCONNECTED apply to
+   * the connection owner only. The broker must let the owner's token
+   * publish and subscribe for the attached device IDs. The offline log of
+   * an attached device is kept in RAM.
+   * 
+   * @param owner Instance that calls begin() and run()
+   * @return false if owner is itself attached, full (VWIRE_MAX_DEVICES),
+   *         running a network task, or this device has no token
+   */
+  bool attachTo(VwireClass& owner);
+  
+  /**
+   * @brief Publish offline status and stop sharing the owner's connection
+   */
+  void detach();
+  
+  /**
+   * @brief Check if this device uses another instance's connection
+   */
+  bool isAttached() const { return _owner != nullptr; }
+  
+  // =========================================================================
+  // NETWORK TASK (ESP32 only)
+  // =========================================================================
+  
+  /**
+   * @brief Move the network side of run() into a library-owned task
+   * 
+   * PubSubClient, heartbeats, retries, replay and reconnects then run on
+   * their own core, so a slow TLS write no longer blocks loop() and a busy
+   * loop() no longer delays the connection. Call after begin() or
+   * beginAsync(), once configuration is done.
+   * 
+   * From the application, virtualSend()/virtualSendf()/virtualSendArray(),
+   * record(), notify(), email(), log(), sync*(), beginBatch(), flushBatch()
+   * and flushSeries() are queued to the task (up to VWIRE_NET_QUEUE_SIZE
+   * records of VWIRE_NET_VALUE_LENGTH bytes). Other setters must not be
+   * called while the task runs. onMessage() and onDeliveryStatus()
+   * callbacks always run on the network task.
+   * 
+   * @param dispatch VWIRE_DISPATCH_LOOP: pin and connect/disconnect handlers
+   *                 run from run(); VWIRE_DISPATCH_NETWORK: on the task
+   * @param core Core to pin the task to
+   * @return false if unsupported, already running or out of memory
+   */
+  bool startNetworkTask(VwireDispatch dispatch = VWIRE_DISPATCH_LOOP,
+                        uint8_t core = VWIRE_NET_TASK_CORE);
+  
+  /**
+   * @brief Send what is queued, stop the network task and return to run()
+   */
+  void stopNetworkTask();
+  
+  /**
+   * @brief Check if the network task is running
+   */
+  bool isNetworkTaskRunning() const;
+  
+  // =========================================================================
+  // DEEP SLEEP (ESP32/ESP8266 only)
+  // =========================================================================
+  
+  /**
+   * @brief Flush pending data, save resume state and enter deep sleep
+   * 
+   * Sends any open batch, queued and record() data, waits up to
+   * VWIRE_SLEEP_FLUSH_TIMEOUT for outstanding ACKs, publishes a retained
+   * "sleeping" status and disconnects cleanly. WiFi channel/BSSID, the
+   * broker address, TLS session (ESP8266) and message counter are kept in
+   * RTC memory so the next begin() can fast-connect. record() samples that
+   * could not be sent go to the offline log if it is enabled.
+   * 
+   * @param ms Sleep time in milliseconds
+   * @return false if deep sleep is not supported (does not return otherwise)
+   */
+  bool sleepFor(unsigned long ms);
+  
+  /**
+   * @brief Check if this boot resumed from sleepFor()
+   * @return true once begin() restored the saved state
+   */
+  bool wokeFromSleep() const { return _wokeFromSleep; }
+  
+  /**
+   * @brief Awake time of the previous sleep cycle
+   * @return Milliseconds from boot to sleepFor() last cycle (0 if unknown)
+   */
+  unsigned long getLastAwakeTime() const { return _lastAwakeTime; }
+  
   // =========================================================================
   // OTA UPDATES (ESP32/ESP8266 only)
   // =========================================================================
@@ -823,6 +1740,41 @@ public:
   void handleOTA();
   #endif
   
+  /**
+   * @brief Take firmware updates over the Vwire connection (cloud OTA)
+   * 
+   * The server announces an update on vwire/<deviceId>/ota and the device
+   * pulls it in chunks over the existing MQTT session, writing each chunk
+   * straight to the target - no LAN access, no open OTA port, no image in
+   * RAM. Announcements with a "base" MD5 matching the running firmware
+   * carry a delta patch instead of a full image. Interrupted downloads
+   * continue from the last received offset after a reconnect. See
+   * VwireOta.h for the protocol.
+   * 
+   * @code
+   * Vwire.enableCloudOTA();   // Flash, restart when done (ESP32/ESP8266)
+   * @endcode
+   * 
+   * @param target Image destination (nullptr = the update partition,
+   *        ESP32/ESP8266 only; custom targets work on any board)
+   * @return false without a target on this board, or on an attached device
+   * @note Chunks are written from run() (or the network task), and long
+   *       patch copies block it while they run
+   */
+  bool enableCloudOTA(VwireOtaTarget* target = nullptr);
+  
+  /**
+   * @brief Register a callback for cloud OTA progress
+   * @param handler Called per chunk and once when the update ends
+   */
+  void onOtaProgress(OtaProgressHandler handler);
+  
+  /**
+   * @brief Check if a cloud OTA download is in progress
+   * @return true between the announcement and the end of the transfer
+   */
+  bool isOtaInProgress() const { return _ota.active(); }
+  
   // =========================================================================
   // DEBUG METHODS
   // =========================================================================
@@ -854,6 +1806,13 @@ private:
   VwireSettings _settings;              ///< Configuration settings
   VwireState _state;                    ///< Current connection state
   VwireError _lastError;                ///< Last error code
+  
+  // Statistics
+  bool _heartbeatStats;                  ///< Append getStats() to heartbeats
+  #if VWIRE_ENABLE_STATS
+  VwireStats _stats;                     ///< Counters and histograms
+  uint32_t _publishStartedAt;            ///< micros() at the last _beginPublish()
+  #endif
   char _deviceId[VWIRE_MAX_TOKEN_LENGTH]; ///< Device identifier
   bool _debug;                          ///< Debug output enabled
   Stream* _debugStream;                 ///< Debug output stream
@@ -863,12 +1822,47 @@ private:
   unsigned long _lastHeartbeat;         ///< Last heartbeat timestamp
   unsigned long _lastReconnectAttempt;  ///< Last reconnect attempt timestamp
   
+  // Staged connect (one stage per run() call)
+  enum ConnectStage : uint8_t {
+    STAGE_IDLE = 0,                     ///< Not connecting
+    STAGE_WIFI,                         ///< Waiting for WiFi association
+    STAGE_DNS,                          ///< Resolving the broker hostname
+    STAGE_TRANSPORT,                    ///< TCP connect (+ TLS handshake)
+    STAGE_MQTT,                         ///< MQTT CONNECT / CONNACK
+    STAGE_SUBSCRIBE                     ///< Subscriptions and online status
+  };
+  enum ConnectResult : uint8_t {
+    CONNECT_PENDING = 0,                ///< More stages to go
+    CONNECT_DONE,                       ///< Connected
+    CONNECT_FAILED                      ///< Stage failed or timed out
+  };
+  ConnectStage _connectStage;           ///< Current connect stage
+  unsigned long _stageStartedAt;        ///< When the current stage began
+  IPAddress _serverIP;                  ///< Broker address from the DNS stage
+  bool _dnsCached;                      ///< _serverIP is reusable
+  unsigned long _dnsCachedAt;           ///< When _serverIP was resolved/restored
+  unsigned long _dnsValidFor;           ///< Lifetime of _serverIP from _dnsCachedAt
+  uint32_t _dnsServerHash;              ///< Hostname _serverIP belongs to
+  unsigned long _reconnectDelay;        ///< Current wait before the next attempt
+  uint8_t _reconnectAttempts;           ///< Consecutive failed attempts
+  uint32_t _jitterState;                ///< Private PRNG state for backoff jitter
+  
   // Network clients (member variables for stable TLS)
   WiFiClient _wifiClient;               ///< Plain TCP client
   #if VWIRE_HAS_SSL
   WiFiClientSecure _secureClient;       ///< TLS/SSL client
+  #if defined(VWIRE_BOARD_ESP8266)
+  BearSSL::Session _tlsSession;         ///< Resumable TLS session (kept across reconnects)
+  #endif
   #endif
-  PubSubClient _mqttClient;             ///< MQTT client
+  VwirePubSubTransport _mqttClient;     ///< Default MQTT client
+  VwireMqttTransport* _transport;       ///< Our MQTT client (setMqttTransport())
+  VwireMqttTransport* _mqtt;            ///< Client in use (the owner's when attached)
+  
+  // Gateway
+  VwireClass* _owner;                   ///< Instance whose connection we share
+  VwireClass* _attached[VWIRE_MAX_DEVICES]; ///< Devices sharing our connection
+  uint8_t _attachedCount;               ///< Entries in _attached
   
   // Handlers
   struct PinHandlerEntry {
@@ -878,6 +1872,69 @@ private:
   };
   PinHandlerEntry _pinHandlers[VWIRE_MAX_HANDLERS];  ///< Manual handler table
   int _pinHandlerCount;                              ///< Number of registered handlers
+  PinHandler _pinDispatch[VWIRE_MAX_VIRTUAL_PINS];   ///< Pin -> handler index (built at begin)
+  struct ReadHandlerEntry {
+    uint8_t pin;                        ///< Pin number
+    ReadHandler handler;                ///< Handler function
+  };
+  ReadHandlerEntry _readHandlers[VWIRE_MAX_READ_HANDLERS];  ///< Manual read handler table
+  uint8_t _readHandlerCount;                                ///< Number of registered read handlers
+  ReadHandler _readDispatch[VWIRE_MAX_VIRTUAL_PINS];        ///< Pin -> read handler (built with _pinDispatch)
+  int16_t _readingPin;                  ///< Pin whose read handler is running (-1 = none)
+  
+  // Read cache
+  struct ReadCache {
+    uint8_t pin;                         ///< Pin number
+    bool active;                         ///< Entry in use
+    bool valid;                          ///< value holds a cached answer
+    unsigned long ttl;                   ///< Cache lifetime in ms
+    unsigned long cachedAt;              ///< When value was sent
+    char value[VWIRE_READ_CACHE_LENGTH]; ///< Last value sent on the pin
+  };
+  ReadCache _readCaches[VWIRE_MAX_READ_CACHES];  ///< Per-pin read caches
+  uint8_t _readCacheCount;               ///< Active read caches (0 = fast path)
+  
+  // Command coalescing
+  struct CoalesceSlot {
+    uint8_t pin;                             ///< Pin number
+    bool active;                             ///< Entry in use
+    bool held;                               ///< value waits for the handler
+    uint8_t len;                             ///< Value length
+    char value[VWIRE_COALESCE_VALUE_LENGTH]; ///< Latest command value
+  };
+  CoalesceSlot _coalesce[VWIRE_MAX_COALESCED_PINS];  ///< Per-pin held commands
+  uint8_t _coalesceCount;                ///< Active slots (0 = fast path)
+  uint8_t _coalesceHeld;                 ///< Slots holding a value
+  
+  // Topic routing
+  char _topicPrefix[VWIRE_MAX_TOPIC_PREFIX_LENGTH];  ///< "vwire/<deviceId>/"
+  uint8_t _topicPrefixLen;                           ///< Length of _topicPrefix
+  
+  // Session setup - written as one block right after CONNACK
+  uint8_t _sessionPackets[VWIRE_SESSION_BUFFER_SIZE];  ///< Preformatted status/subscribe/request packets
+  uint16_t _sessionLength;                             ///< Bytes in _sessionPackets (0 = not built)
+  uint8_t _sessionOptions;                             ///< SESSION_* flags the block was built for
+  
+  /** @brief Optional parts of the session setup block */
+  enum SessionOption {
+    SESSION_READ = 0x01,   ///< Subscribe to read/#
+    SESSION_ACK  = 0x02,   ///< Subscribe to ack (application-level ACKs)
+    SESSION_ENC  = 0x04,   ///< Subscribe to enc and request the binary encoding
+    SESSION_SYNC = 0x08,   ///< Request all pin values
+    SESSION_OTA  = 0x10    ///< Subscribe to ota and ota/data
+  };
+  
+  /** @brief Inbound topic kinds recognised by _parseTopic() */
+  enum TopicKind {
+    TOPIC_UNKNOWN = 0,                  ///< Not addressed to this device
+    TOPIC_ACK,                          ///< vwire/<id>/ack
+    TOPIC_ENC,                          ///< vwire/<id>/enc
+    TOPIC_CMD,                          ///< vwire/<id>/cmd/V<n>
+    TOPIC_CMD_BATCH,                    ///< vwire/<id>/cmd (several pins)
+    TOPIC_READ,                         ///< vwire/<id>/read/V<n>
+    TOPIC_OTA,                          ///< vwire/<id>/ota (update announcement)
+    TOPIC_OTA_DATA                      ///< vwire/<id>/ota/data (firmware chunk)
+  };
   
   ConnectionHandler _connectHandler;     ///< Manual connect handler
   ConnectionHandler _disconnectHandler;  ///< Manual disconnect handler
@@ -888,18 +1945,132 @@ private:
   bool _otaEnabled;                      ///< OTA updates enabled
   #endif
   
+  // Cloud OTA
+  VwireOtaUpdate _ota;                   ///< Current image transfer
+  VwireOtaTarget* _otaTarget;            ///< Image destination (nullptr = cloud OTA off)
+  OtaProgressHandler _otaHandler;        ///< Progress callback
+  uint32_t _otaWindowEnd;                ///< Offset the requested chunks end at
+  unsigned long _otaRequestedAt;         ///< When the window was requested
+  uint8_t _otaRetries;                   ///< Requests without progress
+  bool _otaApplyPending;                 ///< Image done - apply() after the delay
+  unsigned long _otaDoneAt;              ///< When the done status went out
+  
   // Reliable Delivery
+  // Any free slot takes a new message, and open-addressed indexes map its
+  // msgId and QoS 1 packetId back to the slot (O(1) ACK and PUBACK lookup).
+  // Busy slots are linked in order of their next retry, so run() only
+  // inspects the head.
   struct PendingMessage {
-    char msgId[16];                      ///< Unique message ID
+    uint32_t msgId;                      ///< Numeric message ID (sequential)
     uint8_t pin;                         ///< Pin number
     char value[64];                      ///< Value (truncated if longer)
-    unsigned long sentAt;                ///< Time when last sent
+    unsigned long dueAt;                 ///< Time of next retry
     uint8_t retries;                     ///< Number of retry attempts
+    uint16_t packetId;                   ///< QoS 1 packet ID (0 = not on the wire yet)
+    uint8_t prev;                        ///< Previous slot in due order
+    uint8_t next;                        ///< Next slot in due order (next free slot when free)
     bool active;                         ///< Slot in use
   };
-  PendingMessage _pendingMessages[VWIRE_MAX_PENDING_MESSAGES];  ///< Pending queue
+  PendingMessage _pendingMessages[VWIRE_MAX_PENDING_MESSAGES];  ///< Pending store
+  uint8_t _pendingHead;                  ///< Soonest due (VWIRE_PENDING_NONE if empty)
+  uint8_t _pendingTail;                  ///< Latest due
+  uint8_t _pendingCount;                 ///< Messages awaiting ACK
+  uint8_t _pendingFree;                  ///< First free slot (VWIRE_PENDING_NONE if all busy)
+  uint8_t _pendingIndex[VWIRE_PENDING_INDEX_SIZE];  ///< msgId -> slot, linear probing
+  uint8_t _packetIndex[VWIRE_PENDING_INDEX_SIZE];   ///< QoS 1 packetId -> slot, linear probing
+  uint8_t _pendingUnsent;                ///< Pending with no packetId (held back by the window)
   DeliveryCallback _deliveryCallback;    ///< Delivery status callback
-  uint32_t _msgIdCounter;                ///< Counter for message IDs
+  uint32_t _msgIdCounter;                ///< Last assigned message ID
+  
+  // Publish policies
+  struct PublishPolicy {
+    uint8_t pin;                         ///< Pin number
+    bool active;                         ///< Entry in use
+    bool onChange;                       ///< Drop identical values
+    bool hasLast;                        ///< lastValue/lastHash are valid
+    float deadbandAbs;                   ///< Absolute deadband (0 = off)
+    float deadbandPct;                   ///< Percent deadband (0 = off)
+    unsigned long minInterval;           ///< Minimum ms between publishes
+    unsigned long maxSilence;            ///< Force publish after this many ms
+    unsigned long lastSentAt;            ///< Time of last publish
+    float lastValue;                     ///< Last published numeric value
+    uint32_t lastHash;                   ///< FNV-1a hash of last published text
+    bool held;                           ///< heldValue waits for minInterval to pass
+    char heldValue[VWIRE_POLICY_VALUE_LENGTH];  ///< Newest value sent inside minInterval
+  };
+  PublishPolicy _policies[VWIRE_MAX_PUBLISH_POLICIES];  ///< Per-pin policies
+  uint8_t _policyCount;                  ///< Active policies (0 = fast path)
+  uint8_t _policyHeld;                   ///< Policies holding a value back
+  
+  // Publish queue
+  struct QueuedValue {
+    uint8_t pin;                         ///< Pin number
+    bool pending;                        ///< Holds an unsent value
+    char value[VWIRE_QUEUE_VALUE_LENGTH]; ///< Latest value for the pin
+  };
+  QueuedValue _publishQueue[VWIRE_PUBLISH_QUEUE_SIZE];  ///< Per-pin slot table
+  uint8_t _queuedCount;                  ///< Pending slots
+  uint8_t _queueCursor;                  ///< Round-robin drain position
+  uint16_t _publishRate;                 ///< Messages per second (0 = disabled)
+  uint8_t _publishBurst;                 ///< Token bucket capacity
+  uint32_t _publishTokens;               ///< Available sends x1000
+  unsigned long _lastTokenRefill;        ///< Last token bucket update
+  
+  // Scratch arena (LIFO - callers restore _scratchUsed when done)
+  char _scratch[VWIRE_SCRATCH_SIZE];               ///< Shared receive/transmit space
+  size_t _scratchUsed;                             ///< Bytes handed out
+  
+  // Batched sends
+  bool _batching;                                  ///< Between beginBatch() and flushBatch()
+  char _batchBuffer[VWIRE_BATCH_BUFFER_SIZE];      ///< JSON object being built
+  uint16_t _batchLen;                              ///< Bytes used in _batchBuffer
+  uint8_t _batchCount;                             ///< Pins in the current batch
+  bool _batchBinary;                               ///< Batch holds a TLV frame
+  
+  // Binary encoding
+  bool _binaryActive;                    ///< Server confirmed VWIRE_BINARY_PROTOCOL
+  
+  // Time-series recording
+  struct SeriesBuffer {
+    uint8_t pin;                         ///< Pin number
+    uint8_t decimals;                    ///< Decimal places per value
+    uint16_t offset;                     ///< First sample in _seriesArena (samples)
+    uint16_t capacity;                   ///< Samples reserved
+    uint16_t count;                      ///< Samples buffered
+    unsigned long maxAge;                ///< Flush deadline after first sample (ms)
+    unsigned long firstAt;               ///< millis() of first buffered sample
+    unsigned long lastAt;                ///< millis() of latest sample
+  };
+  SeriesBuffer _series[VWIRE_MAX_SERIES];            ///< Configured series
+  uint8_t _seriesArena[VWIRE_SERIES_ARENA_SIZE];     ///< (dt uint16, value float) pairs
+  uint16_t _seriesArenaUsed;                         ///< Samples reserved so far
+  uint8_t _seriesCount;                              ///< Configured series (0 = fast path)
+  bool _seriesDelta;                                 ///< Delta-encode values
+  
+  // Offline buffer
+  VwireOfflineLog _offlineLog;           ///< Sends captured while disconnected
+  TimeSourceCallback _timeSource;        ///< Optional wall clock for records
+  uint8_t _replayBatch;                  ///< Records per backlog message
+  unsigned long _replayInterval;         ///< Minimum ms between backlog messages
+  unsigned long _lastReplay;             ///< Last backlog publish
+  
+  // Deep sleep resume
+  const char* _wifiSsid;                 ///< Credentials for the fast-join fallback
+  const char* _wifiPassword;
+  uint8_t _resumeBssid[6];               ///< Access point before sleeping
+  uint8_t _resumeChannel;                ///< WiFi channel before sleeping (0 = scan)
+  bool _fastJoin;                        ///< STAGE_WIFI is using channel/BSSID
+  bool _wokeFromSleep;                   ///< State restored from sleepFor()
+  unsigned long _lastAwakeTime;          ///< Wake-to-sleep time of the last cycle
+  
+  // Network task
+  #if VWIRE_HAS_NET_TASK
+  TaskHandle_t volatile _netTask;        ///< Running network task (nullptr = run() does it all)
+  volatile bool _netStopping;            ///< stopNetworkTask() requested
+  VwireDispatch _netDispatch;            ///< Where pin/connection handlers run
+  VwireRing _netOutbox;                  ///< Application -> network task
+  VwireRing _netInbox;                   ///< Network task -> application
+  #endif
   
   // =========================================================================
   // PRIVATE METHODS
@@ -907,22 +2078,132 @@ private:
   
   bool _connectWiFi(const char* ssid, const char* password);
   bool _connectMQTT();
+  bool _finishConnect();
+  void _startConnect(ConnectStage stage);
+  ConnectResult _advanceConnect();
+  ConnectResult _failConnect(VwireError error);
+  void _onMqttConnected();
+  uint8_t _currentSessionOptions();
+  void _buildSessionPackets();
+  bool _appendSessionPacket(uint8_t header, uint16_t packetId, const char* type,
+                            const char* payload, int subscribeQos);
+  Client& _activeClient();
   void _setupClient();
+  bool _dnsCacheFresh();
+  void _restoreConnectionCache();
+  bool _saveRtcState(unsigned long sleepMs, bool sleeping);
   void _handleMessage(char* topic, byte* payload, unsigned int length);
+  char* _terminatePayload(char* topic, byte* payload, unsigned int length);
+  const char* _stableCopy(const char* data, size_t length);
+  char* _scratchAlloc(size_t size);
+  TopicKind _parseTopic(const char* topic, int* pin);
+  void _routeCommand(uint8_t pin, const char* value, size_t len, bool stable);
+  void _handleCommandBatch(char* payload, size_t len);
+  bool _holdCommand(uint8_t pin, const char* value, size_t len);
+  void _runHeldCommand(CoalesceSlot& slot);
+  void _flushCoalesced();
+  CoalesceSlot* _findCoalesce(uint8_t pin);
+  void _handleOtaAnnounce(const char* json);
+  void _handleOtaData(const uint8_t* data, size_t len);
+  void _requestOtaWindow();
+  void _publishOtaStatus(const char* state, const char* error);
+  void _failOta(const char* error = nullptr);
+  void _serviceOta();
+  void _updateTopicPrefix();
+  void _buildDispatchTable();
   static void _mqttCallbackWrapper(char* topic, byte* payload, unsigned int length);
-  void _virtualSendInternal(uint8_t pin, const String& value);
-  String _buildTopic(const char* type, int pin = -1);
+  void _virtualSendInternal(uint8_t pin, const char* value);
+  void _sendPinValue(uint8_t pin, const char* value, bool answer);
+  bool _answerFromCache(uint8_t pin);
+  void _runReadHandler(uint8_t pin);
+  ReadCache* _findReadCache(uint8_t pin);
+  bool _hasReadHandlers() const { return _readHandlerCount || (!_owner && _vwireAutoReadCount); }
+  void _publishPin(uint8_t pin, const char* value);
+  void _sendArray(uint8_t pin, const float* floats, const int* ints, int count, uint8_t decimals);
+  PublishPolicy* _findPolicy(uint8_t pin, bool create);
+  void _releaseHeld(PublishPolicy& policy);
+  void _flushHeldValues();
+  bool _enqueuePublish(uint8_t pin, const char* value);
+  void _drainPublishQueue(bool ignoreRate);
+  bool _passesPolicy(uint8_t pin, const char* value);
+  bool _batchAppend(uint8_t pin, const char* value);
+  bool _publishBatch();
+  bool _binaryDirect() { return !_policyCount && !_readCacheCount && !_publishRate &&
+                                !_settings.reliableDelivery && (!_batching || _batchBinary) &&
+                                connected() && !_netPosting(); }
+  void _virtualSendTlv(uint8_t pin, const VwireTlv& value);
+  bool _batchAppendRecord(const uint8_t* record, size_t len);
+  void _publishFrame(const uint8_t* frame, size_t len, bool retain);
+  SeriesBuffer* _findSeries(uint8_t pin);
+  bool _publishSeries(SeriesBuffer& series);
+  void _captureOffline(uint8_t pin, const char* value);
+  void _spillSeries();
+  bool _spillSeries(SeriesBuffer& series);
+  void _dropSeries(SeriesBuffer& series, uint16_t samples);
+  void _replayOfflineLog();
+  size_t _buildTopic(char* out, const char* type, int pin = -1);
   void _sendHeartbeat();
+  size_t _formatStats(char* out, size_t size);
+  void _run();
+  bool _beginPublish(const char* topic, size_t length, bool retain);
+  int _endPublish();
+  void _callPinHandler(PinHandler handler, VirtualPin& vpin);
+  
+  /** @brief Count a publish about to start (topic + payload bytes) */
+  void _countPublish(const char* topic, size_t length) {
+    #if VWIRE_ENABLE_STATS
+    _stats.publishes++;
+    _stats.bytesSent += strlen(topic) + length;
+    _publishStartedAt = micros();
+    #else
+    (void)topic; (void)length;
+    #endif
+  }
   void _setError(VwireError error);
+  unsigned long _backoffDelay(const VwireBackoff& policy, unsigned long base, uint8_t attempt);
   void _debugPrint(const char* message);
   void _debugPrintf(const char* format, ...);
   
   // Reliable delivery internal methods
   void _processRetries();
-  void _handleAck(const char* msgId, bool success);
-  int _findPendingSlot();
-  void _removePending(const char* msgId);  // Remove message from queue
-  void _sendWithReliableDelivery(uint8_t pin, const String& value);  // Send with ACK tracking
+  void _handleAck(uint32_t msgId, bool success);
+  void _handleCumulativeAck(uint32_t upTo, uint32_t mask);
+  int _findPending(uint32_t msgId);
+  uint32_t _indexKey(const uint8_t* index, uint8_t slot);       // msgId or packetId of slot
+  int _findIndexed(const uint8_t* index, uint32_t key);          // Slot for key, -1 if none
+  void _indexPending(uint8_t* index, uint8_t slot);             // Add key -> slot
+  void _unindexPending(uint8_t* index, uint8_t slot);           // Remove key -> slot
+  void _linkPending(uint8_t slot);          // Insert in due order
+  void _unlinkPending(uint8_t slot);        // Remove from due order
+  void _removePending(uint8_t slot);        // Unlink and free slot
+  bool _publishPending(uint8_t slot);       // (Re)send message in slot
+  void _notifyDelivery(uint32_t msgId, bool success);
+  void _sendWithReliableDelivery(uint8_t pin, const char* value);  // Send with ACK tracking
+  bool _handlePacketAck(uint16_t packetId);                        // PUBACK for a pending message
+  bool _sendHeldBack();                                            // Oldest message the window held back
+  bool _reliableWaiting();                                         // Held-back messages on this client
+  static void _mqttAckWrapper(void* context, uint16_t packetId);
+  bool _beginDataPublish(const char* topic, size_t length, bool retain);
+  
+  // Network task internal methods
+  #if VWIRE_HAS_NET_TASK
+  bool _netPosting() { return _netTask && xTaskGetCurrentTaskHandle() != _netTask; }
+  bool _netQueuesCommands() { return _netTask && _netDispatch == VWIRE_DISPATCH_LOOP; }
+  bool _netPost(uint8_t type, uint8_t pin, const char* data, size_t len, uint32_t stamp = 0);
+  void _netDrainOutbox();                   // On the task: run queued calls
+  void _netDrainInbox();                    // In run(): run queued handlers
+  static void _netTaskEntry(void* arg);
+  #else
+  bool _netPosting() { return false; }
+  bool _netQueuesCommands() { return false; }
+  bool _netPost(uint8_t, uint8_t, const char*, size_t, uint32_t = 0) { return false; }
+  #endif
+  void _notifyConnection(bool up);          // Connect/disconnect handlers (or queue them)
+  void _serviceConnected();                 // Per-device work while connected
+  void _connectionLost();                   // State + handlers, for attached devices too
+  void _flushForSleep();
+  void _publishSleeping(unsigned long ms);
+  bool _recordAt(uint8_t pin, float value, unsigned long now);
 };
 
 // =============================================================================
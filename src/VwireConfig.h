@@ -115,6 +115,45 @@ typedef enum {
   VWIRE_TRANSPORT_TCP_SSL = 1    ///< MQTT over TLS (port 8883) - RECOMMENDED
 } VwireTransport;
 
+/**
+ * @brief Payload encoding for device-to-server messages
+ */
+typedef enum {
+  VWIRE_ENCODING_TEXT = 0,       ///< Decimal text / JSON payloads (default)
+  VWIRE_ENCODING_BINARY = 1      ///< Compact TLV frames on vwire/<id>/bin (negotiated)
+} VwireEncoding;
+
+// Binary (TLV) wire format - all multi-byte fields little-endian
+#define VWIRE_TLV_INT8              0x01   ///< 1-byte signed integer
+#define VWIRE_TLV_INT32             0x02   ///< 4-byte signed integer
+#define VWIRE_TLV_FLOAT32           0x03   ///< 4-byte IEEE 754 float
+#define VWIRE_TLV_TEXT              0x04   ///< 1-byte length + bytes
+
+#define VWIRE_FRAME_PINS            0x10   ///< [pin][tlv]... (single value or batch)
+#define VWIRE_FRAME_RELIABLE        0x11   ///< [msgId u32][pin][tlv]
+#define VWIRE_FRAME_HEARTBEAT       0x12   ///< [uptime u32][heap u32][rssi i8]
+#define VWIRE_FRAME_ACK             0x20   ///< [msgId u32][ok u8] (server -> device)
+#define VWIRE_FRAME_ACK_CUMULATIVE  0x21   ///< [upTo u32][mask u32] (server -> device)
+
+/** @brief Encoding version requested on vwire/<id>/enc/req and confirmed on vwire/<id>/enc */
+#define VWIRE_BINARY_PROTOCOL "tlv1"
+
+/**
+ * @brief How the server acknowledges reliable delivery messages
+ */
+typedef enum {
+  VWIRE_ACK_PER_MESSAGE = 0,     ///< One {"msgId":"N","ok":true} per data message (default)
+  VWIRE_ACK_CUMULATIVE = 1       ///< {"upTo":N,"mask":M} acknowledges a whole window at once
+} VwireAckMode;
+
+/**
+ * @brief Where inbound commands run when the network task is active
+ */
+typedef enum {
+  VWIRE_DISPATCH_LOOP = 0,       ///< Handed to run() in the application loop (default)
+  VWIRE_DISPATCH_NETWORK = 1     ///< Called on the network task (keep handlers short)
+} VwireDispatch;
+
 // =============================================================================
 // VIRTUAL PIN LIMITS
 // =============================================================================
@@ -122,15 +161,107 @@ typedef enum {
 /** @brief Maximum virtual pin number (0-127 supported) */
 #define VWIRE_MAX_VIRTUAL_PINS 128
 
+/** @brief Inline VirtualPin storage - numbers and shorter strings never allocate */
+#ifndef VWIRE_VPIN_BUFFER_SIZE
+  #define VWIRE_VPIN_BUFFER_SIZE 24
+#endif
+
 /** @brief Maximum number of manually registered handlers */
 #define VWIRE_MAX_HANDLERS 32
 
+/** @brief Maximum number of manually registered read handlers (onVirtualRead()) */
+#ifndef VWIRE_MAX_READ_HANDLERS
+  #define VWIRE_MAX_READ_HANDLERS 16
+#endif
+
 /** @brief Maximum auth token length */
 #define VWIRE_MAX_TOKEN_LENGTH 64
 
 /** @brief Maximum server hostname length */
 #define VWIRE_MAX_SERVER_LENGTH 64
 
+/** @brief Maximum topic prefix length ("vwire/" + device ID + "/") */
+#define VWIRE_MAX_TOPIC_PREFIX_LENGTH (VWIRE_MAX_TOKEN_LENGTH + 8)
+
+/** @brief Maximum outgoing topic length (prefix + type + "/V<pin>") */
+#define VWIRE_MAX_TOPIC_LENGTH (VWIRE_MAX_TOPIC_PREFIX_LENGTH + 24)
+
+/** @brief Room for the preformatted session setup packets (status, up to 6 subscriptions, 2 requests) */
+#define VWIRE_SESSION_BUFFER_SIZE (9 * VWIRE_MAX_TOPIC_PREFIX_LENGTH + 200)
+
+/** @brief First packet ID used by the session setup SUBSCRIBEs (kept clear of publish IDs) */
+#define VWIRE_SESSION_PACKET_ID 0xFF00
+
+/** @brief Maximum VwireClass instances (devices) in one sketch, including attached ones */
+#ifndef VWIRE_MAX_DEVICES
+  #define VWIRE_MAX_DEVICES 8
+#endif
+
+/** @brief Maximum number of pins with a publish policy (deadband, on-change, interval) */
+#ifndef VWIRE_MAX_PUBLISH_POLICIES
+  #define VWIRE_MAX_PUBLISH_POLICIES 16
+#endif
+
+/** @brief Longest value setPublishInterval() holds back for later (longer ones are dropped) */
+#ifndef VWIRE_POLICY_VALUE_LENGTH
+  #define VWIRE_POLICY_VALUE_LENGTH 32
+#endif
+
+/** @brief Maximum number of pins that answer read requests from a cache (setReadCache()) */
+#ifndef VWIRE_MAX_READ_CACHES
+  #define VWIRE_MAX_READ_CACHES 8
+#endif
+
+/** @brief Longest value a read cache keeps - longer values are not cached */
+#ifndef VWIRE_READ_CACHE_LENGTH
+  #define VWIRE_READ_CACHE_LENGTH 32
+#endif
+
+/** @brief Maximum number of pins whose commands are coalesced (setCoalesce()) */
+#ifndef VWIRE_MAX_COALESCED_PINS
+  #define VWIRE_MAX_COALESCED_PINS 8
+#endif
+
+/** @brief Room for a held command value - longer commands run the handler directly */
+#ifndef VWIRE_COALESCE_VALUE_LENGTH
+  #define VWIRE_COALESCE_VALUE_LENGTH VWIRE_VPIN_BUFFER_SIZE
+#endif
+
+#if VWIRE_COALESCE_VALUE_LENGTH < 2 || VWIRE_COALESCE_VALUE_LENGTH > 256
+  #error "VWIRE_COALESCE_VALUE_LENGTH must be between 2 and 256"
+#endif
+
+/** @brief Publish queue slots (one per pin with an unsent value) when setPublishRate() is used */
+#ifndef VWIRE_PUBLISH_QUEUE_SIZE
+  #define VWIRE_PUBLISH_QUEUE_SIZE 16
+#endif
+
+/** @brief Longest value held in a publish queue slot (longer values are sent immediately) */
+#ifndef VWIRE_QUEUE_VALUE_LENGTH
+  #define VWIRE_QUEUE_VALUE_LENGTH 32
+#endif
+
+/** @brief Batch payload buffer used by beginBatch()/flushBatch() */
+#ifndef VWIRE_BATCH_BUFFER_SIZE
+  #define VWIRE_BATCH_BUFFER_SIZE VWIRE_JSON_BUFFER_SIZE
+#endif
+
+/**
+ * @brief Library-owned scratch arena (bytes)
+ * 
+ * Shared by inbound payloads that must outlive a publish (long command
+ * values, raw onMessage() handlers) and outbound formatting such as the
+ * offline backlog. Allocations nest, so a handler that sends while its
+ * command is still in scratch gets the space after it.
+ */
+#ifndef VWIRE_SCRATCH_SIZE
+  #define VWIRE_SCRATCH_SIZE VWIRE_JSON_BUFFER_SIZE
+#endif
+
+#if VWIRE_SCRATCH_SIZE < 64
+  #error "VWIRE_SCRATCH_SIZE must be at least 64"
+#endif
+
 // =============================================================================
 // TIMING CONFIGURATION
 // =============================================================================
@@ -147,6 +278,46 @@ typedef enum {
 /** @brief Default MQTT connection timeout (10 seconds) */
 #define VWIRE_DEFAULT_MQTT_TIMEOUT 10000
 
+/** @brief Default upper bound for retry/reconnect backoff (5 minutes) */
+#define VWIRE_DEFAULT_MAX_BACKOFF 300000
+
+/** @brief Default lifetime of the cached broker address (1 hour, 0 = resolve on every connect) */
+#define VWIRE_DEFAULT_DNS_CACHE_TTL 3600000
+
+/**
+ * @brief Connection cache can survive deep sleep in RTC memory
+ * 
+ * Holds the resolved broker address, the (ESP8266) TLS session and the
+ * sleepFor() resume state, see saveConnectionCache(). ESP32 uses
+ * RTC_DATA_ATTR, ESP8266 RTC user memory.
+ */
+#ifndef VWIRE_HAS_RTC_CACHE
+  #if defined(VWIRE_BOARD_ESP32) || defined(VWIRE_BOARD_ESP8266)
+    #define VWIRE_HAS_RTC_CACHE 1
+  #else
+    #define VWIRE_HAS_RTC_CACHE 0
+  #endif
+#endif
+
+/** @brief Longest sleepFor() waits for outstanding ACKs before sleeping (ms) */
+#ifndef VWIRE_SLEEP_FLUSH_TIMEOUT
+  #define VWIRE_SLEEP_FLUSH_TIMEOUT 500
+#endif
+
+/** @brief Time allowed for the channel/BSSID fast join after wake before scanning (ms) */
+#ifndef VWIRE_FAST_JOIN_TIMEOUT
+  #define VWIRE_FAST_JOIN_TIMEOUT 3000
+#endif
+
+/**
+ * @brief First ESP8266 RTC user memory block (4 bytes each) used by the cache
+ * 
+ * The first 32 blocks are reserved for the OTA bootloader.
+ */
+#ifndef VWIRE_RTC_CACHE_OFFSET
+  #define VWIRE_RTC_CACHE_OFFSET 32
+#endif
+
 // =============================================================================
 // RELIABLE DELIVERY CONFIGURATION
 // =============================================================================
@@ -157,8 +328,262 @@ typedef enum {
 /** @brief Default maximum retry attempts */
 #define VWIRE_DEFAULT_MAX_RETRIES 3
 
-/** @brief Maximum queued messages (memory constraint) */
-#define VWIRE_MAX_PENDING_MESSAGES 10
+/**
+ * @brief Maximum in-flight reliable messages (memory constraint)
+ * 
+ * Each slot costs ~80 bytes. Override per deployment with a build flag,
+ * e.g. -DVWIRE_MAX_PENDING_MESSAGES=100 (maximum 254).
+ */
+#ifndef VWIRE_MAX_PENDING_MESSAGES
+  #if defined(VWIRE_BOARD_ESP32)
+    #define VWIRE_MAX_PENDING_MESSAGES 64
+  #elif defined(VWIRE_BOARD_ESP8266)
+    #define VWIRE_MAX_PENDING_MESSAGES 16
+  #else
+    #define VWIRE_MAX_PENDING_MESSAGES 10
+  #endif
+#endif
+
+#if VWIRE_MAX_PENDING_MESSAGES < 1 || VWIRE_MAX_PENDING_MESSAGES > 254
+  #error "VWIRE_MAX_PENDING_MESSAGES must be between 1 and 254"
+#endif
+
+// =============================================================================
+// TIME-SERIES RECORDING CONFIGURATION
+// =============================================================================
+
+/** @brief Pins that can hold a record() buffer at the same time */
+#ifndef VWIRE_MAX_SERIES
+  #define VWIRE_MAX_SERIES 4
+#endif
+
+/** @brief Shared sample arena for all record() buffers (6 bytes per sample) */
+#ifndef VWIRE_SERIES_ARENA_SIZE
+  #if defined(VWIRE_BOARD_ESP32)
+    #define VWIRE_SERIES_ARENA_SIZE 3072
+  #elif defined(VWIRE_BOARD_ESP8266)
+    #define VWIRE_SERIES_ARENA_SIZE 1536
+  #else
+    #define VWIRE_SERIES_ARENA_SIZE 192
+  #endif
+#endif
+
+/** @brief Samples per pin when record() is used without setSeries() */
+#ifndef VWIRE_SERIES_DEFAULT_SAMPLES
+  #define VWIRE_SERIES_DEFAULT_SAMPLES 32
+#endif
+
+/** @brief Default longest time a sample waits in a record() buffer (10 seconds) */
+#define VWIRE_SERIES_DEFAULT_MAX_AGE 10000
+
+// =============================================================================
+// OFFLINE BUFFER CONFIGURATION
+// =============================================================================
+
+/**
+ * @brief Flash-backed offline log available (LittleFS)
+ * 
+ * ESP32 and ESP8266 cores ship LittleFS. Define as 0 to drop the dependency;
+ * enableOfflineLog() then falls back to RAM.
+ */
+#ifndef VWIRE_HAS_LITTLEFS
+  #if defined(VWIRE_BOARD_ESP32) || defined(VWIRE_BOARD_ESP8266)
+    #define VWIRE_HAS_LITTLEFS 1
+  #else
+    #define VWIRE_HAS_LITTLEFS 0
+  #endif
+#endif
+
+/** @brief Longest value kept per offline record (longer values are truncated) */
+#ifndef VWIRE_OFFLINE_VALUE_LENGTH
+  #define VWIRE_OFFLINE_VALUE_LENGTH 32
+#endif
+
+/** @brief Flash segment files in the offline ring (oldest is recycled when all are full) */
+#ifndef VWIRE_OFFLINE_SEGMENTS
+  #define VWIRE_OFFLINE_SEGMENTS 8
+#endif
+
+/** @brief Records per flash segment file (~44 bytes each) */
+#ifndef VWIRE_OFFLINE_SEGMENT_RECORDS
+  #define VWIRE_OFFLINE_SEGMENT_RECORDS 128
+#endif
+
+/** @brief Records held by the RAM fallback (allocated only when enabled) */
+#ifndef VWIRE_OFFLINE_RAM_RECORDS
+  #if defined(VWIRE_BOARD_ESP32)
+    #define VWIRE_OFFLINE_RAM_RECORDS 128
+  #elif defined(VWIRE_BOARD_ESP8266)
+    #define VWIRE_OFFLINE_RAM_RECORDS 32
+  #else
+    #define VWIRE_OFFLINE_RAM_RECORDS 16
+  #endif
+#endif
+
+/** @brief Directory holding the flash segment files */
+#ifndef VWIRE_OFFLINE_DIR
+  #define VWIRE_OFFLINE_DIR "/vwire"
+#endif
+
+/** @brief Upper bound for records per backlog message (sizes a stack buffer in run()) */
+#ifndef VWIRE_OFFLINE_REPLAY_MAX
+  #define VWIRE_OFFLINE_REPLAY_MAX 16
+#endif
+
+/** @brief Default records replayed per message after reconnecting */
+#define VWIRE_DEFAULT_REPLAY_BATCH 8
+
+/** @brief Default pause between replayed batches (ms) */
+#define VWIRE_DEFAULT_REPLAY_INTERVAL 250
+
+#if VWIRE_OFFLINE_SEGMENTS < 2 || VWIRE_OFFLINE_SEGMENTS > 254
+  #error "VWIRE_OFFLINE_SEGMENTS must be between 2 and 254"
+#endif
+
+// =============================================================================
+// NETWORK TASK CONFIGURATION
+// =============================================================================
+
+/**
+ * @brief Library-owned network task available (startNetworkTask())
+ * 
+ * ESP32 only: PubSubClient, heartbeats, retries and reconnects run in a
+ * FreeRTOS task, and the application talks to it through two rings.
+ */
+#ifndef VWIRE_HAS_NET_TASK
+  #if defined(VWIRE_BOARD_ESP32)
+    #define VWIRE_HAS_NET_TASK 1
+  #else
+    #define VWIRE_HAS_NET_TASK 0
+  #endif
+#endif
+
+/** @brief Default core for the network task (Arduino's loop() runs on core 1) */
+#ifndef VWIRE_NET_TASK_CORE
+  #define VWIRE_NET_TASK_CORE 0
+#endif
+
+/** @brief Network task stack (bytes) - the TLS handshake needs most of it */
+#ifndef VWIRE_NET_TASK_STACK
+  #define VWIRE_NET_TASK_STACK 8192
+#endif
+
+/** @brief Network task priority (loop() runs at 1) */
+#ifndef VWIRE_NET_TASK_PRIORITY
+  #define VWIRE_NET_TASK_PRIORITY 1
+#endif
+
+/** @brief Records in each ring between the application and the network task (power of two) */
+#ifndef VWIRE_NET_QUEUE_SIZE
+  #define VWIRE_NET_QUEUE_SIZE 16
+#endif
+
+/** @brief Longest value carried by a ring record (longer sends fail with VWIRE_ERR_BUFFER_FULL) */
+#ifndef VWIRE_NET_VALUE_LENGTH
+  #define VWIRE_NET_VALUE_LENGTH 64
+#endif
+
+#if (VWIRE_NET_QUEUE_SIZE & (VWIRE_NET_QUEUE_SIZE - 1)) || VWIRE_NET_QUEUE_SIZE > 32768
+  #error "VWIRE_NET_QUEUE_SIZE must be a power of two"
+#endif
+
+// =============================================================================
+// MQTT ENGINE CONFIGURATION
+// =============================================================================
+
+/** @brief Most QoS 1 publishes VwireMqttClient keeps unacknowledged (setInflightWindow() up to this) */
+#ifndef VWIRE_MQTT_MAX_INFLIGHT
+  #define VWIRE_MQTT_MAX_INFLIGHT 16
+#endif
+
+/** @brief Most packets VwireMqttClient reads per loop() call */
+#ifndef VWIRE_MQTT_LOOP_PACKETS
+  #define VWIRE_MQTT_LOOP_PACKETS 8
+#endif
+
+#if VWIRE_MQTT_MAX_INFLIGHT < 1 || VWIRE_MQTT_MAX_INFLIGHT > 255
+  #error "VWIRE_MQTT_MAX_INFLIGHT must be between 1 and 255"
+#endif
+
+// =============================================================================
+// STATISTICS CONFIGURATION
+// =============================================================================
+
+/**
+ * @brief Built-in counters and timing histograms (getStats())
+ * 
+ * With 0 the counters, timers and their micros() calls are compiled out;
+ * getStats() then always reads zero.
+ */
+#ifndef VWIRE_ENABLE_STATS
+  #if defined(VWIRE_BOARD_ESP32) || defined(VWIRE_BOARD_ESP8266)
+    #define VWIRE_ENABLE_STATS 1
+  #else
+    #define VWIRE_ENABLE_STATS 0
+  #endif
+#endif
+
+/** @brief Histogram buckets - bucket i counts durations of 2^i to 2^(i+1) - 1 us, the last one everything longer */
+#ifndef VWIRE_STATS_BUCKETS
+  #define VWIRE_STATS_BUCKETS 20
+#endif
+
+/** @brief Room for the statistics object appended to heartbeats (setHeartbeatStats()) */
+#ifndef VWIRE_STATS_JSON_LENGTH
+  #define VWIRE_STATS_JSON_LENGTH 512
+#endif
+
+#if VWIRE_STATS_BUCKETS < 2 || VWIRE_STATS_BUCKETS > 32
+  #error "VWIRE_STATS_BUCKETS must be between 2 and 32"
+#endif
+
+// =============================================================================
+// CLOUD OTA CONFIGURATION
+// =============================================================================
+
+/**
+ * @brief Largest firmware chunk requested per message (enableCloudOTA())
+ * 
+ * The chunk actually requested is also limited by the MQTT buffer
+ * (VWIRE_MAX_PAYLOAD_LENGTH), leaving room for the topic and offset.
+ */
+#ifndef VWIRE_OTA_CHUNK_SIZE
+  #define VWIRE_OTA_CHUNK_SIZE 1024
+#endif
+
+/** @brief Chunks requested at once - the next request goes out when the last one arrived */
+#ifndef VWIRE_OTA_WINDOW
+  #define VWIRE_OTA_WINDOW 4
+#endif
+
+/** @brief Milliseconds without a chunk before the window is requested again */
+#ifndef VWIRE_OTA_CHUNK_TIMEOUT
+  #define VWIRE_OTA_CHUNK_TIMEOUT 5000
+#endif
+
+/** @brief Requests without progress before the update is abandoned */
+#ifndef VWIRE_OTA_MAX_RETRIES
+  #define VWIRE_OTA_MAX_RETRIES 5
+#endif
+
+/** @brief Stack buffer for copying running-image bytes into a delta-patched image */
+#ifndef VWIRE_OTA_COPY_BUFFER
+  #define VWIRE_OTA_COPY_BUFFER 256
+#endif
+
+/** @brief Longest update job ID kept from the announcement */
+#ifndef VWIRE_OTA_ID_LENGTH
+  #define VWIRE_OTA_ID_LENGTH 24
+#endif
+
+/** @brief Milliseconds between reporting a finished update and restarting into it */
+#ifndef VWIRE_OTA_RESTART_DELAY
+  #define VWIRE_OTA_RESTART_DELAY 1000
+#endif
+
+#if VWIRE_OTA_WINDOW < 1 || VWIRE_OTA_WINDOW > 64
+  #error "VWIRE_OTA_WINDOW must be between 1 and 64"
+#endif
 
 // =============================================================================
 // CONNECTION STATES
@@ -0,0 +1,177 @@
+/*
+ * Vwire IOT Arduino Library - MQTT Transport
+ * 
+ * Interface between VwireClass and the MQTT client underneath it, so the
+ * client can be swapped without touching the library:
+ * - VwirePubSubTransport wraps PubSubClient (the default, QoS 0 publishes)
+ * - VwireMqttClient (VwireMqttClient.h) is the built-in engine with native
+ *   QoS 1 publishes, PUBACK tracking and an inflight window
+ * 
+ * The calls mirror PubSubClient's, so an existing client is easy to wrap.
+ * Clients that can publish at QoS 1 also implement supportsQos1(),
+ * beginPublishQos1(), releasePacket() and setAckCallback(); reliable
+ * delivery then relies on PUBACK instead of its own ACK topic.
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_MQTT_H
+#define VWIRE_MQTT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <PubSubClient.h>
+#include "VwireConfig.h"
+
+/** @brief Called for every PUBLISH received (topic is NUL-terminated) */
+typedef void (*VwireMqttCallback)(char* topic, uint8_t* payload, unsigned int length);
+
+/** @brief Called when the broker acknowledges a QoS 1 publish (PUBACK) */
+typedef void (*VwireMqttAckCallback)(void* context, uint16_t packetId);
+
+/**
+ * @brief MQTT client used by VwireClass
+ * 
+ * Payloads are streamed: beginPublish() with the exact length, write()
+ * the bytes (it is a Print), then endPublish().
+ */
+class VwireMqttTransport : public Print {
+public:
+  virtual ~VwireMqttTransport() {}
+  
+  // Setup
+  virtual void setClient(Client& client) = 0;
+  virtual void setServer(const char* host, uint16_t port) = 0;
+  virtual void setCallback(VwireMqttCallback callback) = 0;
+  virtual bool setBufferSize(uint16_t size) = 0;
+  virtual uint16_t getBufferSize() = 0;
+  virtual void setKeepAlive(uint16_t seconds) = 0;
+  virtual void setSocketTimeout(uint16_t seconds) = 0;
+  
+  // Session
+  /**
+   * @brief Send CONNECT and wait for CONNACK
+   * @note Opens the socket itself only if the client is not connected yet
+   */
+  virtual bool connect(const char* id, const char* user, const char* pass,
+                       const char* willTopic, uint8_t willQos, bool willRetain,
+                       const char* willMessage) = 0;
+  virtual void disconnect() = 0;
+  virtual bool connected() = 0;
+  /** @brief Last state, PubSubClient's MQTT_* codes (0 = connected) */
+  virtual int state() = 0;
+  /** @brief Read incoming packets and keep the session alive */
+  virtual bool loop() = 0;
+  
+  // QoS 0 publishing
+  virtual bool publish(const char* topic, const char* payload) = 0;
+  virtual bool beginPublish(const char* topic, unsigned int length, bool retained) = 0;
+  virtual int endPublish() = 0;
+  
+  // Subscriptions
+  virtual bool subscribe(const char* topic, uint8_t qos) = 0;
+  virtual bool unsubscribe(const char* topic) = 0;
+  
+  /**
+   * @brief Write ready-made MQTT packets to the connection in one call
+   * @note Outside a publish, write() of both bundled clients goes straight
+   *       to the Client, which is all the default needs
+   */
+  virtual bool writePackets(const uint8_t* packets, size_t length) {
+    return connected() && write(packets, length) == length;
+  }
+  
+  /**
+   * @brief Check if the callback's payload may be NUL-terminated in place
+   * @param topic, payload, length As passed to the callback
+   * @return true if payload[length] is a spare byte of the client's own
+   *         buffer that VwireClass may overwrite; false (the default) makes
+   *         it copy the payload to its scratch arena instead
+   */
+  virtual bool payloadTerminable(const char* topic, const uint8_t* payload, unsigned int length) {
+    (void)topic; (void)payload; (void)length;
+    return false;
+  }
+  
+  // QoS 1 publishing - clients without it keep these defaults
+  /** @brief Check if beginPublishQos1() is available */
+  virtual bool supportsQos1() { return false; }
+  
+  /**
+   * @brief Start a QoS 1 publish (continue with write() and endPublish())
+   * @param packetId 0 for a new message, or the ID returned earlier to
+   *        retransmit it with the DUP flag
+   * @return Packet ID the PUBACK will carry, 0 if not connected or the
+   *         inflight window is full (nothing was written)
+   */
+  virtual uint16_t beginPublishQos1(const char* topic, unsigned int length, bool retained,
+                                    uint16_t packetId) {
+    (void)topic; (void)length; (void)retained; (void)packetId;
+    return 0;
+  }
+  
+  /** @brief Stop waiting for the PUBACK of a message that was given up */
+  virtual void releasePacket(uint16_t packetId) { (void)packetId; }
+  
+  /** @brief Set the PUBACK callback (context is passed back unchanged) */
+  virtual void setAckCallback(VwireMqttAckCallback callback, void* context) {
+    (void)callback; (void)context;
+  }
+};
+
+/**
+ * @brief VwireMqttTransport over PubSubClient (QoS 0 publishes only)
+ */
+class VwirePubSubTransport : public VwireMqttTransport {
+public:
+  explicit VwirePubSubTransport(Client& client) : _client(client) {}
+  
+  void setClient(Client& client) override { _client.setClient(client); }
+  void setServer(const char* host, uint16_t port) override { _client.setServer(host, port); }
+  void setCallback(VwireMqttCallback callback) override { _client.setCallback(callback); }
+  bool setBufferSize(uint16_t size) override { return _client.setBufferSize(size); }
+  uint16_t getBufferSize() override { return _client.getBufferSize(); }
+  void setKeepAlive(uint16_t seconds) override { _client.setKeepAlive(seconds); }
+  void setSocketTimeout(uint16_t seconds) override { _client.setSocketTimeout(seconds); }
+  
+  bool connect(const char* id, const char* user, const char* pass,
+               const char* willTopic, uint8_t willQos, bool willRetain,
+               const char* willMessage) override {
+    return _client.connect(id, user, pass, willTopic, willQos, willRetain, willMessage);
+  }
+  void disconnect() override { _client.disconnect(); }
+  bool connected() override { return _client.connected(); }
+  int state() override { return _client.state(); }
+  bool loop() override { return _client.loop(); }
+  
+  bool publish(const char* topic, const char* payload) override { return _client.publish(topic, payload); }
+  bool beginPublish(const char* topic, unsigned int length, bool retained) override {
+    return _client.beginPublish(topic, length, retained);
+  }
+  int endPublish() override { return _client.endPublish(); }
+  size_t write(uint8_t b) override { return _client.write(b); }
+  size_t write(const uint8_t* data, size_t size) override { return _client.write(data, size); }
+  
+  bool subscribe(const char* topic, uint8_t qos) override { return _client.subscribe(topic, qos); }
+  bool unsubscribe(const char* topic) override { return _client.unsubscribe(topic); }
+  
+  bool payloadTerminable(const char* topic, const uint8_t* payload, unsigned int length) override {
+    // PubSubClient hands out pointers into its receive buffer:
+    //   [header][remaining length, 1-4 bytes][topic\0][msgId (QoS 1)][payload]
+    // (the topic was already moved down a byte to terminate it). The byte
+    // after the payload is free unless the packet fills the whole buffer.
+    size_t remaining = (size_t)((const char*)payload + length - topic) + 1;
+    size_t lengthBytes = remaining < 128UL ? 1 : remaining < 16384UL ? 2 : remaining < 2097152UL ? 3 : 4;
+    return 1 + lengthBytes + remaining < _client.getBufferSize();
+  }
+  
+  /** @brief The wrapped PubSubClient */
+  PubSubClient& client() { return _client; }
+
+private:
+  PubSubClient _client;
+};
+
+#endif // VWIRE_MQTT_H
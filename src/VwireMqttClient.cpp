@@ -0,0 +1,476 @@
+/*
+ * Vwire IOT Arduino Library - MQTT Client Implementation
+ *
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#include "VwireMqttClient.h"
+
+// Control packet types (upper nibble), with the flags MQTT 3.1.1 requires
+#define VWIRE_MQTT_CONNECT      0x10
+#define VWIRE_MQTT_CONNACK      0x20
+#define VWIRE_MQTT_PUBLISH      0x30
+#define VWIRE_MQTT_PUBACK       0x40
+#define VWIRE_MQTT_SUBSCRIBE    0x82
+#define VWIRE_MQTT_SUBACK       0x90
+#define VWIRE_MQTT_UNSUBSCRIBE  0xA2
+#define VWIRE_MQTT_UNSUBACK     0xB0
+#define VWIRE_MQTT_PINGREQ      0xC0
+#define VWIRE_MQTT_PINGRESP     0xD0
+#define VWIRE_MQTT_DISCONNECT   0xE0
+
+// PUBLISH flags
+#define VWIRE_MQTT_FLAG_DUP     0x08
+#define VWIRE_MQTT_FLAG_QOS1    0x02
+#define VWIRE_MQTT_FLAG_RETAIN  0x01
+
+// Stack room for fixed header + topic + packet ID of one outgoing packet
+#define VWIRE_MQTT_HEADER_ROOM  128
+
+// Smallest receive buffer (CONNACK, PUBACK and short publishes)
+#define VWIRE_MQTT_MIN_BUFFER   16
+
+VwireMqttClient::VwireMqttClient()
+  : _client(nullptr)
+  , _host(nullptr)
+  , _port(1883)
+  , _buffer(nullptr)
+  , _bufferSize(0)
+  , _keepAlive(15)
+  , _socketTimeout(15)
+  , _state(MQTT_DISCONNECTED)
+  , _lastOut(0)
+  , _lastIn(0)
+  , _pingOutstanding(false)
+  , _nextPacketId(0)
+  , _inflightCount(0)
+  , _window(VWIRE_MQTT_MAX_INFLIGHT)
+  , _callback(nullptr)
+  , _ackCallback(nullptr)
+  , _ackContext(nullptr)
+{
+  memset(_inflightIds, 0, sizeof(_inflightIds));
+  setBufferSize(256);
+}
+
+VwireMqttClient::~VwireMqttClient() {
+  free(_buffer);
+}
+
+// =============================================================================
+// SETUP
+// =============================================================================
+void VwireMqttClient::setClient(Client& client) {
+  _client = &client;
+}
+
+void VwireMqttClient::setServer(const char* host, uint16_t port) {
+  _host = host;  // Kept, not copied - VwireClass passes its settings
+  _port = port;
+}
+
+void VwireMqttClient::setCallback(VwireMqttCallback callback) {
+  _callback = callback;
+}
+
+bool VwireMqttClient::setBufferSize(uint16_t size) {
+  if (size < VWIRE_MQTT_MIN_BUFFER) return false;
+  uint8_t* buffer = (uint8_t*)realloc(_buffer, size);
+  if (!buffer) return false;  // Keep the old buffer
+  _buffer = buffer;
+  _bufferSize = size;
+  return true;
+}
+
+void VwireMqttClient::setAckCallback(VwireMqttAckCallback callback, void* context) {
+  _ackCallback = callback;
+  _ackContext = context;
+}
+
+void VwireMqttClient::setInflightWindow(uint8_t window) {
+  _window = constrain(window, 1, VWIRE_MQTT_MAX_INFLIGHT);
+}
+
+// =============================================================================
+// SESSION
+// =============================================================================
+bool VwireMqttClient::connect(const char* id, const char* user, const char* pass,
+                              const char* willTopic, uint8_t willQos, bool willRetain,
+                              const char* willMessage) {
+  if (!_client) return false;
+  if (connected()) return true;
+
+  // VwireClass opens the (TLS) socket itself - only connect if it did not
+  if (!_client->connected() && (!_host || _client->connect(_host, _port) != 1)) {
+    _state = MQTT_CONNECT_FAILED;
+    return false;
+  }
+
+  // Payload strings in protocol order; the will message only goes with a will topic
+  const char* strings[5] = { id ? id : "", willTopic,
+                             willTopic ? (willMessage ? willMessage : "") : nullptr, user, pass };
+  uint8_t flags = 0x02;  // Clean session
+  if (willTopic) {
+    flags |= 0x04 | ((willQos & 0x03) << 3) | (willRetain ? 0x20 : 0);
+  }
+  if (user) flags |= 0x80;
+  if (pass) flags |= 0x40;
+
+  size_t length = 10;
+  for (uint8_t i = 0; i < 5; i++) {
+    if (strings[i]) length += 2 + strlen(strings[i]);
+  }
+  if (5 + length > _bufferSize) {
+    _state = MQTT_CONNECT_FAILED;
+    return false;
+  }
+
+  // Body first, 5 bytes in, then the fixed header right in front of it
+  uint8_t* body = _buffer + 5;
+  static const uint8_t protocol[7] = { 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04 };
+  memcpy(body, protocol, sizeof(protocol));
+  body[7] = flags;
+  body[8] = _keepAlive >> 8;
+  body[9] = _keepAlive & 0xFF;
+  size_t pos = 10;
+  for (uint8_t i = 0; i < 5; i++) {
+    if (!strings[i]) continue;
+    size_t n = strlen(strings[i]);
+    body[pos++] = n >> 8;
+    body[pos++] = n & 0xFF;
+    memcpy(body + pos, strings[i], n);
+    pos += n;
+  }
+
+  uint8_t header[5];
+  header[0] = VWIRE_MQTT_CONNECT;
+  size_t headerLen = 1 + _encodeLength(header + 1, length);
+  uint8_t* packet = body - headerLen;
+  memcpy(packet, header, headerLen);
+
+  _inflightCount = 0;
+  _pingOutstanding = false;
+  if (_client->write(packet, headerLen + length) != headerLen + length) {
+    _lost(MQTT_CONNECT_FAILED);
+    return false;
+  }
+
+  // CONNACK: [0x20][2][session present][return code]
+  uint8_t lengthBytes;
+  uint32_t remaining;
+  bool fits;
+  if (!_readPacket(&lengthBytes, &remaining, &fits)) {
+    _lost(MQTT_CONNECTION_TIMEOUT);
+    return false;
+  }
+  if (!fits || (_buffer[0] & 0xF0) != VWIRE_MQTT_CONNACK || remaining != 2) {
+    _lost(MQTT_CONNECT_FAILED);
+    return false;
+  }
+  uint8_t code = _buffer[1 + lengthBytes + 1];
+  if (code != 0) {
+    _lost(code);  // MQTT_CONNECT_BAD_PROTOCOL .. MQTT_CONNECT_UNAUTHORIZED
+    return false;
+  }
+
+  _state = MQTT_CONNECTED;
+  _lastIn = _lastOut = millis();
+  _nextPacketId = 0;  // New session - IDs start over, clear of VWIRE_SESSION_PACKET_ID
+  return true;
+}
+
+void VwireMqttClient::disconnect() {
+  if (_client) {
+    if (_state == MQTT_CONNECTED && _client->connected()) {
+      const uint8_t packet[2] = { VWIRE_MQTT_DISCONNECT, 0 };
+      _client->write(packet, sizeof(packet));
+    }
+    _client->stop();
+  }
+  _state = MQTT_DISCONNECTED;
+  _inflightCount = 0;
+  _pingOutstanding = false;
+}
+
+bool VwireMqttClient::connected() {
+  if (!_client) return false;
+  if (_state != MQTT_CONNECTED) return false;
+  if (!_client->connected()) {
+    _lost(MQTT_CONNECTION_LOST);
+    return false;
+  }
+  return true;
+}
+
+void VwireMqttClient::_lost(int state) {
+  _state = state;
+  _client->stop();
+  _inflightCount = 0;  // Clean session - nothing survives the connection
+  _pingOutstanding = false;
+}
+
+bool VwireMqttClient::loop() {
+  if (!connected()) return false;
+
+  // Keepalive: ping after a quiet interval, give up if the next one passes too
+  unsigned long now = millis();
+  unsigned long interval = _keepAlive * 1000UL;
+  if (interval && (now - _lastIn > interval || now - _lastOut > interval)) {
+    if (_pingOutstanding) {
+      _lost(MQTT_CONNECTION_TIMEOUT);
+      return false;
+    }
+    const uint8_t ping[2] = { VWIRE_MQTT_PINGREQ, 0 };
+    _client->write(ping, sizeof(ping));
+    _lastIn = _lastOut = now;
+    _pingOutstanding = true;
+  }
+
+  for (uint8_t n = 0; n < VWIRE_MQTT_LOOP_PACKETS && _client->available(); n++) {
+    uint8_t lengthBytes;
+    uint32_t remaining;
+    bool fits;
+    if (!_readPacket(&lengthBytes, &remaining, &fits)) {
+      _lost(MQTT_CONNECTION_LOST);
+      return false;
+    }
+    _lastIn = millis();
+    _pingOutstanding = false;  // Anything from the broker proves the link
+    if (fits) _handlePacket(lengthBytes, remaining);
+    if (_state != MQTT_CONNECTED) return false;  // A handler disconnected
+  }
+  return true;
+}
+
+// =============================================================================
+// RECEIVING
+// =============================================================================
+bool VwireMqttClient::_readByte(uint8_t* out) {
+  unsigned long start = millis();
+  while (!_client->available()) {
+    if (millis() - start >= _socketTimeout * 1000UL || !_client->connected()) return false;
+    yield();
+  }
+  int c = _client->read();
+  if (c < 0) return false;
+  *out = c;
+  return true;
+}
+
+bool VwireMqttClient::_readPacket(uint8_t* lengthBytes, uint32_t* remaining, bool* fits) {
+  if (!_readByte(&_buffer[0])) return false;
+
+  // Remaining length: 1-4 bytes, 7 bits each
+  uint32_t length = 0;
+  uint8_t n = 0;
+  uint8_t digit;
+  do {
+    if (n == 4 || !_readByte(&digit)) return false;
+    _buffer[1 + n] = digit;
+    length |= (uint32_t)(digit & 0x7F) << (7 * n);
+    n++;
+  } while (digit & 0x80);
+
+  *lengthBytes = n;
+  *remaining = length;
+  *fits = 1 + n + length <= _bufferSize;
+
+  // Too large for the buffer: drain it so the stream stays in sync
+  uint8_t* dest = *fits ? _buffer + 1 + n : nullptr;
+  uint8_t sink;
+  for (uint32_t i = 0; i < length; i++) {
+    if (!_readByte(dest ? dest + i : &sink)) return false;
+  }
+  return true;
+}
+
+void VwireMqttClient::_handlePacket(uint8_t lengthBytes, uint32_t remaining) {
+  uint8_t header = _buffer[0];
+  uint8_t* body = _buffer + 1 + lengthBytes;
+
+  switch (header & 0xF0) {
+    case VWIRE_MQTT_PUBLISH: {
+      if (remaining < 2) break;
+      uint16_t topicLen = (body[0] << 8) | body[1];
+      uint8_t qos = (header >> 1) & 0x03;
+      size_t offset = 2 + topicLen + (qos ? 2 : 0);
+      if (offset > remaining) break;
+      uint16_t msgId = qos ? (body[2 + topicLen] << 8) | body[3 + topicLen] : 0;
+
+      // Move the topic down a byte to terminate it, as PubSubClient does
+      char* topic = (char*)body + 1;
+      memmove(topic, body + 2, topicLen);
+      topic[topicLen] = '\0';
+
+      if (_callback) _callback(topic, body + offset, remaining - offset);
+      if (qos == 1 && connected()) _sendIdPacket(VWIRE_MQTT_PUBACK, msgId);
+      break;
+    }
+
+    case VWIRE_MQTT_PUBACK: {
+      if (remaining < 2) break;
+      uint16_t packetId = (body[0] << 8) | body[1];
+      int index = _findInflight(packetId);
+      if (index < 0) break;  // Released or duplicate
+      _dropInflight(index);
+      if (_ackCallback) _ackCallback(_ackContext, packetId);
+      break;
+    }
+
+    case VWIRE_MQTT_PINGREQ: {
+      const uint8_t pong[2] = { VWIRE_MQTT_PINGRESP, 0 };
+      _client->write(pong, sizeof(pong));
+      break;
+    }
+
+    default:
+      break;  // PINGRESP, SUBACK, UNSUBACK - nothing to do
+  }
+}
+
+// =============================================================================
+// PUBLISHING
+// =============================================================================
+bool VwireMqttClient::publish(const char* topic, const char* payload) {
+  size_t length = strlen(payload);
+  if (!beginPublish(topic, length, false)) return false;
+  return write((const uint8_t*)payload, length) == length;
+}
+
+bool VwireMqttClient::beginPublish(const char* topic, unsigned int length, bool retained) {
+  return _beginPublish(topic, length, retained, 0, 0, false);
+}
+
+uint16_t VwireMqttClient::beginPublishQos1(const char* topic, unsigned int length, bool retained,
+                                           uint16_t packetId) {
+  if (!connected()) return 0;
+
+  // A known ID is a retransmission; anything else needs room in the window
+  bool dup = packetId && _findInflight(packetId) >= 0;
+  if (!dup) {
+    if (_inflightCount >= _window) return 0;
+    packetId = _allocPacketId();
+    _inflightIds[_inflightCount++] = packetId;
+  }
+
+  if (!_beginPublish(topic, length, retained, 1, packetId, dup)) {
+    if (!dup) _inflightCount--;
+    return 0;
+  }
+  return packetId;
+}
+
+bool VwireMqttClient::_beginPublish(const char* topic, unsigned int length, bool retained,
+                                    uint8_t qos, uint16_t packetId, bool dup) {
+  if (!connected()) return false;
+  size_t topicLen = strlen(topic);
+  if (topicLen + 9 > VWIRE_MQTT_HEADER_ROOM) return false;
+
+  // Fixed header, topic and packet ID in one write; the payload follows
+  uint8_t head[VWIRE_MQTT_HEADER_ROOM];
+  head[0] = VWIRE_MQTT_PUBLISH | (dup ? VWIRE_MQTT_FLAG_DUP : 0) |
+            (qos ? VWIRE_MQTT_FLAG_QOS1 : 0) | (retained ? VWIRE_MQTT_FLAG_RETAIN : 0);
+  size_t n = 1 + _encodeLength(head + 1, 2 + topicLen + (qos ? 2 : 0) + length);
+  head[n++] = topicLen >> 8;
+  head[n++] = topicLen & 0xFF;
+  memcpy(head + n, topic, topicLen);
+  n += topicLen;
+  if (qos) {
+    head[n++] = packetId >> 8;
+    head[n++] = packetId & 0xFF;
+  }
+
+  _lastOut = millis();
+  return _client->write(head, n) == n;
+}
+
+int VwireMqttClient::endPublish() {
+  return 1;  // Nothing buffered - the payload is already with the client
+}
+
+size_t VwireMqttClient::write(uint8_t b) {
+  return _client ? _client->write(b) : 0;
+}
+
+size_t VwireMqttClient::write(const uint8_t* data, size_t size) {
+  return _client ? _client->write(data, size) : 0;
+}
+
+bool VwireMqttClient::writePackets(const uint8_t* packets, size_t length) {
+  if (!connected()) return false;
+  _lastOut = millis();
+  return _client->write(packets, length) == length;
+}
+
+void VwireMqttClient::releasePacket(uint16_t packetId) {
+  int index = _findInflight(packetId);
+  if (index >= 0) _dropInflight(index);
+}
+
+uint16_t VwireMqttClient::_allocPacketId() {
+  do {
+    if (++_nextPacketId == 0) _nextPacketId = 1;  // 0 is not a valid ID
+  } while (_findInflight(_nextPacketId) >= 0);
+  return _nextPacketId;
+}
+
+int VwireMqttClient::_findInflight(uint16_t packetId) {
+  for (uint8_t i = 0; i < _inflightCount; i++) {
+    if (_inflightIds[i] == packetId) return i;
+  }
+  return -1;
+}
+
+void VwireMqttClient::_dropInflight(int index) {
+  _inflightIds[index] = _inflightIds[--_inflightCount];
+}
+
+// =============================================================================
+// SUBSCRIPTIONS
+// =============================================================================
+bool VwireMqttClient::subscribe(const char* topic, uint8_t qos) {
+  return _sendTopicPacket(VWIRE_MQTT_SUBSCRIBE, _allocPacketId(), topic, qos > 1 ? 1 : qos);
+}
+
+bool VwireMqttClient::unsubscribe(const char* topic) {
+  return _sendTopicPacket(VWIRE_MQTT_UNSUBSCRIBE, _allocPacketId(), topic, -1);
+}
+
+bool VwireMqttClient::_sendTopicPacket(uint8_t header, uint16_t packetId, const char* topic, int qos) {
+  if (!connected()) return false;
+  size_t topicLen = strlen(topic);
+  if (topicLen + 10 > VWIRE_MQTT_HEADER_ROOM) return false;
+
+  // [packet ID][topic][requested QoS (SUBSCRIBE only)]
+  uint8_t head[VWIRE_MQTT_HEADER_ROOM];
+  head[0] = header;
+  size_t n = 1 + _encodeLength(head + 1, 2 + 2 + topicLen + (qos >= 0 ? 1 : 0));
+  head[n++] = packetId >> 8;
+  head[n++] = packetId & 0xFF;
+  head[n++] = topicLen >> 8;
+  head[n++] = topicLen & 0xFF;
+  memcpy(head + n, topic, topicLen);
+  n += topicLen;
+  if (qos >= 0) head[n++] = qos;
+
+  _lastOut = millis();
+  return _client->write(head, n) == n;
+}
+
+bool VwireMqttClient::_sendIdPacket(uint8_t header, uint16_t packetId) {
+  const uint8_t packet[4] = { header, 2, (uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF) };
+  _lastOut = millis();
+  return _client->write(packet, sizeof(packet)) == sizeof(packet);
+}
+
+size_t VwireMqttClient::_encodeLength(uint8_t* out, uint32_t length) {
+  size_t n = 0;
+  do {
+    uint8_t digit = length & 0x7F;
+    length >>= 7;
+    out[n++] = digit | (length ? 0x80 : 0);
+  } while (length && n < 4);
+  return n;
+}
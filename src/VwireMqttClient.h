@@ -0,0 +1,118 @@
+/*
+ * Vwire IOT Arduino Library - MQTT Client
+ * 
+ * Small MQTT 3.1.1 client built into the library, for use behind
+ * VwireClass::setMqttTransport(). Next to what PubSubClient offers it
+ * publishes at QoS 1 natively:
+ * - Packet IDs are allocated here and tracked until the PUBACK arrives
+ * - At most setInflightWindow() QoS 1 publishes are unacknowledged at once
+ * - A retransmission reuses the packet ID with the DUP flag set
+ * - PUBACKs are reported through the ack callback
+ * 
+ * Receive-buffer layout matches PubSubClient's, so VwireClass can use
+ * the payload in place:
+ *   [header][remaining length, 1-4 bytes][topic\0][msgId (QoS 1)][payload]
+ * Publishing never touches that buffer (headers are built on the stack).
+ * 
+ * Retries stay with the caller: the session is clean, and everything in
+ * flight is forgotten when the connection drops.
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_MQTT_CLIENT_H
+#define VWIRE_MQTT_CLIENT_H
+
+#include "VwireMqtt.h"
+
+/**
+ * @brief Built-in MQTT 3.1.1 client with QoS 1 publishing
+ */
+class VwireMqttClient : public VwireMqttTransport {
+public:
+  VwireMqttClient();
+  ~VwireMqttClient();
+  
+  void setClient(Client& client) override;
+  void setServer(const char* host, uint16_t port) override;
+  void setCallback(VwireMqttCallback callback) override;
+  bool setBufferSize(uint16_t size) override;
+  uint16_t getBufferSize() override { return _bufferSize; }
+  void setKeepAlive(uint16_t seconds) override { _keepAlive = seconds; }
+  void setSocketTimeout(uint16_t seconds) override { _socketTimeout = seconds; }
+  
+  bool connect(const char* id, const char* user, const char* pass,
+               const char* willTopic, uint8_t willQos, bool willRetain,
+               const char* willMessage) override;
+  void disconnect() override;
+  bool connected() override;
+  int state() override { return _state; }
+  bool loop() override;
+  
+  bool publish(const char* topic, const char* payload) override;
+  bool beginPublish(const char* topic, unsigned int length, bool retained) override;
+  int endPublish() override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* data, size_t size) override;
+  bool writePackets(const uint8_t* packets, size_t length) override;
+  bool payloadTerminable(const char* topic, const uint8_t* payload, unsigned int length) override {
+    // Payloads point into the receive buffer; the packet fills it at most
+    (void)topic;
+    return payload >= _buffer && payload + length < _buffer + _bufferSize;
+  }
+  
+  bool subscribe(const char* topic, uint8_t qos) override;
+  bool unsubscribe(const char* topic) override;
+  
+  bool supportsQos1() override { return true; }
+  uint16_t beginPublishQos1(const char* topic, unsigned int length, bool retained,
+                            uint16_t packetId) override;
+  void releasePacket(uint16_t packetId) override;
+  void setAckCallback(VwireMqttAckCallback callback, void* context) override;
+  
+  /**
+   * @brief Limit unacknowledged QoS 1 publishes
+   * @param window 1 to VWIRE_MQTT_MAX_INFLIGHT (default)
+   */
+  void setInflightWindow(uint8_t window);
+  
+  /** @brief QoS 1 publishes waiting for their PUBACK */
+  uint8_t inflight() const { return _inflightCount; }
+
+private:
+  Client* _client;
+  const char* _host;
+  uint16_t _port;
+  uint8_t* _buffer;                      ///< Receive buffer (CONNECT is built here too)
+  uint16_t _bufferSize;
+  uint16_t _keepAlive;                   ///< Seconds
+  uint16_t _socketTimeout;               ///< Seconds
+  int _state;
+  unsigned long _lastOut;                ///< Last packet sent (keepalive)
+  unsigned long _lastIn;                 ///< Last packet received (keepalive)
+  bool _pingOutstanding;
+  uint16_t _nextPacketId;
+  uint16_t _inflightIds[VWIRE_MQTT_MAX_INFLIGHT];
+  uint8_t _inflightCount;
+  uint8_t _window;
+  VwireMqttCallback _callback;
+  VwireMqttAckCallback _ackCallback;
+  void* _ackContext;
+  
+  uint16_t _allocPacketId();
+  int _findInflight(uint16_t packetId);
+  void _dropInflight(int index);
+  bool _beginPublish(const char* topic, unsigned int length, bool retained,
+                     uint8_t qos, uint16_t packetId, bool dup);
+  bool _sendIdPacket(uint8_t header, uint16_t packetId);
+  bool _sendTopicPacket(uint8_t header, uint16_t packetId, const char* topic, int qos);
+  bool _readByte(uint8_t* out);
+  bool _readPacket(uint8_t* lengthBytes, uint32_t* remaining, bool* fits);
+  void _handlePacket(uint8_t lengthBytes, uint32_t remaining);
+  void _lost(int state);
+  static size_t _encodeLength(uint8_t* out, uint32_t length);
+};
+
+#endif // VWIRE_MQTT_CLIENT_H
@@ -0,0 +1,408 @@
+/*
+ * Vwire IOT Arduino Library - Offline Log Implementation
+ *
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#include "VwireOfflineLog.h"
+
+#if VWIRE_HAS_LITTLEFS
+  #include <LittleFS.h>
+#endif
+
+#define VWIRE_SEG_NONE 0xFF
+#define VWIRE_SEG_HEADER sizeof(uint32_t)
+
+// =============================================================================
+// CONSTRUCTOR
+// =============================================================================
+
+VwireOfflineLog::VwireOfflineLog()
+  : _enabled(false)
+  , _useFlash(false)
+  , _count(0)
+  , _dropped(0)
+  , _nextSeq(1)
+  , _bootSeq(1)
+  , _ram(nullptr)
+  , _ramHead(0)
+  , _nextGen(1)
+  , _readSeg(VWIRE_SEG_NONE)
+  , _readPos(0)
+  , _writeSeg(VWIRE_SEG_NONE)
+  , _writeSealed(false)
+{
+  memset(_segGen, 0, sizeof(_segGen));
+  memset(_segCount, 0, sizeof(_segCount));
+}
+
+VwireOfflineLog::~VwireOfflineLog() {
+  end();
+}
+
+// =============================================================================
+// OPEN / CLOSE
+// =============================================================================
+
+bool VwireOfflineLog::begin(bool useFlash) {
+  if (_enabled) end();
+  _count = 0;
+  _dropped = 0;
+
+#if VWIRE_HAS_LITTLEFS
+  if (useFlash && _openFlash()) {
+    _useFlash = true;
+    _enabled = true;
+    _bootSeq = _nextSeq;
+    return true;
+  }
+#else
+  (void)useFlash;
+#endif
+
+  // RAM fallback - only allocated when the log is actually used
+  _ram = (VwireLogRecord*)malloc(sizeof(VwireLogRecord) * VWIRE_OFFLINE_RAM_RECORDS);
+  if (!_ram) return false;
+  _ramHead = 0;
+  _useFlash = false;
+  _enabled = true;
+  _bootSeq = _nextSeq;
+  return true;
+}
+
+void VwireOfflineLog::end() {
+  if (_ram) {
+    free(_ram);
+    _ram = nullptr;
+  }
+  _enabled = false;
+  _useFlash = false;
+  _count = 0;
+}
+
+// =============================================================================
+// RECORDS
+// =============================================================================
+
+uint8_t VwireOfflineLog::_checksum(const VwireLogRecord& rec) {
+  // Catches torn writes after a power cut, not a security measure
+  const uint8_t* p = (const uint8_t*)&rec;
+  uint8_t sum = 0x5A;
+  const uint8_t* header = (const uint8_t*)&rec.check;
+  for (; p < header; p++) sum = (sum << 1 | sum >> 7) ^ *p;
+  for (uint8_t i = 0; i < rec.len && i < VWIRE_OFFLINE_VALUE_LENGTH; i++) sum = (sum << 1 | sum >> 7) ^ (uint8_t)rec.value[i];
+  return sum;
+}
+
+bool VwireOfflineLog::append(uint8_t pin, const char* value, uint32_t stamp, uint8_t flags) {
+  if (!_enabled) return false;
+
+  VwireLogRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  size_t len = strlen(value);
+  if (len > VWIRE_OFFLINE_VALUE_LENGTH) len = VWIRE_OFFLINE_VALUE_LENGTH;
+  rec.seq = _nextSeq++;
+  rec.stamp = stamp;
+  rec.pin = pin;
+  rec.flags = flags;
+  rec.len = len;
+  memcpy(rec.value, value, len);
+  rec.check = _checksum(rec);
+
+#if VWIRE_HAS_LITTLEFS
+  if (_useFlash) return _flashAppend(rec);
+#endif
+
+  if (_count == VWIRE_OFFLINE_RAM_RECORDS) {
+    // Full - overwrite the oldest
+    _ramHead = (_ramHead + 1) % VWIRE_OFFLINE_RAM_RECORDS;
+    _count--;
+    _dropped++;
+  }
+  _ram[(_ramHead + _count) % VWIRE_OFFLINE_RAM_RECORDS] = rec;
+  _count++;
+  return true;
+}
+
+uint8_t VwireOfflineLog::peek(VwireLogRecord* out, uint8_t max) {
+  if (!_enabled || _count == 0) return 0;
+
+#if VWIRE_HAS_LITTLEFS
+  if (_useFlash) return _flashPeek(out, max);
+#endif
+
+  uint8_t n = (_count < max) ? _count : max;
+  for (uint8_t i = 0; i < n; i++) {
+    out[i] = _ram[(_ramHead + i) % VWIRE_OFFLINE_RAM_RECORDS];
+  }
+  return n;
+}
+
+void VwireOfflineLog::consume(uint8_t count) {
+  if (!_enabled) return;
+  if (count > _count) count = _count;
+
+#if VWIRE_HAS_LITTLEFS
+  if (_useFlash) {
+    _flashConsume(count);
+    return;
+  }
+#endif
+
+  _ramHead = (_ramHead + count) % VWIRE_OFFLINE_RAM_RECORDS;
+  _count -= count;
+}
+
+void VwireOfflineLog::clear() {
+#if VWIRE_HAS_LITTLEFS
+  if (_useFlash) {
+    for (uint8_t seg = 0; seg < VWIRE_OFFLINE_SEGMENTS; seg++) {
+      if (_segGen[seg]) _dropSegment(seg);
+    }
+    _readSeg = VWIRE_SEG_NONE;
+    _readPos = 0;
+    _saveCursor();
+  }
+#endif
+  _ramHead = 0;
+  _count = 0;
+}
+
+// =============================================================================
+// FLASH SEGMENTS (LittleFS)
+// =============================================================================
+#if VWIRE_HAS_LITTLEFS
+
+#define VWIRE_CURSOR_PATH VWIRE_OFFLINE_DIR "/cursor"
+
+// Read position inside the oldest segment - one small file, rewritten after
+// each partial replay so a reset does not send the same records again
+struct VwireLogCursor {
+  uint32_t gen;     ///< Generation of the segment it belongs to
+  uint16_t pos;     ///< Records already replayed from it
+  uint16_t check;   ///< Guards against a torn write
+};
+
+static uint16_t _cursorCheck(const VwireLogCursor& cursor) {
+  return (uint16_t)(cursor.gen ^ (cursor.gen >> 16) ^ cursor.pos ^ 0xA55A);
+}
+
+void VwireOfflineLog::_segPath(char* out, size_t size, uint8_t seg) {
+  snprintf(out, size, VWIRE_OFFLINE_DIR "/seg%u.log", (unsigned)seg);
+}
+
+bool VwireOfflineLog::_openFlash() {
+  #if defined(VWIRE_BOARD_ESP32)
+  if (!LittleFS.begin(true)) return false;  // Format on first use
+  #else
+  if (!LittleFS.begin()) return false;
+  #endif
+  if (!LittleFS.exists(VWIRE_OFFLINE_DIR)) LittleFS.mkdir(VWIRE_OFFLINE_DIR);
+
+  // Recover the ring from the segment headers: lowest generation is the
+  // oldest segment, highest is the one being appended to
+  uint32_t oldestGen = 0, newestGen = 0;
+  _readSeg = VWIRE_SEG_NONE;
+  _writeSeg = VWIRE_SEG_NONE;
+  _readPos = 0;
+  _nextGen = 1;
+  _writeSealed = false;
+  bool torn[VWIRE_OFFLINE_SEGMENTS];
+
+  for (uint8_t seg = 0; seg < VWIRE_OFFLINE_SEGMENTS; seg++) {
+    char path[32];
+    _segPath(path, sizeof(path), seg);
+    _segGen[seg] = 0;
+    _segCount[seg] = 0;
+    torn[seg] = false;
+    if (!LittleFS.exists(path)) continue;
+
+    File f = LittleFS.open(path, "r");
+    if (!f) continue;
+    uint32_t gen = 0;
+    size_t size = f.size();
+    if (f.read((uint8_t*)&gen, sizeof(gen)) == sizeof(gen) && gen != 0) {
+      size_t records = (size - VWIRE_SEG_HEADER) / sizeof(VwireLogRecord);
+      torn[seg] = ((size - VWIRE_SEG_HEADER) % sizeof(VwireLogRecord)) != 0;
+      if (records > VWIRE_OFFLINE_SEGMENT_RECORDS) records = VWIRE_OFFLINE_SEGMENT_RECORDS;
+      _segGen[seg] = gen;
+      _segCount[seg] = records;
+      _count += records;
+      if (oldestGen == 0 || gen < oldestGen) { oldestGen = gen; _readSeg = seg; }
+      if (gen > newestGen) { newestGen = gen; _writeSeg = seg; }
+    }
+    f.close();
+  }
+
+  if (_writeSeg != VWIRE_SEG_NONE) {
+    _nextGen = newestGen + 1;
+
+    // A power cut mid-write leaves a partial record - appending after it
+    // would misalign the file, so start a new segment instead
+    _writeSealed = torn[_writeSeg];
+
+    // Continue the sequence from the newest readable record
+    char path[32];
+    _segPath(path, sizeof(path), _writeSeg);
+    File f = LittleFS.open(path, "r");
+    if (f && _segCount[_writeSeg] > 0) {
+      VwireLogRecord rec;
+      f.seek(VWIRE_SEG_HEADER + (_segCount[_writeSeg] - 1) * sizeof(VwireLogRecord));
+      if (f.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec) && rec.check == _checksum(rec)) {
+        _nextSeq = rec.seq + 1;
+      }
+    }
+    if (f) f.close();
+  }
+
+  // Skip what was replayed from the oldest segment before the reset
+  if (_readSeg != VWIRE_SEG_NONE) {
+    File f = LittleFS.open(VWIRE_CURSOR_PATH, "r");
+    VwireLogCursor cursor;
+    if (f && f.read((uint8_t*)&cursor, sizeof(cursor)) == sizeof(cursor) &&
+        cursor.check == _cursorCheck(cursor) && cursor.gen == _segGen[_readSeg] &&
+        cursor.pos <= _segCount[_readSeg]) {
+      _readPos = cursor.pos;
+      _count -= cursor.pos;
+    }
+    if (f) f.close();
+  }
+  return true;
+}
+
+void VwireOfflineLog::_saveCursor() {
+  if (_readSeg == VWIRE_SEG_NONE || _readPos == 0) {
+    if (LittleFS.exists(VWIRE_CURSOR_PATH)) LittleFS.remove(VWIRE_CURSOR_PATH);
+    return;
+  }
+  VwireLogCursor cursor;
+  cursor.gen = _segGen[_readSeg];
+  cursor.pos = _readPos;
+  cursor.check = _cursorCheck(cursor);
+  File f = LittleFS.open(VWIRE_CURSOR_PATH, "w");
+  if (!f) return;
+  f.write((const uint8_t*)&cursor, sizeof(cursor));
+  f.close();
+}
+
+void VwireOfflineLog::_dropSegment(uint8_t seg) {
+  char path[32];
+  _segPath(path, sizeof(path), seg);
+  LittleFS.remove(path);
+
+  uint16_t unread = _segCount[seg];
+  if (seg == _readSeg) unread -= _readPos;
+  _count -= unread;
+  _segGen[seg] = 0;
+  _segCount[seg] = 0;
+
+  if (seg == _readSeg) {
+    // Advance to the next live segment (if any), from its start
+    bool hadCursor = _readPos != 0;
+    _readPos = 0;
+    _readSeg = VWIRE_SEG_NONE;
+    for (uint8_t i = 1; i < VWIRE_OFFLINE_SEGMENTS; i++) {
+      uint8_t next = (seg + i) % VWIRE_OFFLINE_SEGMENTS;
+      if (_segGen[next]) { _readSeg = next; break; }
+    }
+    if (hadCursor) _saveCursor();
+  }
+}
+
+void VwireOfflineLog::_rotateSegment() {
+  // Segments are used round-robin, which spreads erase cycles evenly
+  uint8_t next = (_writeSeg == VWIRE_SEG_NONE) ? 0 : (_writeSeg + 1) % VWIRE_OFFLINE_SEGMENTS;
+
+  if (_segGen[next]) {
+    // Ring is full - the next segment is the oldest one
+    uint16_t lost = _segCount[next] - ((next == _readSeg) ? _readPos : 0);
+    _dropSegment(next);
+    _dropped += lost;
+  }
+
+  char path[32];
+  _segPath(path, sizeof(path), next);
+  File f = LittleFS.open(path, "w");
+  if (!f) return;
+  uint32_t gen = _nextGen++;
+  f.write((const uint8_t*)&gen, sizeof(gen));
+  f.close();
+
+  _segGen[next] = gen;
+  _segCount[next] = 0;
+  _writeSeg = next;
+  _writeSealed = false;
+  if (_readSeg == VWIRE_SEG_NONE) {
+    _readSeg = next;
+    _readPos = 0;
+  }
+}
+
+bool VwireOfflineLog::_flashAppend(const VwireLogRecord& rec) {
+  if (_writeSeg == VWIRE_SEG_NONE || _segGen[_writeSeg] == 0 || _writeSealed ||
+      _segCount[_writeSeg] >= VWIRE_OFFLINE_SEGMENT_RECORDS) {
+    _rotateSegment();
+    if (_writeSeg == VWIRE_SEG_NONE || _segGen[_writeSeg] == 0 || _writeSealed) return false;
+  }
+
+  char path[32];
+  _segPath(path, sizeof(path), _writeSeg);
+  File f = LittleFS.open(path, "a");
+  if (!f) return false;
+  size_t written = f.write((const uint8_t*)&rec, sizeof(rec));
+  f.close();
+  if (written != sizeof(rec)) return false;
+
+  _segCount[_writeSeg]++;
+  _count++;
+  return true;
+}
+
+uint8_t VwireOfflineLog::_flashPeek(VwireLogRecord* out, uint8_t max) {
+  uint8_t n = 0;
+  uint8_t seg = _readSeg;
+  uint16_t pos = _readPos;
+
+  while (n < max && seg != VWIRE_SEG_NONE && _segGen[seg]) {
+    if (pos < _segCount[seg]) {
+      char path[32];
+      _segPath(path, sizeof(path), seg);
+      File f = LittleFS.open(path, "r");
+      if (!f) break;
+      f.seek(VWIRE_SEG_HEADER + pos * sizeof(VwireLogRecord));
+      while (n < max && pos < _segCount[seg]) {
+        VwireLogRecord& rec = out[n++];
+        if (f.read((uint8_t*)&rec, sizeof(rec)) != sizeof(rec) || rec.check != _checksum(rec)) {
+          rec.pin = VWIRE_LOG_INVALID;
+        }
+        pos++;
+      }
+      f.close();
+    }
+    if (seg == _writeSeg) break;
+    seg = (seg + 1) % VWIRE_OFFLINE_SEGMENTS;
+    pos = 0;
+  }
+  return n;
+}
+
+void VwireOfflineLog::_flashConsume(uint8_t count) {
+  while (count > 0 && _readSeg != VWIRE_SEG_NONE) {
+    uint16_t unread = _segCount[_readSeg] - _readPos;
+    if (count < unread) {
+      _readPos += count;
+      _count -= count;
+      _saveCursor();
+      return;
+    }
+    count -= unread;
+
+    // Segment fully replayed - delete it (the write segment too, so the
+    // next append starts a fresh file in the following slot)
+    _dropSegment(_readSeg);
+  }
+}
+
+#endif // VWIRE_HAS_LITTLEFS
@@ -0,0 +1,147 @@
+/*
+ * Vwire IOT Arduino Library - Offline Log
+ *
+ * Append-only ring log that captures virtual pin writes while the device
+ * is offline, so they can be replayed once the connection is back.
+ *
+ * Storage:
+ * - ESP32 / ESP8266: LittleFS segment files (survive reboots)
+ * - Other boards:    RAM ring buffer (allocated only when enabled)
+ *
+ * Flash layout:
+ * - VWIRE_OFFLINE_SEGMENTS files (<dir>/seg<N>.log), each starting with a
+ *   4-byte generation number followed by fixed-size records
+ * - Writes only ever append; a segment is rewritten only when the ring
+ *   wraps around to it, and deleted once fully replayed
+ * - The read position inside the oldest segment is saved in <dir>/cursor
+ *   (8 bytes, rewritten after each partial replay), so a reboot or a wake
+ *   from deep sleep continues where replay stopped. A lost cursor only
+ *   means that segment is replayed again - records carry a sequence
+ *   number for de-duplication
+ *
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_OFFLINE_LOG_H
+#define VWIRE_OFFLINE_LOG_H
+
+#include <Arduino.h>
+#include "VwireConfig.h"
+
+// Record flags
+#define VWIRE_LOG_EPOCH     0x01   ///< stamp is Unix time (seconds), else millis()
+#define VWIRE_LOG_INVALID   0xFF   ///< pin value marking an unreadable record
+
+/**
+ * @brief One captured virtual pin write
+ */
+struct VwireLogRecord {
+  uint32_t seq;                              ///< Sequence number (monotonic across reboots)
+  uint32_t stamp;                            ///< Capture time (see flags)
+  uint8_t pin;                               ///< Virtual pin (VWIRE_LOG_INVALID if corrupt)
+  uint8_t flags;                             ///< VWIRE_LOG_* flags
+  uint8_t len;                               ///< Value length
+  uint8_t check;                             ///< Checksum over the fields above and value
+  char value[VWIRE_OFFLINE_VALUE_LENGTH];    ///< Value (not NUL-terminated when full)
+};
+
+/**
+ * @brief Ring log of offline virtual pin writes
+ */
+class VwireOfflineLog {
+public:
+  VwireOfflineLog();
+  ~VwireOfflineLog();
+
+  /**
+   * @brief Open the log
+   * @param useFlash Store on LittleFS if available (falls back to RAM)
+   * @return true if the log is ready
+   */
+  bool begin(bool useFlash = true);
+
+  /**
+   * @brief Close the log and release RAM (flash contents are kept)
+   */
+  void end();
+
+  /** @brief Check if the log is open */
+  bool isEnabled() const { return _enabled; }
+
+  /** @brief Check if records are stored on flash */
+  bool usesFlash() const { return _useFlash; }
+
+  /**
+   * @brief Append a record, recycling the oldest storage when full
+   * @param pin Virtual pin number
+   * @param value Value text (truncated to VWIRE_OFFLINE_VALUE_LENGTH)
+   * @param stamp Capture time
+   * @param flags VWIRE_LOG_* flags describing stamp
+   * @return true if stored
+   */
+  bool append(uint8_t pin, const char* value, uint32_t stamp, uint8_t flags);
+
+  /**
+   * @brief Read the oldest records without removing them
+   * @param out Destination array
+   * @param max Capacity of out
+   * @return Records read (corrupt ones have pin == VWIRE_LOG_INVALID)
+   */
+  uint8_t peek(VwireLogRecord* out, uint8_t max);
+
+  /**
+   * @brief Remove the oldest records after they were replayed
+   * @param count Number of records returned by peek() to drop
+   */
+  void consume(uint8_t count);
+
+  /** @brief Delete all records */
+  void clear();
+
+  /** @brief Records waiting for replay */
+  uint32_t count() const { return _count; }
+
+  /** @brief Records lost because the ring was full */
+  uint32_t dropped() const { return _dropped; }
+
+  /** @brief First sequence number written since begin() (older records predate this boot) */
+  uint32_t bootSeq() const { return _bootSeq; }
+
+private:
+  bool _enabled;
+  bool _useFlash;
+  uint32_t _count;
+  uint32_t _dropped;
+  uint32_t _nextSeq;
+  uint32_t _bootSeq;
+
+  // RAM ring
+  VwireLogRecord* _ram;
+  uint16_t _ramHead;
+
+  // Flash segments
+  uint32_t _segGen[VWIRE_OFFLINE_SEGMENTS];     ///< Generation (0 = unused)
+  uint16_t _segCount[VWIRE_OFFLINE_SEGMENTS];   ///< Records in each segment
+  uint32_t _nextGen;
+  uint8_t _readSeg;                             ///< Oldest segment
+  uint16_t _readPos;                            ///< Records already consumed in _readSeg
+  uint8_t _writeSeg;                            ///< Segment being appended to
+  bool _writeSealed;                            ///< Write segment ends in a torn record
+
+  static uint8_t _checksum(const VwireLogRecord& rec);
+
+#if VWIRE_HAS_LITTLEFS
+  bool _openFlash();
+  bool _flashAppend(const VwireLogRecord& rec);
+  uint8_t _flashPeek(VwireLogRecord* out, uint8_t max);
+  void _flashConsume(uint8_t count);
+  void _rotateSegment();
+  void _dropSegment(uint8_t seg);
+  void _saveCursor();
+  static void _segPath(char* out, size_t size, uint8_t seg);
+#endif
+};
+
+#endif // VWIRE_OFFLINE_LOG_H
@@ -0,0 +1,234 @@
+/*
+ * Vwire IOT Arduino Library - Cloud OTA Implementation
+ *
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#include "VwireOta.h"
+
+#if VWIRE_HAS_OTA
+  #if defined(VWIRE_BOARD_ESP32)
+    #include <Update.h>
+    #include <esp_ota_ops.h>
+    #include <esp_partition.h>
+  #elif defined(VWIRE_BOARD_ESP8266)
+    #include <Updater.h>
+  #endif
+#endif
+
+// Delta patch operations
+#define VWIRE_PATCH_COPY 0x01
+#define VWIRE_PATCH_DATA 0x02
+
+static const char VWIRE_PATCH_MAGIC[4] = {'V', 'W', 'D', '1'};
+
+static uint32_t _otaGet32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// =============================================================================
+// FLASH TARGET
+// =============================================================================
+#if VWIRE_HAS_OTA
+bool VwireFlashOtaTarget::begin(uint32_t size, const char* md5) {
+  if (!Update.begin(size)) return false;
+  if (md5 && md5[0] && !Update.setMD5(md5)) {
+    Update.end();
+    return false;
+  }
+  return true;
+}
+
+bool VwireFlashOtaTarget::write(const uint8_t* data, size_t len) {
+  return Update.write((uint8_t*)data, len) == len;
+}
+
+bool VwireFlashOtaTarget::finish() {
+  return Update.end();  // Checks the size and the MD5
+}
+
+void VwireFlashOtaTarget::abort() {
+  #if defined(VWIRE_BOARD_ESP32)
+  Update.abort();
+  #else
+  Update.end(false);  // Not all of it - error, partition stays unused
+  #endif
+}
+
+bool VwireFlashOtaTarget::baseMatches(const char* md5) {
+  return ESP.getSketchMD5().equalsIgnoreCase(md5);
+}
+
+bool VwireFlashOtaTarget::readBase(uint32_t offset, uint8_t* out, size_t len) {
+  #if defined(VWIRE_BOARD_ESP32)
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  if (!running || offset > running->size || len > running->size - offset) return false;
+  return esp_partition_read(running, offset, out, len) == ESP_OK;
+  #else
+  // The running sketch starts at flash address 0
+  uint32_t size = ESP.getSketchSize();
+  if (offset > size || len > size - offset) return false;
+  return ESP.flashRead(offset, out, len);
+  #endif
+}
+
+void VwireFlashOtaTarget::apply() {
+  ESP.restart();
+}
+#endif
+
+// =============================================================================
+// TRANSFER
+// =============================================================================
+VwireOtaUpdate::VwireOtaUpdate()
+  : _target(nullptr)
+  , _size(0)
+  , _image(0)
+  , _received(0)
+  , _written(0)
+  , _error(nullptr)
+  , _delta(false)
+  , _patchState(PATCH_MAGIC)
+  , _op(0)
+  , _argLen(0)
+  , _argNeed(0)
+  , _dataLeft(0)
+{
+  _id[0] = '\0';
+}
+
+bool VwireOtaUpdate::start(VwireOtaTarget* target, const char* id, uint32_t size, uint32_t image,
+                           const char* md5, const char* base) {
+  abort();
+  strncpy(_id, id, sizeof(_id) - 1);
+  _id[sizeof(_id) - 1] = '\0';
+  _size = size;
+  _image = image;
+  _received = 0;
+  _written = 0;
+  _error = nullptr;
+  _delta = base && base[0];
+  _patchState = PATCH_MAGIC;
+  _argLen = 0;
+
+  // A patch made for other firmware - the server has to send the full image
+  if (_delta && (!target || !target->baseMatches(base))) {
+    _error = "base";
+    return false;
+  }
+  if (!target || !target->begin(image, md5 ? md5 : "")) {
+    _error = "begin";
+    return false;
+  }
+  _target = target;
+  return true;
+}
+
+bool VwireOtaUpdate::write(const uint8_t* data, size_t len) {
+  if (!_target) return false;
+  if (len > _size - _received) return _fail("size");
+  _received += len;
+  return _delta ? _patch(data, len) : _output(data, len);
+}
+
+bool VwireOtaUpdate::finish() {
+  if (!_target) return false;
+  if (!complete() || _written != _image) return _fail("size");
+  if (_delta && _patchState != PATCH_OP) return _fail("patch");  // Cut off mid-operation
+
+  VwireOtaTarget* target = _target;
+  _target = nullptr;
+  if (!target->finish()) {
+    _error = "verify";
+    return false;
+  }
+  return true;
+}
+
+void VwireOtaUpdate::abort() {
+  if (_target) _target->abort();
+  _target = nullptr;
+}
+
+bool VwireOtaUpdate::_fail(const char* error) {
+  abort();
+  _error = error;
+  return false;
+}
+
+bool VwireOtaUpdate::_output(const uint8_t* data, size_t len) {
+  if (len > _image - _written) return _fail("size");
+  if (!_target->write(data, len)) return _fail("write");
+  _written += len;
+  return true;
+}
+
+bool VwireOtaUpdate::_copyBase(uint32_t from, uint32_t length) {
+  // Running image -> new image in stack-sized pieces
+  uint8_t buffer[VWIRE_OTA_COPY_BUFFER];
+  while (length) {
+    size_t piece = length < sizeof(buffer) ? length : sizeof(buffer);
+    if (!_target->readBase(from, buffer, piece)) return _fail("base");
+    if (!_output(buffer, piece)) return false;
+    from += piece;
+    length -= piece;
+    yield();  // Long copies keep WiFi and the watchdog serviced
+  }
+  return true;
+}
+
+bool VwireOtaUpdate::_patch(const uint8_t* data, size_t len) {
+  while (len) {
+    switch (_patchState) {
+      case PATCH_MAGIC:
+        if (*data != (uint8_t)VWIRE_PATCH_MAGIC[_argLen]) return _fail("patch");
+        data++;
+        len--;
+        if (++_argLen == sizeof(VWIRE_PATCH_MAGIC)) _patchState = PATCH_OP;
+        break;
+
+      case PATCH_OP:
+        _op = *data++;
+        len--;
+        if (_op == VWIRE_PATCH_COPY) _argNeed = 8;
+        else if (_op == VWIRE_PATCH_DATA) _argNeed = 4;
+        else return _fail("patch");
+        _argLen = 0;
+        _patchState = PATCH_ARGS;
+        break;
+
+      case PATCH_ARGS: {
+        // Arguments may be split across chunks
+        size_t n = _argNeed - _argLen;
+        if (n > len) n = len;
+        memcpy(_args + _argLen, data, n);
+        _argLen += n;
+        data += n;
+        len -= n;
+        if (_argLen < _argNeed) break;
+
+        if (_op == VWIRE_PATCH_COPY) {
+          if (!_copyBase(_otaGet32(_args), _otaGet32(_args + 4))) return false;
+          _patchState = PATCH_OP;
+        } else {
+          _dataLeft = _otaGet32(_args);
+          _patchState = _dataLeft ? PATCH_DATA : PATCH_OP;
+        }
+        break;
+      }
+
+      case PATCH_DATA: {
+        size_t n = _dataLeft < len ? _dataLeft : len;
+        if (!_output(data, n)) return false;
+        data += n;
+        len -= n;
+        _dataLeft -= n;
+        if (_dataLeft == 0) _patchState = PATCH_OP;
+        break;
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,191 @@
+/*
+ * Vwire IOT Arduino Library - Cloud OTA
+ *
+ * Firmware updates pulled over the device's own MQTT session, written
+ * chunk by chunk to the update partition - the image is never held in RAM.
+ *
+ * Protocol (topics under vwire/<deviceId>/):
+ * - ota         server -> device  {"id":"job","size":N,"image":M,"md5":"...","base":"..."}
+ *                                 or {"cancel":true}
+ * - ota/req     device -> server  {"id":"job","offset":N,"chunk":C,"count":K}
+ * - ota/data    server -> device  [offset u32 LE][bytes], K chunks of C bytes from offset
+ * - ota/status  device -> server  {"id":"job","state":"download|done|error","offset":N,"size":S}
+ *
+ * size is the number of bytes transferred and image the size of the
+ * resulting firmware (same as size unless a patch is sent). With "base"
+ * (MD5 of the running firmware) the transfer is a delta patch:
+ *
+ *   "VWD1", then operations until the end of the transfer:
+ *   0x01 COPY [from u32][length u32]   bytes of the running firmware
+ *   0x02 DATA [length u32][bytes]      new bytes
+ *
+ * Chunks are accepted only at the expected offset, so a lost, repeated or
+ * reordered chunk costs one re-request of the window from that offset -
+ * also after a reconnect or when the server announces the same job again.
+ *
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_OTA_H
+#define VWIRE_OTA_H
+
+#include <Arduino.h>
+#include "VwireConfig.h"
+
+/**
+ * @brief Progress of a cloud OTA update (see onOtaProgress())
+ */
+typedef enum {
+  VWIRE_OTA_IDLE = 0,            ///< No update
+  VWIRE_OTA_DOWNLOADING,         ///< Chunks are being received
+  VWIRE_OTA_DONE,                ///< Image complete and verified, restart pending
+  VWIRE_OTA_FAILED               ///< Update abandoned (see the error in ota/status)
+} VwireOtaState;
+
+/**
+ * @brief Where a cloud OTA image goes
+ *
+ * VwireFlashOtaTarget writes the update partition on ESP32/ESP8266. Other
+ * targets can take images for an SD card or a co-processor, on any board.
+ */
+class VwireOtaTarget {
+public:
+  virtual ~VwireOtaTarget() {}
+
+  /**
+   * @brief Prepare for a new image
+   * @param size Image size in bytes
+   * @param md5 Expected MD5 as hex (empty if the server sent none)
+   * @return false if the image cannot be taken (too big, no partition)
+   */
+  virtual bool begin(uint32_t size, const char* md5) = 0;
+
+  /** @brief Append image bytes */
+  virtual bool write(const uint8_t* data, size_t len) = 0;
+
+  /**
+   * @brief Close the complete image
+   * @return false if it does not verify (MD5) and must not be used
+   */
+  virtual bool finish() = 0;
+
+  /** @brief Throw away a partial image */
+  virtual void abort() = 0;
+
+  /**
+   * @brief Check if delta patches can be applied against an image
+   * @param md5 MD5 of the image the patch was made against (hex)
+   */
+  virtual bool baseMatches(const char* md5) { (void)md5; return false; }
+
+  /** @brief Read bytes of the base image for a patch COPY */
+  virtual bool readBase(uint32_t offset, uint8_t* out, size_t len) {
+    (void)offset; (void)out; (void)len;
+    return false;
+  }
+
+  /** @brief Start using the new image - called once the server was told it is done */
+  virtual void apply() {}
+};
+
+#if VWIRE_HAS_OTA
+/**
+ * @brief Cloud OTA into the update partition (Update library)
+ *
+ * Delta patches apply against the running firmware; apply() restarts.
+ * Override apply() to pick the moment of the restart yourself.
+ */
+class VwireFlashOtaTarget : public VwireOtaTarget {
+public:
+  bool begin(uint32_t size, const char* md5) override;
+  bool write(const uint8_t* data, size_t len) override;
+  bool finish() override;
+  void abort() override;
+  bool baseMatches(const char* md5) override;
+  bool readBase(uint32_t offset, uint8_t* out, size_t len) override;
+  void apply() override;
+};
+#endif
+
+/**
+ * @brief One image transfer - offsets, patch decoding, writes to the target
+ */
+class VwireOtaUpdate {
+public:
+  VwireOtaUpdate();
+
+  /**
+   * @brief Start a transfer
+   * @param target Where the image goes
+   * @param id Job ID from the announcement
+   * @param size Bytes to transfer
+   * @param image Size of the resulting image
+   * @param md5 Expected image MD5 (hex, may be empty)
+   * @param base MD5 of the image a VWD1 patch applies to (nullptr = full image)
+   * @return false if the base does not match or the target refused (see error())
+   */
+  bool start(VwireOtaTarget* target, const char* id, uint32_t size, uint32_t image,
+             const char* md5, const char* base);
+
+  /**
+   * @brief Take the next bytes of the transfer (at offset received())
+   * @return false on a write or patch error - the update is then aborted
+   */
+  bool write(const uint8_t* data, size_t len);
+
+  /**
+   * @brief Close a complete transfer
+   * @return false if the image is short, a patch is cut off or it fails to verify
+   */
+  bool finish();
+
+  /** @brief Abandon the transfer */
+  void abort();
+
+  /** @brief Check if a transfer is in progress */
+  bool active() const { return _target != nullptr; }
+
+  /** @brief Check if all bytes were received */
+  bool complete() const { return _received == _size; }
+
+  /** @brief Job ID of the current (or last) transfer */
+  const char* id() const { return _id; }
+
+  /** @brief Bytes received so far - the offset of the next chunk */
+  uint32_t received() const { return _received; }
+
+  /** @brief Bytes to transfer */
+  uint32_t size() const { return _size; }
+
+  /** @brief Why the last transfer failed (nullptr if it did not) */
+  const char* error() const { return _error; }
+
+private:
+  enum PatchState { PATCH_MAGIC, PATCH_OP, PATCH_ARGS, PATCH_DATA };
+
+  VwireOtaTarget* _target;
+  char _id[VWIRE_OTA_ID_LENGTH];
+  uint32_t _size;
+  uint32_t _image;
+  uint32_t _received;
+  uint32_t _written;
+  const char* _error;
+
+  // Delta patch decoding (state survives chunk boundaries)
+  bool _delta;
+  PatchState _patchState;
+  uint8_t _op;
+  uint8_t _args[8];
+  uint8_t _argLen;
+  uint8_t _argNeed;
+  uint32_t _dataLeft;
+
+  bool _fail(const char* error);
+  bool _output(const uint8_t* data, size_t len);
+  bool _copyBase(uint32_t from, uint32_t length);
+  bool _patch(const uint8_t* data, size_t len);
+};
+
+#endif // VWIRE_OTA_H
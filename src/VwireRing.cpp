@@ -0,0 +1,71 @@
+/*
+ * Vwire IOT Arduino Library - Ring Implementation
+ * 
+ * Head and tail are free-running 16-bit counters; each is written by one
+ * side only and published with release/acquire ordering, so a record is
+ * fully written before the other side can see it.
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#include "VwireRing.h"
+
+VwireRing::VwireRing()
+  : _records(nullptr)
+  , _mask(0)
+  , _head(0)
+  , _tail(0)
+{
+}
+
+VwireRing::~VwireRing() {
+  end();
+}
+
+bool VwireRing::begin(uint16_t capacity) {
+  end();
+  if (capacity == 0 || (capacity & (capacity - 1))) return false;
+  
+  _records = (VwireRingRecord*)malloc(sizeof(VwireRingRecord) * capacity);
+  if (!_records) return false;
+  _mask = capacity - 1;
+  _head = 0;
+  _tail = 0;
+  return true;
+}
+
+void VwireRing::end() {
+  free(_records);
+  _records = nullptr;
+  _mask = 0;
+  _head = 0;
+  _tail = 0;
+}
+
+VwireRingRecord* VwireRing::reserve() {
+  if (!_records) return nullptr;
+  uint16_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+  if ((uint16_t)(_head - tail) > _mask) return nullptr;  // Full
+  return &_records[_head & _mask];
+}
+
+void VwireRing::commit() {
+  __atomic_store_n(&_head, (uint16_t)(_head + 1), __ATOMIC_RELEASE);
+}
+
+VwireRingRecord* VwireRing::front() {
+  if (!_records) return nullptr;
+  uint16_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+  if (head == _tail) return nullptr;  // Empty
+  return &_records[_tail & _mask];
+}
+
+void VwireRing::pop() {
+  __atomic_store_n(&_tail, (uint16_t)(_tail + 1), __ATOMIC_RELEASE);
+}
+
+uint16_t VwireRing::count() const {
+  return (uint16_t)(__atomic_load_n(&_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE));
+}
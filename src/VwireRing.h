@@ -0,0 +1,100 @@
+/*
+ * Vwire IOT Arduino Library - Ring
+ * 
+ * Single-producer / single-consumer ring of fixed-size records, used to
+ * hand work between the application and the network task without locks.
+ * 
+ * - One side only ever calls reserve()/commit(), the other front()/pop()
+ * - Records are filled and read in place, never copied
+ * - Storage is allocated by begin() and released by end()
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_RING_H
+#define VWIRE_RING_H
+
+#include <Arduino.h>
+#include "VwireConfig.h"
+
+// Record types (application -> network task)
+#define VWIRE_RING_PIN          0x01   ///< virtualSend(pin, value)
+#define VWIRE_RING_RECORD       0x02   ///< record(pin, float) - stamp is millis()
+#define VWIRE_RING_NOTIFY       0x03   ///< notify(value)
+#define VWIRE_RING_EMAIL        0x04   ///< email() - value is "subject\0body"
+#define VWIRE_RING_LOG          0x05   ///< log(value)
+#define VWIRE_RING_SYNC         0x06   ///< syncVirtual(pin), pin 0xFF = syncAll()
+#define VWIRE_RING_BATCH_BEGIN  0x07   ///< beginBatch()
+#define VWIRE_RING_BATCH_FLUSH  0x08   ///< flushBatch()
+#define VWIRE_RING_SERIES_FLUSH 0x09   ///< flushSeries(pin), pin 0xFF = all
+#define VWIRE_RING_ANSWER       0x0A   ///< virtualSend() from a read handler
+
+// Record types (network task -> application)
+#define VWIRE_RING_CMD          0x20   ///< Command for a pin handler
+#define VWIRE_RING_CONNECT      0x21   ///< Connected - run connect handlers
+#define VWIRE_RING_DISCONNECT   0x22   ///< Disconnected - run disconnect handlers
+#define VWIRE_RING_READ         0x23   ///< Read request for a read handler
+
+/**
+ * @brief One unit of work passed through a VwireRing
+ */
+struct VwireRingRecord {
+  uint8_t type;                              ///< VWIRE_RING_* type
+  uint8_t pin;                               ///< Virtual pin (if any)
+  uint16_t len;                              ///< Bytes used in value
+  uint32_t stamp;                            ///< Capture time (VWIRE_RING_RECORD)
+  char value[VWIRE_NET_VALUE_LENGTH + 1];    ///< Payload, NUL-terminated
+};
+
+/**
+ * @brief Lock-free SPSC ring of VwireRingRecord
+ */
+class VwireRing {
+public:
+  VwireRing();
+  ~VwireRing();
+  
+  /**
+   * @brief Allocate the ring
+   * @param capacity Records (power of two)
+   * @return true if the ring is ready
+   */
+  bool begin(uint16_t capacity);
+  
+  /** @brief Release storage (neither side may be using the ring) */
+  void end();
+  
+  /** @brief Check if storage is allocated */
+  bool isReady() const { return _records != nullptr; }
+  
+  /**
+   * @brief Producer: next free record
+   * @return Record to fill, or nullptr if the ring is full
+   */
+  VwireRingRecord* reserve();
+  
+  /** @brief Producer: publish the record returned by reserve() */
+  void commit();
+  
+  /**
+   * @brief Consumer: oldest record
+   * @return Record (valid until pop()), or nullptr if the ring is empty
+   */
+  VwireRingRecord* front();
+  
+  /** @brief Consumer: release the record returned by front() */
+  void pop();
+  
+  /** @brief Records waiting (approximate while the other side is active) */
+  uint16_t count() const;
+  
+private:
+  VwireRingRecord* _records;
+  uint16_t _mask;
+  volatile uint16_t _head;                   ///< Written by the producer only
+  volatile uint16_t _tail;                   ///< Written by the consumer only
+};
+
+#endif // VWIRE_RING_H
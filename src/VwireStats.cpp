@@ -0,0 +1,72 @@
+/*
+ * Vwire IOT Arduino Library - Statistics Implementation
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#include "VwireStats.h"
+
+// =============================================================================
+// HISTOGRAM
+// =============================================================================
+void VwireHistogram::add(uint32_t us) {
+  if (count == 0 || us < min) min = us;
+  if (us > max) max = us;
+  count++;
+  total += us;
+  
+  // floor(log2(us)), the last bucket takes everything longer. clzl since
+  // int is 16 bits on AVR; long is at least 32 everywhere
+  uint8_t bucket = us ? (8 * sizeof(unsigned long) - 1) - __builtin_clzl((unsigned long)us) : 0;
+  if (bucket >= VWIRE_STATS_BUCKETS) bucket = VWIRE_STATS_BUCKETS - 1;
+  buckets[bucket]++;
+}
+
+uint32_t VwireHistogram::percentile(uint8_t percent) const {
+  if (count == 0) return 0;
+  if (percent > 100) percent = 100;
+  uint32_t target = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+  if (target == 0) target = 1;
+  
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < VWIRE_STATS_BUCKETS - 1; i++) {
+    seen += buckets[i];
+    if (seen >= target) {
+      uint32_t upper = (i >= 31) ? 0xFFFFFFFFUL : (2UL << i) - 1;
+      return upper < max ? upper : max;
+    }
+  }
+  return max;
+}
+
+void VwireHistogram::reset() {
+  count = 0;
+  min = 0;
+  max = 0;
+  total = 0;
+  memset(buckets, 0, sizeof(buckets));
+}
+
+// =============================================================================
+// STATS
+// =============================================================================
+void VwireStats::reset() {
+  publishes = 0;
+  bytesSent = 0;
+  messagesReceived = 0;
+  bytesReceived = 0;
+  dropsNotConnected = 0;
+  dropsQueueFull = 0;
+  retries = 0;
+  reconnects = 0;
+  connectFailures = 0;
+  handlerCalls = 0;
+  commandsCoalesced = 0;
+  samplesDropped = 0;
+  runTime.reset();
+  publishTime.reset();
+  handlerTime.reset();
+  connectTime.reset();
+}
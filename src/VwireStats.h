@@ -0,0 +1,82 @@
+/*
+ * Vwire IOT Arduino Library - Statistics
+ * 
+ * Counters and duration histograms kept by VwireClass when
+ * VWIRE_ENABLE_STATS is set, read with Vwire.getStats().
+ * 
+ * - Durations are microseconds, with min/avg/max and log2 buckets
+ * - Counters wrap at 2^32 and are never reset except by resetStats()
+ * - With the network task running, counters are written by that task and
+ *   read without a lock, so a snapshot may be a few events behind
+ * 
+ * Copyright (c) 2026 Vwire IOT
+ * Website: https://vwire.io
+ * MIT License
+ */
+
+#ifndef VWIRE_STATS_H
+#define VWIRE_STATS_H
+
+#include <Arduino.h>
+#include "VwireConfig.h"
+
+/**
+ * @brief Duration histogram (microseconds)
+ */
+struct VwireHistogram {
+  uint32_t count;                             ///< Samples recorded
+  uint32_t min;                               ///< Shortest sample (0 if none)
+  uint32_t max;                               ///< Longest sample
+  uint64_t total;                             ///< Sum of all samples
+  uint32_t buckets[VWIRE_STATS_BUCKETS];      ///< Bucket i: 2^i .. 2^(i+1) - 1 us (0 us in bucket 0)
+  
+  VwireHistogram() { reset(); }
+  
+  /** @brief Record one duration */
+  void add(uint32_t us);
+  
+  /** @brief Average duration (0 if no samples) */
+  uint32_t avg() const { return count ? (uint32_t)(total / count) : 0; }
+  
+  /**
+   * @brief Estimate a percentile from the buckets
+   * @param percent 0-100
+   * @return Upper bound of the bucket holding that sample, capped at max
+   */
+  uint32_t percentile(uint8_t percent) const;
+  
+  /** @brief Forget all samples */
+  void reset();
+};
+
+/**
+ * @brief Everything VwireClass counts and times
+ */
+struct VwireStats {
+  // Counters
+  uint32_t publishes;           ///< Messages published (including retries)
+  uint32_t bytesSent;           ///< Topic and payload bytes published, plus session setup packets
+  uint32_t messagesReceived;    ///< Messages received for this device
+  uint32_t bytesReceived;       ///< Topic and payload bytes received
+  uint32_t dropsNotConnected;   ///< Sends dropped because the device was offline
+  uint32_t dropsQueueFull;      ///< Sends dropped because a queue was full
+  uint32_t retries;             ///< Reliable delivery retransmissions
+  uint32_t reconnects;          ///< Connections re-established by run()
+  uint32_t connectFailures;     ///< Connection attempts that failed
+  uint32_t handlerCalls;        ///< Pin, read and message handlers run
+  uint32_t commandsCoalesced;   ///< Commands replaced by a newer one before their handler ran
+  uint32_t samplesDropped;      ///< record() samples discarded while offline without an offline log
+  
+  // Durations (microseconds)
+  VwireHistogram runTime;       ///< One run() call
+  VwireHistogram publishTime;   ///< beginPublish() to endPublish(), payload included
+  VwireHistogram handlerTime;   ///< One handler call
+  VwireHistogram connectTime;   ///< TCP connect plus TLS handshake
+  
+  VwireStats() { reset(); }
+  
+  /** @brief Zero every counter and histogram */
+  void reset();
+};
+
+#endif // VWIRE_STATS_H
@@ -1,7 +1,8 @@
 /*
  * Vwire IOT Arduino Library - Timer Implementation
  * 
- * Non-blocking software timer using millis() for universal compatibility.
+ * Non-blocking software timer using millis() for universal compatibility,
+ * or micros() for control loops.
  * 
  * Copyright (c) 2026 Vwire IOT
  * Website: https://vwire.io
@@ -10,12 +11,34 @@
 
 #include "VwireTimer.h"
 
+// Scope guard for timer state shared with the esp_timer task
+#if VWIRE_TIMER_BACKGROUND
+  #define VWIRE_TIMER_LOCK() StateLock _stateLock(this)
+#else
+  #define VWIRE_TIMER_LOCK()
+#endif
+
 // =============================================================================
 // CONSTRUCTOR
 // =============================================================================
 
-VwireTimer::VwireTimer() {
+VwireTimer::VwireTimer(uint8_t resolution) {
   _numTimers = 0;
+  _micros = (resolution == VWIRE_TIMER_MICROS);
+  #if VWIRE_TIMER_BACKGROUND
+  _background = VWIRE_TIMER_IN_LOOP;
+  _hwTimer = NULL;
+  _lock = NULL;
+  _lockDepth = 0;
+  _dirty = false;
+  _stalled = false;
+  _queueHead = 0;
+  _queueTail = 0;
+  #endif
+  #if VWIRE_TIMER_HEAP
+  _heapSize = 0;
+  memset(_heapPos, 0xFF, sizeof(_heapPos));
+  #endif
   
   // Initialize all timer slots
   for (int i = 0; i < VWIRE_MAX_TIMERS; i++) {
@@ -29,8 +52,21 @@ VwireTimer::VwireTimer() {
     _timers[i].enabled = false;
     _timers[i].hasArg = false;
     _timers[i].inUse = false;
+    _timers[i].mode = VWIRE_TIMER_FIXED_DELAY;
+  }
+}
+
+#if VWIRE_TIMER_BACKGROUND
+VwireTimer::~VwireTimer() {
+  if (_hwTimer) {
+    esp_timer_stop(_hwTimer);
+    esp_timer_delete(_hwTimer);
+  }
+  if (_lock) {
+    vSemaphoreDelete(_lock);
   }
 }
+#endif
 
 // =============================================================================
 // INTERNAL HELPERS
@@ -57,7 +93,7 @@ int VwireTimer::_createTimer(unsigned long interval, int maxRuns) {
   }
   
   _timers[slot].interval = interval;
-  _timers[slot].lastTriggered = millis();
+  _timers[slot].lastTriggered = _now();
   _timers[slot].maxRuns = maxRuns;
   _timers[slot].currentRun = 0;
   _timers[slot].enabled = true;
@@ -66,17 +102,137 @@ int VwireTimer::_createTimer(unsigned long interval, int maxRuns) {
   _timers[slot].callback = NULL;
   _timers[slot].callbackArg = NULL;
   _timers[slot].arg = NULL;
+  _timers[slot].mode = VWIRE_TIMER_FIXED_DELAY;
   
   _numTimers++;
+  _schedule(slot);
   
   return slot;
 }
 
+void VwireTimer::_advance(int timerId, unsigned long now) {
+  TimerSlot& t = _timers[timerId];
+  
+  if (t.mode == VWIRE_TIMER_FIXED_DELAY || t.interval == 0) {
+    t.lastTriggered = now;
+    return;
+  }
+  
+  if (t.mode == VWIRE_TIMER_CATCH_UP) {
+    // One period per run - still due next time if more were missed
+    t.lastTriggered += t.interval;
+    return;
+  }
+  
+  // Fixed rate: step over every period that already passed, so the next
+  // deadline lands on the original grid after now
+  unsigned long late = now - t.lastTriggered;
+  t.lastTriggered += (late / t.interval) * t.interval;
+}
+
+// =============================================================================
+// SCHEDULER
+// =============================================================================
+
+#if VWIRE_TIMER_HEAP
+
+bool VwireTimer::_dueBefore(uint8_t a, uint8_t b) {
+  // Signed difference keeps the order correct across millis() overflow
+  unsigned long dueA = _timers[a].lastTriggered + _timers[a].interval;
+  unsigned long dueB = _timers[b].lastTriggered + _timers[b].interval;
+  return (long)(dueA - dueB) < 0;
+}
+
+void VwireTimer::_heapSwap(uint8_t i, uint8_t j) {
+  uint8_t a = _heap[i];
+  _heap[i] = _heap[j];
+  _heap[j] = a;
+  _heapPos[_heap[i]] = i;
+  _heapPos[_heap[j]] = j;
+}
+
+void VwireTimer::_siftUp(uint8_t i) {
+  while (i > 0) {
+    uint8_t parent = (i - 1) / 2;
+    if (!_dueBefore(_heap[i], _heap[parent])) break;
+    _heapSwap(i, parent);
+    i = parent;
+  }
+}
+
+void VwireTimer::_siftDown(uint8_t i) {
+  for (;;) {
+    uint8_t first = i;
+    uint8_t left = 2 * i + 1;
+    uint8_t right = left + 1;
+    if (left < _heapSize && _dueBefore(_heap[left], _heap[first])) first = left;
+    if (right < _heapSize && _dueBefore(_heap[right], _heap[first])) first = right;
+    if (first == i) break;
+    _heapSwap(i, first);
+    i = first;
+  }
+}
+
+void VwireTimer::_schedule(int timerId) {
+  #if VWIRE_TIMER_BACKGROUND
+  _dirty = true;
+  #endif
+  if (!_timers[timerId].enabled) {
+    _unschedule(timerId);
+    return;
+  }
+  uint8_t pos = _heapPos[timerId];
+  if (pos == 0xFF) {
+    pos = _heapSize++;
+    _heap[pos] = timerId;
+    _heapPos[timerId] = pos;
+  }
+  _siftUp(pos);
+  _siftDown(_heapPos[timerId]);
+}
+
+void VwireTimer::_unschedule(int timerId) {
+  uint8_t pos = _heapPos[timerId];
+  if (pos == 0xFF) return;
+  #if VWIRE_TIMER_BACKGROUND
+  _dirty = true;
+  #endif
+  _heapPos[timerId] = 0xFF;
+  
+  // Move the last entry into the hole and restore order
+  _heapSize--;
+  if (pos == _heapSize) return;
+  uint8_t moved = _heap[_heapSize];
+  _heap[pos] = moved;
+  _heapPos[moved] = pos;
+  _siftUp(pos);
+  _siftDown(_heapPos[moved]);
+}
+
+#else
+
+void VwireTimer::_schedule(int timerId) {
+  (void)timerId;
+  #if VWIRE_TIMER_BACKGROUND
+  _dirty = true;
+  #endif
+}
+
+void VwireTimer::_unschedule(int timerId) {
+  (void)timerId;
+  #if VWIRE_TIMER_BACKGROUND
+  _dirty = true;
+  #endif
+}
+
+#endif
+
 // =============================================================================
 // TIMER CREATION - setInterval
 // =============================================================================
 
 int VwireTimer::setInterval(unsigned long interval, vwire_timer_callback callback) {
+  VWIRE_TIMER_LOCK();
   int slot = _createTimer(interval, VWIRE_RUN_FOREVER);
   
   if (slot != VWIRE_TIMER_INVALID) {
@@ -88,6 +244,7 @@ int VwireTimer::setInterval(unsigned long interval, vwire_timer_callback callbac
 }
 
 int VwireTimer::setInterval(unsigned long interval, vwire_timer_callback_arg callback, void* arg) {
+  VWIRE_TIMER_LOCK();
   int slot = _createTimer(interval, VWIRE_RUN_FOREVER);
   
   if (slot != VWIRE_TIMER_INVALID) {
@@ -104,6 +261,7 @@ int VwireTimer::setInterval(unsigned long interval, vwire_timer_callback_arg cal
 // =============================================================================
 
 int VwireTimer::setTimeout(unsigned long timeout, vwire_timer_callback callback) {
+  VWIRE_TIMER_LOCK();
   int slot = _createTimer(timeout, 1);  // Run once
   
   if (slot != VWIRE_TIMER_INVALID) {
@@ -115,6 +273,7 @@ int VwireTimer::setTimeout(unsigned long timeout, vwire_timer_callback callback)
 }
 
 int VwireTimer::setTimeout(unsigned long timeout, vwire_timer_callback_arg callback, void* arg) {
+  VWIRE_TIMER_LOCK();
   int slot = _createTimer(timeout, 1);  // Run once
   
   if (slot != VWIRE_TIMER_INVALID) {
@@ -135,6 +294,7 @@ int VwireTimer::setTimer(unsigned long interval, vwire_timer_callback callback,
     return VWIRE_TIMER_INVALID;
   }
   
+  VWIRE_TIMER_LOCK();
   int slot = _createTimer(interval, (int)numRuns);
   
   if (slot != VWIRE_TIMER_INVALID) {
@@ -150,6 +310,7 @@ int VwireTimer::setTimer(unsigned long interval, vwire_timer_callback_arg callba
     return VWIRE_TIMER_INVALID;
   }
   
+  VWIRE_TIMER_LOCK();
   int slot = _createTimer(interval, (int)numRuns);
   
   if (slot != VWIRE_TIMER_INVALID) {
@@ -166,10 +327,23 @@ int VwireTimer::setTimer(unsigned long interval, vwire_timer_callback_arg callba
 // =============================================================================
 
 void VwireTimer::deleteTimer(int timerId) {
+  VWIRE_TIMER_LOCK();
   if (!_isValidId(timerId)) {
     return;
   }
   
+  _unschedule(timerId);
+  
+  #if VWIRE_TIMER_BACKGROUND
+  // Forget callbacks still queued for this slot, it may be reused
+  for (uint8_t n = _queueTail; n != _queueHead; n++) {
+    uint16_t& entry = _queue[n & (VWIRE_TIMER_QUEUE_SIZE - 1)];
+    if (entry != 0xFFFF && (entry & 0xFF) == timerId) {
+      entry = 0xFFFF;
+    }
+  }
+  #endif
+  
   _timers[timerId].callback = NULL;
   _timers[timerId].callbackArg = NULL;
   _timers[timerId].arg = NULL;
@@ -180,24 +354,30 @@ void VwireTimer::deleteTimer(int timerId) {
   _timers[timerId].enabled = false;
   _timers[timerId].hasArg = false;
   _timers[timerId].inUse = false;
+  _timers[timerId].mode = VWIRE_TIMER_FIXED_DELAY;
   
   _numTimers--;
 }
 
 void VwireTimer::enable(int timerId) {
+  VWIRE_TIMER_LOCK();
   if (_isValidId(timerId)) {
     _timers[timerId].enabled = true;
-    _timers[timerId].lastTriggered = millis();  // Reset timing
+    _timers[timerId].lastTriggered = _now();  // Reset timing
+    _schedule(timerId);
   }
 }
 
 void VwireTimer::disable(int timerId) {
+  VWIRE_TIMER_LOCK();
   if (_isValidId(timerId)) {
     _timers[timerId].enabled = false;
+    _unschedule(timerId);
   }
 }
 
 bool VwireTimer::toggle(int timerId) {
+  VWIRE_TIMER_LOCK();
   if (!_isValidId(timerId)) {
     return false;
   }
@@ -205,33 +385,46 @@ bool VwireTimer::toggle(int timerId) {
   _timers[timerId].enabled = !_timers[timerId].enabled;
   
   if (_timers[timerId].enabled) {
-    _timers[timerId].lastTriggered = millis();  // Reset timing on enable
+    _timers[timerId].lastTriggered = _now();  // Reset timing on enable
   }
+  _schedule(timerId);
   
   return _timers[timerId].enabled;
 }
 
 void VwireTimer::restartTimer(int timerId) {
+  VWIRE_TIMER_LOCK();
   if (_isValidId(timerId)) {
-    _timers[timerId].lastTriggered = millis();
+    _timers[timerId].lastTriggered = _now();
     _timers[timerId].currentRun = 0;
     _timers[timerId].enabled = true;
+    _schedule(timerId);
   }
 }
 
 void VwireTimer::changeInterval(int timerId, unsigned long newInterval) {
+  VWIRE_TIMER_LOCK();
   if (_isValidId(timerId)) {
     _timers[timerId].interval = newInterval;
-    _timers[timerId].lastTriggered = millis();  // Reset timing
+    _timers[timerId].lastTriggered = _now();  // Reset timing
+    _schedule(timerId);
+  }
+}
+
+void VwireTimer::setMode(int timerId, uint8_t mode) {
+  VWIRE_TIMER_LOCK();
+  if (_isValidId(timerId) && mode <= VWIRE_TIMER_CATCH_UP) {
+    _timers[timerId].mode = mode;
   }
 }
 
 unsigned long VwireTimer::getRemaining(int timerId) {
+  VWIRE_TIMER_LOCK();
   if (!_isValidId(timerId) || !_timers[timerId].enabled) {
     return 0;
   }
   
-  unsigned long elapsed = millis() - _timers[timerId].lastTriggered;
+  unsigned long elapsed = _now() - _timers[timerId].lastTriggered;
   
   if (elapsed >= _timers[timerId].interval) {
     return 0;
@@ -240,11 +433,31 @@ unsigned long VwireTimer::getRemaining(int timerId) {
   return _timers[timerId].interval - elapsed;
 }
 
+unsigned long VwireTimer::msUntilNextTimer() {
+  VWIRE_TIMER_LOCK();
+  #if VWIRE_TIMER_HEAP
+  if (_heapSize == 0) {
+    return VWIRE_TIMER_IDLE;
+  }
+  return getRemaining(_heap[0]);
+  #else
+  unsigned long next = VWIRE_TIMER_IDLE;
+  for (int i = 0; i < VWIRE_MAX_TIMERS; i++) {
+    if (_timers[i].inUse && _timers[i].enabled) {
+      unsigned long remaining = getRemaining(i);
+      if (remaining < next) next = remaining;
+    }
+  }
+  return next;
+  #endif
+}
+
 // =============================================================================
 // STATUS METHODS
 // =============================================================================
 
 bool VwireTimer::isEnabled(int timerId) {
+  VWIRE_TIMER_LOCK();
   if (!_isValidId(timerId)) {
     return false;
   }
@@ -272,7 +485,97 @@ int VwireTimer::getMaxTimers() {
 // =============================================================================
 
 void VwireTimer::run() {
-  unsigned long currentMillis = millis();
+  #if VWIRE_TIMER_BACKGROUND
+  // Callbacks queued by the esp_timer (also left over after switching back)
+  _drain();
+  if (_background != VWIRE_TIMER_IN_LOOP) {
+    return;
+  }
+  #endif
+  
+  VWIRE_TIMER_LOCK();
+  _process(false);
+}
+
+void VwireTimer::_invoke(int timerId) {
+  if (_timers[timerId].hasArg && _timers[timerId].callbackArg != NULL) {
+    _timers[timerId].callbackArg(_timers[timerId].arg);
+  } else if (_timers[timerId].callback != NULL) {
+    _timers[timerId].callback();
+  }
+}
+
+#if VWIRE_TIMER_HEAP
+
+void VwireTimer::_process(bool defer) {
+  unsigned long now = _now();
+  
+  // Nothing due - a single comparison however many timers exist
+  if (_heapSize == 0 || getRemaining(_heap[0]) > 0) {
+    return;
+  }
+  
+  // Take every due timer off the heap first, so each fires at most once
+  // per run() (an interval of 0 would otherwise stay at the top)
+  uint8_t due[VWIRE_MAX_TIMERS];
+  uint8_t dueCount = 0;
+  while (_heapSize && getRemaining(_heap[0]) == 0) {
+    #if VWIRE_TIMER_BACKGROUND
+    if (defer && dueCount >= _queueSpace()) {
+      _stalled = true;  // The rest stays due until run() makes room
+      break;
+    }
+    #endif
+    due[dueCount] = _heap[0];
+    _unschedule(due[dueCount++]);
+  }
+  
+  for (uint8_t n = 0; n < dueCount; n++) {
+    uint8_t i = due[n];
+    
+    // An earlier callback may have deleted, disabled or restarted it
+    if (!_timers[i].inUse || !_timers[i].enabled || _heapPos[i] != 0xFF) {
+      continue;
+    }
+    
+    _advance(i, now);
+    _timers[i].currentRun++;
+    
+    bool last = (_timers[i].maxRuns != VWIRE_RUN_FOREVER &&
+                 _timers[i].currentRun >= _timers[i].maxRuns);
+    if (!last) {
+      _schedule(i);
+    }
+    
+    #if VWIRE_TIMER_BACKGROUND
+    if (defer) {
+      // run() calls back and deletes it after the last run
+      _queue[_queueHead & (VWIRE_TIMER_QUEUE_SIZE - 1)] = i | (last ? 0x100 : 0);
+      __atomic_store_n(&_queueHead, (uint8_t)(_queueHead + 1), __ATOMIC_RELEASE);
+      if (last) {
+        _timers[i].enabled = false;
+      }
+      continue;
+    }
+    #else
+    (void)defer;
+    #endif
+    
+    // Execute callback
+    _invoke(i);
+    
+    // Check if timer should stop (the callback may have restarted it)
+    if (_timers[i].inUse && _timers[i].maxRuns != VWIRE_RUN_FOREVER && 
+        _timers[i].currentRun >= _timers[i].maxRuns) {
+      deleteTimer(i);
+    }
+  }
+}
+
+#else
+
+void VwireTimer::_process(bool defer) {
+  unsigned long now = _now();
   
   for (int i = 0; i < VWIRE_MAX_TIMERS; i++) {
     // Skip unused or disabled slots
@@ -281,23 +584,43 @@ void VwireTimer::run() {
     }
     
     // Check if interval has elapsed (handles millis() overflow correctly)
-    if ((unsigned long)(currentMillis - _timers[i].lastTriggered) >= _timers[i].interval) {
+    if ((unsigned long)(now - _timers[i].lastTriggered) >= _timers[i].interval) {
       
-      // Update last triggered time
-      _timers[i].lastTriggered = currentMillis;
+      #if VWIRE_TIMER_BACKGROUND
+      if (defer && _queueSpace() == 0) {
+        _stalled = true;  // Stays due until run() makes room
+        return;
+      }
+      #endif
+      
+      // Move to the next deadline (depends on the timer's mode)
+      _advance(i, now);
       
       // Increment run count
       _timers[i].currentRun++;
       
-      // Execute callback
-      if (_timers[i].hasArg && _timers[i].callbackArg != NULL) {
-        _timers[i].callbackArg(_timers[i].arg);
-      } else if (_timers[i].callback != NULL) {
-        _timers[i].callback();
+      bool last = (_timers[i].maxRuns != VWIRE_RUN_FOREVER && 
+                   _timers[i].currentRun >= _timers[i].maxRuns);
+      
+      #if VWIRE_TIMER_BACKGROUND
+      if (defer) {
+        // run() calls back and deletes it after the last run
+        _queue[_queueHead & (VWIRE_TIMER_QUEUE_SIZE - 1)] = i | (last ? 0x100 : 0);
+        __atomic_store_n(&_queueHead, (uint8_t)(_queueHead + 1), __ATOMIC_RELEASE);
+        if (last) {
+          _timers[i].enabled = false;
+        }
+        continue;
       }
+      #else
+      (void)defer;
+      #endif
+      
+      // Execute callback
+      _invoke(i);
       
       // Check if timer should stop (not infinite and reached max runs)
-      if (_timers[i].maxRuns != VWIRE_RUN_FOREVER && 
+      if (last && _timers[i].inUse && _timers[i].maxRuns != VWIRE_RUN_FOREVER && 
           _timers[i].currentRun >= _timers[i].maxRuns) {
         // Auto-delete timer that has finished
         deleteTimer(i);
@@ -306,7 +629,126 @@ void VwireTimer::run() {
   }
 }
 
+#endif
+
+// =============================================================================
+// BACKGROUND (ESP32 esp_timer)
+// =============================================================================
+
+#if VWIRE_TIMER_BACKGROUND
+
+VwireTimer::StateLock::StateLock(VwireTimer* timer) : owner(timer), held(false) {
+  if (owner->_lock) {
+    xSemaphoreTakeRecursive(owner->_lock, portMAX_DELAY);
+    owner->_lockDepth++;
+    held = true;
+  }
+}
+
+VwireTimer::StateLock::~StateLock() {
+  if (!held) return;
+  if (--owner->_lockDepth == 0 && owner->_dirty) {
+    owner->_dirty = false;
+    owner->_rearm();
+  }
+  xSemaphoreGiveRecursive(owner->_lock);
+}
+
+bool VwireTimer::setBackground(uint8_t mode) {
+  if (mode > VWIRE_TIMER_IN_TASK) {
+    return false;
+  }
+  
+  if (mode != VWIRE_TIMER_IN_LOOP && _hwTimer == NULL) {
+    if (_lock == NULL) {
+      _lock = xSemaphoreCreateRecursiveMutex();
+      if (_lock == NULL) return false;
+    }
+    esp_timer_create_args_t args = {};
+    args.callback = _onHardwareTimer;
+    args.arg = this;
+    args.name = "vwire_timer";
+    if (esp_timer_create(&args, &_hwTimer) != ESP_OK) {
+      _hwTimer = NULL;
+      return false;
+    }
+  }
+  
+  VWIRE_TIMER_LOCK();
+  _background = mode;
+  _dirty = true;  // Arm (or stop) the esp_timer on unlock
+  return true;
+}
+
+void VwireTimer::_onHardwareTimer(void* arg) {
+  VwireTimer* self = (VwireTimer*)arg;
+  StateLock lock(self);
+  self->_dirty = true;  // Always re-arm for the next deadline
+  if (self->_background != VWIRE_TIMER_IN_LOOP) {
+    self->_process(self->_background == VWIRE_TIMER_DEFERRED);
+  }
+}
+
+void VwireTimer::_rearm() {
+  if (_hwTimer == NULL) return;
+  esp_timer_stop(_hwTimer);
+  if (_background == VWIRE_TIMER_IN_LOOP || _stalled) return;
+  
+  unsigned long next = msUntilNextTimer();
+  if (next == VWIRE_TIMER_IDLE) return;
+  
+  // At least one tick, and never below esp_timer's practical minimum, so
+  // an interval of 0 cannot starve the system from the timer task
+  uint64_t us = (uint64_t)(next ? next : 1) * (_micros ? 1 : 1000);
+  esp_timer_start_once(_hwTimer, us < 50 ? 50 : us);
+}
+
+uint8_t VwireTimer::_queueSpace() {
+  uint8_t used = _queueHead - __atomic_load_n(&_queueTail, __ATOMIC_ACQUIRE);
+  return VWIRE_TIMER_QUEUE_SIZE - used;
+}
+
+void VwireTimer::_drain() {
+  uint8_t tail = _queueTail;
+  while (tail != __atomic_load_n(&_queueHead, __ATOMIC_ACQUIRE)) {
+    uint16_t entry = _queue[tail & (VWIRE_TIMER_QUEUE_SIZE - 1)];
+    __atomic_store_n(&_queueTail, ++tail, __ATOMIC_RELEASE);
+    
+    int i = entry & 0xFF;
+    if (entry == 0xFFFF || !_timers[i].inUse) {
+      continue;
+    }
+    
+    // Not under the lock, so the esp_timer keeps time during the callback
+    _invoke(i);
+    
+    // Finished timers are deleted here (unless the callback restarted it)
+    if (entry & 0x100) {
+      VWIRE_TIMER_LOCK();
+      if (_timers[i].inUse && !_timers[i].enabled &&
+          _timers[i].currentRun >= _timers[i].maxRuns) {
+        deleteTimer(i);
+      }
+    }
+  }
+  
+  if (_stalled) {
+    VWIRE_TIMER_LOCK();
+    _stalled = false;
+    _dirty = true;
+  }
+}
+
+#else
+
+bool VwireTimer::setBackground(uint8_t mode) {
+  return mode == VWIRE_TIMER_IN_LOOP;
+}
+
+#endif
+
 void VwireTimer::deleteAllTimers() {
+  VWIRE_TIMER_LOCK();
   for (int i = 0; i < VWIRE_MAX_TIMERS; i++) {
     if (_timers[i].inUse) {
       deleteTimer(i);
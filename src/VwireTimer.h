@@ -2,7 +2,8 @@
  * Vwire IOT Arduino Library - Timer
  * 
  * Non-blocking software timer for scheduling tasks.
- * Uses millis() for universal compatibility with all Arduino boards.
+ * Uses millis() for universal compatibility with all Arduino boards
+ * (or micros() for control loops).
  * 
  * Features:
  * - Multiple concurrent timers
@@ -12,6 +13,11 @@
  * - Enable/disable/toggle control
  * - Change interval on the fly
  * - Callback with optional argument
+ * - Fixed-delay, fixed-rate or catch-up scheduling per timer
+ * - Millisecond or microsecond resolution
+ * - ESP32: optional esp_timer backend that keeps timers on time while
+ *   loop() is blocked (e.g. during a TLS reconnect)
+ * - Optional heap scheduler: run() is O(1) while nothing is due
  * 
  * Compatible with:
  * - ESP32, ESP8266
@@ -48,12 +54,74 @@
   #endif
 #endif
 
+// Scheduler backend - can be overridden before including this header
+// 0 = run() checks every slot (smallest code)
+// 1 = slots kept in a binary heap ordered by due time, so run() only looks
+//     at the earliest timer; used automatically above 16 timers
+#ifndef VWIRE_TIMER_HEAP
+  #if VWIRE_MAX_TIMERS > 16
+    #define VWIRE_TIMER_HEAP 1
+  #else
+    #define VWIRE_TIMER_HEAP 0
+  #endif
+#endif
+
+#if VWIRE_TIMER_HEAP && VWIRE_MAX_TIMERS > 255
+  #error "VWIRE_MAX_TIMERS must be 255 or less with VWIRE_TIMER_HEAP"
+#endif
+
+// Background (esp_timer) backend support - ESP32 only, enabled at run time
+// with setBackground()
+#ifndef VWIRE_TIMER_BACKGROUND
+  #if defined(ESP32)
+    #define VWIRE_TIMER_BACKGROUND 1
+  #else
+    #define VWIRE_TIMER_BACKGROUND 0
+  #endif
+#endif
+
+// Deferred callbacks waiting for run() (power of two, at most 128)
+#ifndef VWIRE_TIMER_QUEUE_SIZE
+  #define VWIRE_TIMER_QUEUE_SIZE 16
+#endif
+
+#if VWIRE_TIMER_BACKGROUND
+  #if VWIRE_MAX_TIMERS > 255
+    #error "VWIRE_MAX_TIMERS must be 255 or less with VWIRE_TIMER_BACKGROUND"
+  #endif
+  #if (VWIRE_TIMER_QUEUE_SIZE & (VWIRE_TIMER_QUEUE_SIZE - 1)) || VWIRE_TIMER_QUEUE_SIZE > 128
+    #error "VWIRE_TIMER_QUEUE_SIZE must be a power of two, at most 128"
+  #endif
+  #include <esp_timer.h>
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/semphr.h>
+#endif
+
 // Invalid timer ID
 #define VWIRE_TIMER_INVALID -1
 
+// msUntilNextTimer() result when no timer is enabled
+#define VWIRE_TIMER_IDLE ((unsigned long)-1)
+
 // Infinite runs (for setInterval)
 #define VWIRE_RUN_FOREVER -1
 
+// Time base (constructor argument) - all intervals use this unit
+#define VWIRE_TIMER_MILLIS 0        // millis(), wraps after ~49 days
+#define VWIRE_TIMER_MICROS 1        // micros(), wraps after ~71 minutes
+
+// Scheduling modes (setMode)
+#define VWIRE_TIMER_FIXED_DELAY 0   // Next run interval after the callback ran (default)
+#define VWIRE_TIMER_FIXED_RATE  1   // Next run interval after the previous deadline;
+                                    // periods missed while late are skipped
+#define VWIRE_TIMER_CATCH_UP    2   // Like FIXED_RATE, but missed periods are
+                                    // replayed, one per run() call
+
+// Where timers are checked (setBackground)
+#define VWIRE_TIMER_IN_LOOP  0      // run() checks timers and calls back (default)
+#define VWIRE_TIMER_DEFERRED 1      // esp_timer checks timers on time, run() calls back
+#define VWIRE_TIMER_IN_TASK  2      // esp_timer checks timers and calls back itself
+
 // =============================================================================
 // CALLBACK TYPES
 // =============================================================================
@@ -72,8 +140,14 @@ class VwireTimer {
 public:
   /**
    * Constructor - initializes all timer slots
+   * @param resolution VWIRE_TIMER_MILLIS (default) or VWIRE_TIMER_MICROS;
+   *                   every interval and remaining time uses this unit
    */
-  VwireTimer();
+  VwireTimer(uint8_t resolution = VWIRE_TIMER_MILLIS);
+  
+  #if VWIRE_TIMER_BACKGROUND
+  ~VwireTimer();
+  #endif
   
   // =========================================================================
   // TIMER CREATION METHODS
@@ -174,13 +248,42 @@ public:
    */
   void changeInterval(int timerId, unsigned long newInterval);
   
+  /**
+   * Set how the next deadline is computed after a timer fires
+   * FIXED_DELAY measures from when run() got to it, so lateness adds up;
+   * FIXED_RATE and CATCH_UP stay on the original time grid.
+   * @param timerId Timer ID
+   * @param mode VWIRE_TIMER_FIXED_DELAY, VWIRE_TIMER_FIXED_RATE or VWIRE_TIMER_CATCH_UP
+   */
+  void setMode(int timerId, uint8_t mode);
+  
   /**
    * Get the remaining time until next execution
    * @param timerId Timer ID
-   * @return Milliseconds until next run, or 0 if invalid/disabled
+   * @return Time until next run (in the timer's unit), or 0 if invalid/disabled
    */
   unsigned long getRemaining(int timerId);
   
+  /**
+   * Get the time until the earliest enabled timer is due
+   * Lets the sketch delay() or light-sleep exactly until run() has work.
+   * @return Milliseconds (microseconds with VWIRE_TIMER_MICROS; 0 if a
+   *         timer is due now), or VWIRE_TIMER_IDLE if no timer is enabled
+   */
+  unsigned long msUntilNextTimer();
+  
+  /**
+   * Check timers from an esp_timer instead of only from run() (ESP32)
+   * DEFERRED: deadlines are tracked on time even while loop() blocks;
+   *   callbacks are queued (VWIRE_TIMER_QUEUE_SIZE) and run from run(),
+   *   so they may still call Vwire safely.
+   * IN_TASK: callbacks run in the esp_timer task as soon as they are due;
+   *   they must be short and must not touch Vwire or other loop() state.
+   * @param mode VWIRE_TIMER_IN_LOOP, VWIRE_TIMER_DEFERRED or VWIRE_TIMER_IN_TASK
+   * @return true if the mode is active (false if unsupported on this board)
+   */
+  bool setBackground(uint8_t mode);
+  
   // =========================================================================
   // STATUS METHODS
   // =========================================================================
@@ -223,7 +326,8 @@ public:
   
   /**
    * Process all timers - MUST be called in loop()
-   * Checks each timer and executes callbacks as needed
+   * Checks each timer and executes callbacks as needed (with
+   * VWIRE_TIMER_DEFERRED, runs the callbacks queued meanwhile)
    */
   void run();
   
@@ -238,23 +342,68 @@ private:
     vwire_timer_callback callback;          // Simple callback
     vwire_timer_callback_arg callbackArg;   // Callback with argument
     void* arg;                              // User argument
-    unsigned long interval;                 // Interval in ms
-    unsigned long lastTriggered;            // Last execution time
+    unsigned long interval;                 // Interval in ms (or us)
+    unsigned long lastTriggered;            // Last execution time (or deadline)
     int maxRuns;                            // Max runs (-1 = infinite, 0 = done)
     int currentRun;                         // Current run count
     bool enabled;                           // Timer active flag
     bool hasArg;                            // Uses callback with argument
     bool inUse;                             // Slot is occupied
+    uint8_t mode;                           // VWIRE_TIMER_FIXED_DELAY etc.
   };
   
   // Timer storage
   TimerSlot _timers[VWIRE_MAX_TIMERS];
   int _numTimers;
+  bool _micros;                             // Time base is micros()
+  
+  #if VWIRE_TIMER_HEAP
+  // Enabled timers ordered by due time (lastTriggered + interval)
+  uint8_t _heap[VWIRE_MAX_TIMERS];          // Slot IDs, earliest first
+  uint8_t _heapPos[VWIRE_MAX_TIMERS];       // Slot -> heap index (0xFF = not scheduled)
+  uint8_t _heapSize;
+  
+  bool _dueBefore(uint8_t a, uint8_t b);
+  void _heapSwap(uint8_t i, uint8_t j);
+  void _siftUp(uint8_t i);
+  void _siftDown(uint8_t i);
+  #endif
+  
+  #if VWIRE_TIMER_BACKGROUND
+  uint8_t _background;                      // VWIRE_TIMER_IN_LOOP etc.
+  esp_timer_handle_t _hwTimer;
+  SemaphoreHandle_t _lock;                  // Recursive, guards all timer state
+  uint8_t _lockDepth;
+  bool _dirty;                              // Schedule changed - re-arm on unlock
+  bool _stalled;                            // Queue full - wait for run()
+  uint16_t _queue[VWIRE_TIMER_QUEUE_SIZE];  // Slot ID | 0x100 on the last run
+  volatile uint8_t _queueHead;              // Written by the esp_timer task only
+  volatile uint8_t _queueTail;              // Written by run() only
+  
+  // Holds _lock for a scope; re-arms the esp_timer when the outermost unlocks
+  struct StateLock {
+    VwireTimer* owner;
+    bool held;
+    StateLock(VwireTimer* timer);
+    ~StateLock();
+  };
+  
+  static void _onHardwareTimer(void* arg);
+  void _rearm();
+  uint8_t _queueSpace();
+  void _drain();
+  #endif
   
   // Internal helpers
+  unsigned long _now() { return _micros ? micros() : millis(); }
+  void _advance(int timerId, unsigned long now);  // Next deadline after a run
+  void _process(bool defer);                // Fire (or queue) every due timer
+  void _invoke(int timerId);
   int _findFreeSlot();
   bool _isValidId(int timerId);
   int _createTimer(unsigned long interval, int maxRuns);
+  void _schedule(int timerId);              // (Re)position after a timing change
+  void _unschedule(int timerId);            // Drop from the run queue
 };
 
 #endif // VWIRE_TIMER_H